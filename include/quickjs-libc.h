@@ -45,6 +45,8 @@ int js_module_set_import_meta(JSContext *ctx, JSValueConst func_val,
                               JS_BOOL use_realpath, JS_BOOL is_main);
 JSModuleDef *js_module_loader(JSContext *ctx, const char *module_name,
                               void *opaque);
+/* 'buf' is read with JS_READ_OBJ_ROM_DATA: it must stay valid as long as
+   the functions it defines, as the static arrays output by qjsc */
 void js_std_eval_binary(JSContext *ctx, const uint8_t *buf, size_t buf_len,
                         int flags);
 void js_std_promise_rejection_tracker(JSContext *ctx, JSValueConst promise,
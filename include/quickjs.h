@@ -62,6 +62,13 @@ typedef uint32_t JSAtom;
 
 #ifndef JS_PTR64
 #define JS_NAN_BOXING
+#elif defined(CONFIG_NAN_BOXING)
+/* optional 64 bit NaN boxing: the pointers must fit in 47 bits. The user
+   space of x86-64 is below 2^47 while aarch64 can map above it */
+#if !defined(__x86_64__) && !defined(_M_X64)
+#error "CONFIG_NAN_BOXING is only supported on x86-64"
+#endif
+#define JS_NAN_BOXING
 #endif
 
 enum {
@@ -72,6 +79,7 @@ enum {
   JS_TAG_BIG_FLOAT = -9,
   JS_TAG_SYMBOL = -8,
   JS_TAG_STRING = -7,
+  JS_TAG_STRING_ROPE = -6,       /* used internally */
   JS_TAG_MODULE = -3,            /* used internally */
   JS_TAG_FUNCTION_BYTECODE = -2, /* used internally */
   JS_TAG_OBJECT = -1,
@@ -129,16 +137,30 @@ typedef uint64_t JSValue;
 
 #define JSValueConst JSValue
 
-#define JS_VALUE_GET_TAG(v) (int)((v) >> 32)
-#define JS_VALUE_GET_INT(v) (int)(v)
-#define JS_VALUE_GET_BOOL(v) (int)(v)
+#ifdef JS_PTR64
+/* The tag is in the 17 high bits and the pointer or the 32 bit
+   integer in the low bits. The float64 values are offset so that their
+   17 high bits never match a tag, the NaN values being normalized to
+   0x7fff800000000000 which is stored with the JS_TAG_FLOAT64 tag. */
+#define JS_VALUE_TAG_SHIFT 47
+#define JS_VALUE_PTR_MASK (((uint64_t)1 << JS_VALUE_TAG_SHIFT) - 1)
+#define JS_FLOAT64_TAG_ADDEND (0xffff - JS_TAG_FLOAT64)
+#define JS_VALUE_GET_PTR(v) (void *)(intptr_t)((v)&JS_VALUE_PTR_MASK)
+#else
+#define JS_VALUE_TAG_SHIFT 32
+#define JS_FLOAT64_TAG_ADDEND                                                  \
+  (0x7ff80000 - JS_TAG_FIRST + 1) /* quiet NaN encoding */
 #define JS_VALUE_GET_PTR(v) (void *)(intptr_t)(v)
+#endif
 
-#define JS_MKVAL(tag, val) (((uint64_t)(tag) << 32) | (uint32_t)(val))
-#define JS_MKPTR(tag, ptr) (((uint64_t)(tag) << 32) | (uintptr_t)(ptr))
+#define JS_VALUE_GET_TAG(v) (int)((int64_t)(v) >> JS_VALUE_TAG_SHIFT)
+#define JS_VALUE_GET_INT(v) (int)(v)
+#define JS_VALUE_GET_BOOL(v) (int)(v)
 
-#define JS_FLOAT64_TAG_ADDEND                                                  \
-  (0x7ff80000 - JS_TAG_FIRST + 1) /* quiet NaN encoding */
+#define JS_MKVAL(tag, val)                                                     \
+  (((uint64_t)(tag) << JS_VALUE_TAG_SHIFT) | (uint32_t)(val))
+#define JS_MKPTR(tag, ptr)                                                     \
+  (((uint64_t)(tag) << JS_VALUE_TAG_SHIFT) | (uintptr_t)(ptr))
 
 static inline double JS_VALUE_GET_FLOAT64(JSValue v) {
   union {
@@ -146,11 +168,15 @@ static inline double JS_VALUE_GET_FLOAT64(JSValue v) {
     double d;
   } u;
   u.v = v;
-  u.v += (uint64_t)JS_FLOAT64_TAG_ADDEND << 32;
+  u.v += (uint64_t)JS_FLOAT64_TAG_ADDEND << JS_VALUE_TAG_SHIFT;
   return u.d;
 }
 
+#ifdef JS_PTR64
+#define JS_NAN JS_MKVAL(JS_TAG_FLOAT64, 0)
+#else
 #define JS_NAN (0x7ff8000000000000 - ((uint64_t)JS_FLOAT64_TAG_ADDEND << 32))
+#endif
 
 static inline JSValue __JS_NewFloat64(JSContext *ctx, double d) {
   union {
@@ -163,7 +189,7 @@ static inline JSValue __JS_NewFloat64(JSContext *ctx, double d) {
   if (js_unlikely((u.u64 & 0x7fffffffffffffff) > 0x7ff0000000000000))
     v = JS_NAN;
   else
-    v = u.u64 - ((uint64_t)JS_FLOAT64_TAG_ADDEND << 32);
+    v = u.u64 - ((uint64_t)JS_FLOAT64_TAG_ADDEND << JS_VALUE_TAG_SHIFT);
   return v;
 }
 
@@ -181,9 +207,7 @@ static inline int JS_VALUE_GET_NORM_TAG(JSValue v) {
 }
 
 static inline JS_BOOL JS_VALUE_IS_NAN(JSValue v) {
-  uint32_t tag;
-  tag = JS_VALUE_GET_TAG(v);
-  return tag == (JS_NAN >> 32);
+  return JS_VALUE_GET_TAG(v) == JS_VALUE_GET_TAG(JS_NAN);
 }
 
 #else /* !JS_NAN_BOXING */
@@ -337,12 +361,20 @@ JSRuntime *JS_NewRuntime(void);
 void JS_SetRuntimeInfo(JSRuntime *rt, const char *info);
 void JS_SetMemoryLimit(JSRuntime *rt, size_t limit);
 void JS_SetGCThreshold(JSRuntime *rt, size_t gc_threshold);
+void JS_SetGCPauseBudget(JSRuntime *rt, int budget_us);
+JS_BOOL JS_RunGCSlice(JSRuntime *rt);
 /* use 0 to disable maximum stack size check */
 void JS_SetMaxStackSize(JSRuntime *rt, size_t stack_size);
 /* should be called when changing thread to update the stack top value
    used to check stack overflow. */
 void JS_UpdateStackTop(JSRuntime *rt);
 JSRuntime *JS_NewRuntime2(const JSMallocFunctions *mf, void *opaque);
+/* allocate the objects, shapes, variable references and short strings
+   from per-runtime slabs of fixed size blocks. JS_NewRuntime() enables
+   it, JS_NewRuntime2() does not so that 'mf' sees all the allocations */
+#define JS_RUNTIME_SLAB_ALLOC (1 << 0)
+JSRuntime *JS_NewRuntime3(const JSMallocFunctions *mf, void *opaque,
+                          int flags);
 void JS_FreeRuntime(JSRuntime *rt);
 void *JS_GetRuntimeOpaque(JSRuntime *rt);
 void JS_SetRuntimeOpaque(JSRuntime *rt, void *opaque);
@@ -481,10 +513,15 @@ typedef struct JSMemoryUsage {
   int64_t c_func_count, array_count;
   int64_t fast_array_count, fast_array_elements;
   int64_t binary_object_count, binary_object_size;
+  int64_t slab_count, slab_size; /* blocks allocated from the slabs */
+  int64_t slab_page_count, slab_page_size;
 } JSMemoryUsage;
 
 void JS_ComputeMemoryUsage(JSRuntime *rt, JSMemoryUsage *s);
 void JS_DumpMemoryUsage(FILE *fp, const JSMemoryUsage *s, JSRuntime *rt);
+/* dump the execution counts of the opcodes and the opcode pairs, only
+   available if built with QJS_DUMP_OPCODE_STATS */
+void JS_DumpOpcodeStats(JSRuntime *rt, FILE *fp);
 
 /* atom support */
 #define JS_ATOM_NULL 0
@@ -670,7 +707,8 @@ static inline JS_BOOL JS_IsUninitialized(JSValueConst v) {
 }
 
 static inline JS_BOOL JS_IsString(JSValueConst v) {
-  return JS_VALUE_GET_TAG(v) == JS_TAG_STRING;
+  return JS_VALUE_GET_TAG(v) == JS_TAG_STRING ||
+         JS_VALUE_GET_TAG(v) == JS_TAG_STRING_ROPE;
 }
 
 static inline JS_BOOL JS_IsSymbol(JSValueConst v) {
@@ -698,11 +736,34 @@ JSValue __js_printf_like(2, 3)
     JS_ThrowInternalError(JSContext *ctx, const char *fmt, ...);
 JSValue JS_ThrowOutOfMemory(JSContext *ctx);
 
+/* true if 'v' is a GC object which can be part of a reference cycle */
+#define JS_VALUE_IS_GC_OBJECT(v)                                               \
+  (JS_VALUE_GET_TAG(v) == JS_TAG_OBJECT ||                                     \
+   JS_VALUE_GET_TAG(v) == JS_TAG_FUNCTION_BYTECODE)
+
+/* the reference count of a GC object is followed by a byte of GC flags.
+   JS_GC_FLAG_ROOT_BUFFERED is set when the object is already recorded as
+   a possible root of a garbage cycle. */
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define JS_GC_FLAG_ROOT_BUFFERED (1 << 0)
+#else
+#define JS_GC_FLAG_ROOT_BUFFERED (1 << 7)
+#endif
+
+/* true if the reference count of 'v' was decremented to a non zero value
+   and 'v' must be recorded as a possible root */
+#define JS_VALUE_IS_NEW_GC_ROOT(v, p)                                          \
+  (JS_VALUE_IS_GC_OBJECT(v) &&                                                 \
+   !(((const uint8_t *)(p))[sizeof(int)] & JS_GC_FLAG_ROOT_BUFFERED))
+
+/* also called when the reference count of a GC object is decremented to
+   a non zero value and the object is not a possible root of a garbage
+   cycle yet */
 void __JS_FreeValue(JSContext *ctx, JSValue v);
 static inline void JS_FreeValue(JSContext *ctx, JSValue v) {
   if (JS_VALUE_HAS_REF_COUNT(v)) {
     JSRefCountHeader *p = (JSRefCountHeader *)JS_VALUE_GET_PTR(v);
-    if (--p->ref_count <= 0) {
+    if (--p->ref_count <= 0 || js_unlikely(JS_VALUE_IS_NEW_GC_ROOT(v, p))) {
       __JS_FreeValue(ctx, v);
     }
   }
@@ -711,7 +772,7 @@ void __JS_FreeValueRT(JSRuntime *rt, JSValue v);
 static inline void JS_FreeValueRT(JSRuntime *rt, JSValue v) {
   if (JS_VALUE_HAS_REF_COUNT(v)) {
     JSRefCountHeader *p = (JSRefCountHeader *)JS_VALUE_GET_PTR(v);
-    if (--p->ref_count <= 0) {
+    if (--p->ref_count <= 0 || js_unlikely(JS_VALUE_IS_NEW_GC_ROOT(v, p))) {
       __JS_FreeValueRT(rt, v);
     }
   }
@@ -901,6 +962,12 @@ void JS_SetInterruptHandler(JSRuntime *rt, JSInterruptHandler *cb,
 typedef int JSPcInterruptHandler(const uint8_t *pc, JSRuntime *rt,
                                  void *opaque);
 
+/* sampling CPU profiler built on the interrupt polls, the samples are
+   written in the Chrome DevTools `.cpuprofile` format by JS_StopCPUProfile(),
+   nothing is written if `filename` is NULL */
+int JS_StartCPUProfile(JSRuntime *rt, int interval_us);
+int JS_StopCPUProfile(JSRuntime *rt, const char *filename);
+
 /* if can_block is TRUE, Atomics.wait() can be used */
 void JS_SetCanBlock(JSRuntime *rt, JS_BOOL can_block);
 /* set the [IsHTMLDDA] internal slot */
@@ -1169,10 +1236,26 @@ void js_debug_on(JSContext *ctx);
 void js_debug_off(JSContext *ctx);
 void js_free_debug(JSContext *ctx);
 
+// return -1 if `line` is negative or on memory failure
 int js_debug_set_breakpoint(JSContext *ctx, const char *file, int line,
                             int col);
+// set a conditional breakpoint or a logpoint, `condition` is an expression
+// evaluated with the variables of the paused frame, the breakpoint only pauses
+// the vm if it's truthy. `log_message` turns the breakpoint into a logpoint
+// which prints the message instead of pausing, the expressions enclosed in
+// `{}` are interpolated. Both of them are optional
+int js_debug_set_breakpoint2(JSContext *ctx, const char *file, int line,
+                             int col, const char *condition,
+                             const char *log_message);
 int js_debug_del_breakpoint(JSContext *ctx, const char *file, int line,
                             int col);
+
+typedef void JSDebugLogHandler(JSContext *ctx, const char *file, int line,
+                               int col, const char *msg, size_t len,
+                               void *opaque);
+// the messages of logpoints are printed to stdout if there is no handler
+void js_debug_set_log_handler(JSContext *ctx, JSDebugLogHandler *handler,
+                              void *opaque);
 void js_debug_continue(JSContext *ctx);
 
 JSValue js_debug_list_stackframes(JSContext *ctx);
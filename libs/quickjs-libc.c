@@ -2031,6 +2031,10 @@ static int js_os_poll(JSContext *ctx) {
     min_delay = -1;
   }
 
+  /* use the idle time to continue a sliced cycle collection */
+  if (JS_RunGCSlice(rt))
+    min_delay = 0;
+
   console_fd = -1;
   list_for_each(el, &ts->os_rw_handlers) {
     rh = list_entry(el, JSOSRWHandler, link);
@@ -2199,6 +2203,13 @@ static int js_os_poll(JSContext *ctx) {
     tvp = NULL;
   }
 
+  /* use the idle time to continue a sliced cycle collection */
+  if (JS_RunGCSlice(rt)) {
+    tv.tv_sec = 0;
+    tv.tv_usec = 0;
+    tvp = &tv;
+  }
+
   FD_ZERO(&rfds);
   FD_ZERO(&wfds);
   fd_max = -1;
@@ -3754,7 +3765,10 @@ void js_std_loop(JSContext *ctx) {
 void js_std_eval_binary(JSContext *ctx, const uint8_t *buf, size_t buf_len,
                         int load_only) {
   JSValue obj, val;
-  obj = JS_ReadObject(ctx, buf, buf_len, JS_READ_OBJ_BYTECODE);
+  /* the qjsc output is static data: the line tables and, when possible,
+     the bytecode are used in place */
+  obj = JS_ReadObject(ctx, buf, buf_len,
+                      JS_READ_OBJ_BYTECODE | JS_READ_OBJ_ROM_DATA);
   if (JS_IsException(obj))
     goto exception;
   if (load_only) {
@@ -19,7 +19,7 @@
 #include <unistd.h>
 
 #ifndef FD_COPY
-#define FD_COPY(dest, src) memcpy((dest), (src), sizeof *(dest))
+#define FD_COPY(src, dest) memcpy((dest), (src), sizeof *(dest))
 #endif
 
 typedef struct msg_t {
@@ -173,8 +173,9 @@ int sess_enqueue_in_msg(sess_t *sess) {
     len = recv(sess->conn.fd, buf, sizeof(buf), 0);
     if (len < 0) {
       if (errno == EAGAIN || errno == EWOULDBLOCK) {
-        if (len)
+        if (msg->buf.size)
           break; // there is some data arrived
+        free_msg(msg);
         return 0;
       }
       return -1;
@@ -258,6 +259,7 @@ serv_t *new_serv(uint64_t port) {
 }
 
 sess_t *accept_conn(serv_t *serv) {
+  int on = 1;
   sess_t *sess = new_sess();
   if (!sess)
     fatal("failed to make sess\n");
@@ -267,6 +269,10 @@ sess_t *accept_conn(serv_t *serv) {
   if (sess->conn.fd < 0)
     fatal("failed to accept new conn\n");
 
+  // the accepted socket does not inherit `O_NONBLOCK` on Linux
+  if (ioctl(sess->conn.fd, FIONBIO, (char *)&on))
+    fatal("failed to turn conn socket into no-blocking\n");
+
   list_add_tail(&sess->link, &serv->sessions);
   return sess;
 };
@@ -319,6 +325,43 @@ JSValue new_event_err(sess_t *sess, int code, const char *msg) {
   return obj;
 }
 
+// called on the thread evaluating the user script, so the message is encoded
+// by `ctx` instead of `sess->ctx`
+void sess_event_send_log(JSContext *ctx, const char *file, int line, int col,
+                         const char *str, size_t len, void *opaque) {
+  sess_t *sess = opaque;
+  JSValue replay, data, json;
+  const char *cstr;
+  msg_t *msg;
+
+  replay = JS_NewObject(ctx);
+  data = JS_NewObject(ctx);
+  JS_SetPropertyStr(ctx, data, "file", JS_NewString(ctx, file));
+  JS_SetPropertyStr(ctx, data, "line", JS_NewInt32(ctx, line));
+  JS_SetPropertyStr(ctx, data, "col", JS_NewInt32(ctx, col));
+  JS_SetPropertyStr(ctx, data, "msg", JS_NewStringLen(ctx, str, len));
+  JS_SetPropertyStr(ctx, replay, "type", JS_NewString(ctx, "log"));
+  JS_SetPropertyStr(ctx, replay, "data", data);
+
+  json = JS_JSONStringify(ctx, replay, JS_NULL, JS_NewInt32(ctx, 2));
+  JS_FreeValue(ctx, replay);
+  if (JS_IsException(json)) {
+    JS_FreeValue(ctx, JS_GetException(ctx));
+    return;
+  }
+
+  cstr = JS_ToCString(ctx, json);
+  JS_FreeValue(ctx, json);
+  if (!cstr)
+    return;
+
+  msg = new_msg();
+  dbuf_put(&msg->buf, (uint8_t *)cstr, strlen(cstr));
+  JS_FreeCString(ctx, cstr);
+
+  sess_enqueue_out_msg(sess, msg);
+}
+
 void *debug_user_script(void *arg) {
   sess_t *sess = arg;
 
@@ -326,6 +369,7 @@ void *debug_user_script(void *arg) {
 
   if (js_debug_init(sess->eval_ctx))
     goto fail;
+  js_debug_set_log_handler(sess->eval_ctx, sess_event_send_log, sess);
 
   js_debug_wait_ready2start(sess->eval_ctx);
   if (eval_file(sess->eval_ctx, sess->eval_file, 1)) {
@@ -472,13 +516,31 @@ void sess_event_handle(sess_t *sess, JSValue event) {
       goto fail;
     }
 
-    int line_num, col_num;
+    // both the `condition` and the `logMessage` are optional
+    JSValue cond = JS_GetPropertyStr(sess->ctx, args, "condition");
+    JSValue log_msg = JS_GetPropertyStr(sess->ctx, args, "logMessage");
+    const char *cond_cstr = NULL, *log_msg_cstr = NULL;
+    if (JS_IsString(cond))
+      cond_cstr = JS_ToCString(sess->ctx, cond);
+    if (JS_IsString(log_msg))
+      log_msg_cstr = JS_ToCString(sess->ctx, log_msg);
+
+    int line_num, col_num, ret;
     JS_ToInt32(sess->ctx, &line_num, line);
     JS_ToInt32(sess->ctx, &col_num, col);
-    js_debug_set_breakpoint(sess->eval_ctx, file_cstr, line_num, col_num);
+    ret = js_debug_set_breakpoint2(sess->eval_ctx, file_cstr, line_num, col_num,
+                                   cond_cstr, log_msg_cstr);
     JS_FreeCString(sess->ctx, file_cstr);
+    JS_FreeCString(sess->ctx, cond_cstr);
+    JS_FreeCString(sess->ctx, log_msg_cstr);
     JS_FreeValue(sess->ctx, file);
+    JS_FreeValue(sess->ctx, cond);
+    JS_FreeValue(sess->ctx, log_msg);
 
+    if (ret) {
+      err_msg = "failed to set breakpoint";
+      goto fail;
+    }
     goto succ;
   }
 
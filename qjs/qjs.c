@@ -294,9 +294,16 @@ void help(void) {
 #endif
       "-T  --trace        trace memory allocation\n"
       "-d  --dump         dump the memory usage stats\n"
+      "    --dump-opcode-stats    dump the execution counts of the opcodes\n"
       "    --debug n      start a debugger at port 'n'\n"
       "    --memory-limit n       limit the memory usage to 'n' bytes\n"
       "    --stack-size n         limit the stack size to 'n' bytes\n"
+      "    --gc-pause-budget n    split the automatic cycle collection in "
+      "slices of about 'n' microseconds\n"
+      "    --cpu-prof file        write the CPU profile of the script into "
+      "'file'\n"
+      "    --cpu-prof-interval n  sample the CPU profile every 'n' "
+      "microseconds\n"
       "    --unhandled-rejection  dump unhandled promise rejections\n"
       "-q  --quit         just instantiate the interpreter and quit\n");
   exit(1);
@@ -319,12 +326,16 @@ int main(int argc, char **argv) {
   int dump_unhandled_promise_rejection = 0;
   size_t memory_limit = 0;
   int debug_port = 0;
+  const char *cpu_prof_file = NULL;
+  int dump_opcode_stats = 0;
+  int cpu_prof_interval = 1000;
   char *include_list[32];
   int i, include_count = 0;
 #ifdef CONFIG_BIGNUM
   int load_jscalc;
 #endif
   size_t stack_size = 0;
+  int gc_pause_budget = 0;
 
 #ifdef CONFIG_BIGNUM
   /* load jscalc runtime if invoked as 'qjscalc' */
@@ -450,6 +461,38 @@ int main(int argc, char **argv) {
         }
         continue;
       }
+      if (!strcmp(longopt, "dump-opcode-stats")) {
+        dump_opcode_stats++;
+        continue;
+      }
+      if (!strcmp(longopt, "cpu-prof")) {
+        if (optind >= argc) {
+          fprintf(stderr, "expecting a file to write the CPU profile\n");
+          exit(1);
+        }
+        cpu_prof_file = argv[optind++];
+        continue;
+      }
+      if (!strcmp(longopt, "cpu-prof-interval")) {
+        if (optind >= argc) {
+          fprintf(stderr, "expecting a sampling interval\n");
+          exit(1);
+        }
+        cpu_prof_interval = atoi(argv[optind++]);
+        if (cpu_prof_interval <= 0) {
+          fprintf(stderr, "expecting a valid sampling interval\n");
+          exit(1);
+        }
+        continue;
+      }
+      if (!strcmp(longopt, "gc-pause-budget")) {
+        if (optind >= argc) {
+          fprintf(stderr, "expecting a pause budget\n");
+          exit(1);
+        }
+        gc_pause_budget = atoi(argv[optind++]);
+        continue;
+      }
       if (!strcmp(longopt, "stack-size")) {
         if (optind >= argc) {
           fprintf(stderr, "expecting stack size\n");
@@ -491,6 +534,8 @@ int main(int argc, char **argv) {
     JS_SetMemoryLimit(rt, memory_limit);
   if (stack_size != 0)
     JS_SetMaxStackSize(rt, stack_size);
+  if (gc_pause_budget != 0)
+    JS_SetGCPauseBudget(rt, gc_pause_budget);
   js_std_set_worker_new_context_func(JS_NewCustomContext);
   js_std_init_handlers(rt);
   ctx = JS_NewCustomContext(rt);
@@ -507,6 +552,11 @@ int main(int argc, char **argv) {
                                       NULL);
   }
 
+  if (cpu_prof_file && JS_StartCPUProfile(rt, cpu_prof_interval)) {
+    fprintf(stderr, "qjs: cannot start the CPU profiler\n");
+    exit(2);
+  }
+
   if (!empty_run) {
 #ifdef CONFIG_BIGNUM
     if (load_jscalc) {
@@ -547,11 +597,17 @@ int main(int argc, char **argv) {
     js_std_loop(ctx);
   }
 
+  if (cpu_prof_file && JS_StopCPUProfile(rt, cpu_prof_file))
+    fprintf(stderr, "qjs: cannot write the CPU profile to '%s'\n",
+            cpu_prof_file);
+
   if (dump_memory) {
     JSMemoryUsage stats;
     JS_ComputeMemoryUsage(rt, &stats);
     JS_DumpMemoryUsage(stdout, &stats, rt);
   }
+  if (dump_opcode_stats)
+    JS_DumpOpcodeStats(rt, stdout);
   js_std_free_handlers(rt);
   JS_FreeContext(ctx);
   JS_FreeRuntime(rt);
@@ -582,6 +638,8 @@ int main(int argc, char **argv) {
   }
   return 0;
 fail:
+  if (cpu_prof_file)
+    JS_StopCPUProfile(rt, cpu_prof_file);
   js_std_free_handlers(rt);
   JS_FreeContext(ctx);
   JS_FreeRuntime(rt);
@@ -90,6 +90,23 @@ typedef enum JSErrorEnum {
   JS_NATIVE_ERROR_COUNT, /* number of different NativeError objects */
 } JSErrorEnum;
 
+/* the slab allocator serves the blocks of at most
+   `JS_SLAB_CLASS_COUNT << JS_SLAB_CLASS_SHIFT` bytes, rounded up to a
+   multiple of `1 << JS_SLAB_CLASS_SHIFT` */
+#define JS_SLAB_CLASS_SHIFT 4
+#define JS_SLAB_CLASS_COUNT 16
+#define JS_SLAB_PAGE_SIZE 4096
+
+typedef struct JSSlabBlock {
+  struct JSSlabBlock *next;
+} JSSlabBlock;
+
+typedef struct JSSlabPage {
+  struct JSSlabPage *next;
+  int size_class;
+  int free_count; /* only valid in js_slab_trim() */
+} JSSlabPage;
+
 typedef enum {
   JS_GC_PHASE_NONE,
   JS_GC_PHASE_DECREF,
@@ -119,6 +136,15 @@ typedef struct {
 struct JSRuntime {
   JSMallocFunctions mf;
   JSMallocState malloc_state;
+  /* the small VM structures (objects, shapes, variable references and
+     short strings) are allocated from pages of blocks of the same size
+     class if `slab_enabled` is set */
+  BOOL slab_enabled : 8;
+  JSSlabBlock *slab_free_list[JS_SLAB_CLASS_COUNT];
+  JSSlabPage *slab_page_list;
+  int64_t slab_page_count;
+  int64_t slab_count; /* number of allocated blocks */
+  int64_t slab_size;  /* total size of the allocated blocks */
   const char *rt_info;
 
   int atom_hash_size; /* power of two */
@@ -134,15 +160,32 @@ struct JSRuntime {
 
   struct list_head context_list; /* list of JSContext.link */
   /* list of JSGCObjectHeader.link. List of allocated GC objects (used
-     by the garbage collector) */
+     by the garbage collector). The objects whose reference count was
+     decremented to a non zero value since the last GC are moved to its
+     head with `root_buffered` set, they are the possible roots of the
+     garbage cycles */
   struct list_head gc_obj_list;
   /* list of JSGCObjectHeader.link. Used during JS_FreeValueRT() */
   struct list_head gc_zero_ref_count_list;
   struct list_head tmp_obj_list; /* used during GC */
   JSGCPhaseEnum gc_phase : 8;
   size_t malloc_gc_threshold;
+  /* number of automatic GCs run from the possible roots since the last
+     full GC */
+  int gc_root_run_count;
+  /* maximum pause of a slice of the automatic GC in microseconds, 0 if
+     the collection is not split */
+  int gc_pause_budget;
+  /* a sliced collection is not finished */
+  BOOL gc_slice_pending : 8;
 #ifdef DUMP_LEAKS
   struct list_head string_list; /* list of JSString.link */
+#endif
+#ifdef DUMP_OPCODE_STATS
+  /* execution counts of the opcodes, the pairs are indexed by
+     `(prev_opcode << 8) | opcode` */
+  uint64_t opcode_stats[256];
+  uint64_t *opcode_pair_stats;
 #endif
   /* stack limitation */
   uintptr_t stack_size; /* in bytes, 0 if no limit */
@@ -161,6 +204,8 @@ struct JSRuntime {
   JSPcInterruptHandler *pc_interrupt_handler;
   void *pc_interrupt_opaque;
 
+  struct JSCPUProfile *cpu_profile; /* NULL if the CPU profiler is stopped */
+
   JSHostPromiseRejectionTracker *host_promise_rejection_tracker;
   void *host_promise_rejection_tracker_opaque;
 
@@ -178,7 +223,14 @@ struct JSRuntime {
   int shape_hash_bits;
   int shape_hash_size;
   int shape_hash_count; /* number of hashed shapes */
+  uint32_t shape_id; /* last `JSShape.id` */
   JSShape **shape_hash;
+  /* WeakMap/WeakSet records (list of JSMapRecord.next_weak_ref) indexed
+     by the hash of their key. NULL if no weak reference was created */
+  int weak_ref_hash_bits;
+  int weak_ref_hash_size;
+  int weak_ref_count;
+  struct JSMapRecord **weak_ref_hash;
 #ifdef CONFIG_BIGNUM
   bf_context_t bf_ctx;
   JSNumericOperations bigint_ops;
@@ -227,9 +279,16 @@ typedef enum {
 struct JSGCObjectHeader {
   int ref_count; /* must come first, 32-bit */
   JSGCObjectTypeEnum gc_obj_type : 4;
-  uint8_t mark : 4; /* used by the GC */
-  uint8_t dummy1;   /* not used by the GC */
-  uint16_t dummy2;  /* not used by the GC */
+  uint8_t mark : 2; /* used by the GC */
+  /* JSObject: set if the object may be the key of WeakMap/WeakSet
+     records, which are in JSRuntime.weak_ref_hash */
+  uint8_t has_weak_ref : 1;
+  /* set if the object is in the possible cycle roots at the head of
+     JSRuntime.gc_obj_list. Must be the last bit of the byte, it is
+     tested with JS_GC_FLAG_ROOT_BUFFERED by JS_FreeValue() */
+  uint8_t root_buffered : 1;
+  uint8_t dummy1;  /* not used by the GC */
+  uint16_t dummy2; /* not used by the GC */
   struct list_head link;
 };
 
@@ -264,10 +323,20 @@ typedef struct JSFloatEnv {
 #endif
 
 typedef struct JSBreakpoint {
-  struct list_head link;
   JSAtom file;
   int line;
   int col;
+  int count; /* number of the breakpoints in `file` for the per-file entry */
+  char *condition;   /* only pause if it's truthy, NULL if unconditional */
+  char *log_message; /* logpoint: print it instead of pausing if not NULL */
+  /* `condition` and `log_message` compiled into the functions taking the
+     variables of the bytecode function `compiled_for` as their parameters */
+  JSValue compiled_for;
+  JSValue cond_func;
+  JSValue log_func;
+  int *param_idx; /* variable index of `compiled_for` -> parameter index */
+  int param_count;
+  struct JSBreakpoint *next_free; /* in the list `ctx->debug.bp_free_list` */
 } JSBreakpoint;
 
 struct JSContext {
@@ -326,7 +395,18 @@ struct JSContext {
     pthread_mutex_t bp_mutex;
     pthread_cond_t bp_cond;
     BOOL paused;
-    struct list_head bps;
+    /* open addressing hash set of the breakpoints keyed by (file, line, col),
+       see `js_debug_bp_find_slot` */
+    JSBreakpoint **bp_hash;
+    uint32_t bp_hash_size; /* power of two */
+    uint32_t bp_count;
+    uint32_t bp_gen; /* increased when the breakpoints change */
+    /* breakpoints holding JS values are freed on the thread running the
+       script */
+    JSBreakpoint *bp_free_list;
+    BOOL in_trap; /* evaluating the condition or the log message */
+    JSDebugLogHandler *log_handler;
+    void *log_opaque;
   } debug;
 
   void *user_opaque;
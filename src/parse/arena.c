@@ -0,0 +1,137 @@
+#include "parse.h"
+
+/* The variable, scope, label, constant pool and closure variable arrays
+   of the function definitions of a parse session are allocated by
+   bumping a pointer in chunks owned by the root function definition. The
+   blocks are never freed one by one: all the chunks are released when the
+   root function is created or freed. The function definitions themselves
+   are not in the arena so that each one is freed as soon as its function
+   is created, and the jump, location and relocation slots use an arena
+   released at the end of resolve_labels(). The byte code and pc2line
+   buffers are not in the arena because they grow large and the pc2line
+   buffer is kept by the function bytecode. */
+
+#define JS_PARSE_ARENA_CHUNK_MIN 4096
+#define JS_PARSE_ARENA_CHUNK_MAX (256 * 1024)
+#define JS_PARSE_ARRAY_SIZE_MIN 4
+
+void js_parse_arena_init(JSParseArena *a) {
+  a->chunk_list = NULL;
+  a->ptr = NULL;
+  a->end = NULL;
+  a->chunk_size = JS_PARSE_ARENA_CHUNK_MIN;
+}
+
+void js_parse_arena_free(JSRuntime *rt, JSParseArena *a) {
+  JSParseArenaChunk *c, *c_next;
+
+  for (c = a->chunk_list; c != NULL; c = c_next) {
+    c_next = c->next;
+    js_free_rt(rt, c);
+  }
+  js_parse_arena_init(a);
+}
+
+/* 'size' is aligned */
+void *js_parse_arena_alloc_slow(JSFunctionDef *fd, size_t size) {
+  JSParseArena *a = fd->arena;
+  JSParseArenaChunk *c;
+  size_t chunk_size;
+
+  if (size > a->chunk_size / 4) {
+    /* large block: use a dedicated chunk inserted after the current one
+       so that its free space is kept */
+    c = js_malloc(fd->ctx, sizeof(*c) + size);
+    if (!c)
+      return NULL;
+    c->size = size;
+    if (a->chunk_list) {
+      c->next = a->chunk_list->next;
+      a->chunk_list->next = c;
+    } else {
+      c->next = NULL;
+      a->chunk_list = c;
+    }
+    return c->data;
+  }
+  chunk_size = a->chunk_size;
+  c = js_malloc(fd->ctx, sizeof(*c) + chunk_size);
+  if (!c)
+    return NULL;
+  c->size = chunk_size;
+  c->next = a->chunk_list;
+  a->chunk_list = c;
+  a->ptr = c->data + size;
+  a->end = c->data + chunk_size;
+  a->chunk_size = min_uint32(chunk_size * 2, JS_PARSE_ARENA_CHUNK_MAX);
+  return c->data;
+}
+
+void *js_parse_allocz(JSFunctionDef *fd, size_t size) {
+  void *ptr;
+  ptr = js_parse_alloc(fd, size);
+  if (!ptr)
+    return NULL;
+  return memset(ptr, 0, size);
+}
+
+/* 'ptr' is left unchanged if error. The block is extended in place if it
+   is the last one of the current chunk */
+void *js_parse_realloc(JSFunctionDef *fd, void *ptr, size_t old_size,
+                       size_t new_size) {
+  JSParseArena *a = fd->arena;
+  JSParseArenaChunk **pc, *c;
+  size_t align_mask = JS_PARSE_ARENA_ALIGN - 1;
+  uint8_t *new_ptr;
+
+  if (!ptr)
+    return js_parse_alloc(fd, new_size);
+  old_size = (old_size + align_mask) & ~align_mask;
+  new_size = (new_size + align_mask) & ~align_mask;
+  if ((uint8_t *)ptr + old_size == a->ptr &&
+      new_size - old_size <= (size_t)(a->end - a->ptr)) {
+    a->ptr = (uint8_t *)ptr + new_size;
+    return ptr;
+  }
+  if (new_size <= old_size)
+    return ptr;
+  if (old_size > JS_PARSE_ARENA_CHUNK_MIN / 4) {
+    /* a block filling a chunk which is not the current one is either a
+       large block or the only block of its chunk: it is resized with the
+       chunk instead of leaving a copy behind */
+    for (pc = &a->chunk_list; (c = *pc) != NULL; pc = &c->next) {
+      if (c->data == ptr && c->size == old_size &&
+          a->end != c->data + c->size) {
+        c = js_realloc(fd->ctx, c, sizeof(*c) + new_size);
+        if (!c)
+          return NULL;
+        c->size = new_size;
+        *pc = c;
+        return c->data;
+      }
+    }
+  }
+  new_ptr = js_parse_alloc(fd, new_size);
+  if (!new_ptr)
+    return NULL;
+  memcpy(new_ptr, ptr, old_size);
+  return new_ptr;
+}
+
+no_inline int js_parse_realloc_array(JSFunctionDef *fd, void **parray,
+                                     int elem_size, int *psize, int req_size) {
+  int new_size;
+  void *new_array;
+  /* XXX: potential arithmetic overflow */
+  new_size = max_int(req_size, *psize * 3 / 2);
+  /* the old block is kept if another array was allocated since then, so
+     skip the smallest sizes */
+  new_size = max_int(new_size, JS_PARSE_ARRAY_SIZE_MIN);
+  new_array = js_parse_realloc(fd, *parray, (size_t)*psize * elem_size,
+                               (size_t)new_size * elem_size);
+  if (!new_array)
+    return -1;
+  *psize = new_size;
+  *parray = new_array;
+  return 0;
+}
@@ -66,9 +66,9 @@ int new_label_fd(JSFunctionDef *fd, int label) {
   LabelSlot *ls;
 
   if (label < 0) {
-    if (js_resize_array(fd->ctx, (void *)&fd->label_slots,
-                        sizeof(fd->label_slots[0]), &fd->label_size,
-                        fd->label_count + 1))
+    if (js_parse_resize_array(fd, (void *)&fd->label_slots,
+                              sizeof(fd->label_slots[0]), &fd->label_size,
+                              fd->label_count + 1))
       return -1;
     label = fd->label_count++;
     ls = &fd->label_slots[label];
@@ -112,8 +112,8 @@ int emit_goto(JSParseState *s, int opcode, int label) {
 int cpool_add(JSParseState *s, JSValue val) {
   JSFunctionDef *fd = s->cur_func;
 
-  if (js_resize_array(s->ctx, (void *)&fd->cpool, sizeof(fd->cpool[0]),
-                      &fd->cpool_size, fd->cpool_count + 1))
+  if (js_parse_resize_array(fd, (void *)&fd->cpool, sizeof(fd->cpool[0]),
+                            &fd->cpool_size, fd->cpool_count + 1))
     return -1;
   fd->cpool[fd->cpool_count++] = val;
   return fd->cpool_count - 1;
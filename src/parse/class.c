@@ -533,11 +533,8 @@ __exception int js_parse_class(JSParseState *s, BOOL is_class_expr,
 
   /* store the class source code in the constructor. */
   if (!(fd->js_mode & JS_MODE_STRIP)) {
-    js_free(ctx, ctor_fd->source);
-    ctor_fd->source_len = s->buf_ptr - class_start_ptr;
-    ctor_fd->source =
-        js_strndup(ctx, (const char *)class_start_ptr, ctor_fd->source_len);
-    if (!ctor_fd->source)
+    if (js_parse_save_source(s, ctor_fd, class_start_ptr,
+                             s->buf_ptr - class_start_ptr))
       goto fail;
   }
 
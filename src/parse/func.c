@@ -179,6 +179,45 @@ duplicate:
                         "duplicate argument names not allowed in this context");
 }
 
+/* the functions defined in 'fd' point to the source of 'fd' which
+   starts at 'ptr' in the input and is stored in 'src' */
+static void js_parse_share_source(JSContext *ctx, JSFunctionDef *fd,
+                                  JSFunctionSource *src, const uint8_t *ptr) {
+  struct list_head *el;
+  JSFunctionDef *fd1;
+
+  list_for_each(el, &fd->child_list) {
+    fd1 = list_entry(el, JSFunctionDef, link);
+    if (fd1->source_buf) {
+      js_free_function_source(ctx->rt, fd1->source_buf);
+      fd1->source_buf = js_dup_function_source(src);
+      fd1->source = src->buf + (fd1->source_ptr - ptr);
+    }
+    js_parse_share_source(ctx, fd1, src, ptr);
+  }
+}
+
+/* save the source code of 'fd' for Function.prototype.toString() */
+int js_parse_save_source(JSParseState *s, JSFunctionDef *fd,
+                         const uint8_t *ptr, int len) {
+  JSFunctionSource *src;
+
+  src = js_malloc(s->ctx, sizeof(*src) + len + 1);
+  if (!src)
+    return -1;
+  src->ref_count = 1;
+  src->len = len;
+  memcpy(src->buf, ptr, len);
+  src->buf[len] = '\0';
+  js_free_function_source(s->ctx->rt, fd->source_buf);
+  fd->source_buf = src;
+  fd->source = src->buf;
+  fd->source_len = len;
+  fd->source_ptr = ptr;
+  js_parse_share_source(s->ctx, fd, src, ptr);
+  return 0;
+}
+
 /* func_name must be JS_ATOM_NULL for JS_PARSE_FUNC_STATEMENT and
    JS_PARSE_FUNC_EXPR, JS_PARSE_FUNC_ARROW and JS_PARSE_FUNC_VAR */
 __exception int
@@ -574,9 +613,7 @@ js_parse_function_decl2(JSParseState *s, JSParseFunctionEnum func_type,
         /* save the function source code */
         /* the end of the function source code is after the last
            token of the function source stored into s->last_ptr */
-        fd->source_len = s->last_ptr - ptr;
-        fd->source = js_strndup(ctx, (const char *)ptr, fd->source_len);
-        if (!fd->source)
+        if (js_parse_save_source(s, fd, ptr, s->last_ptr - ptr))
           goto fail;
       }
       goto done;
@@ -599,9 +636,7 @@ js_parse_function_decl2(JSParseState *s, JSParseFunctionEnum func_type,
   }
   if (!(fd->js_mode & JS_MODE_STRIP)) {
     /* save the function source code */
-    fd->source_len = s->buf_ptr - ptr;
-    fd->source = js_strndup(ctx, (const char *)ptr, fd->source_len);
-    if (!fd->source)
+    if (js_parse_save_source(s, fd, ptr, s->buf_ptr - ptr))
       goto fail;
   }
 
@@ -845,8 +880,9 @@ int add_closure_var(JSContext *ctx, JSFunctionDef *s, BOOL is_local,
     return -1;
   }
 
-  if (js_resize_array(ctx, (void **)&s->closure_var, sizeof(s->closure_var[0]),
-                      &s->closure_var_size, s->closure_var_count + 1))
+  if (js_parse_resize_array(s, (void **)&s->closure_var,
+                            sizeof(s->closure_var[0]), &s->closure_var_size,
+                            s->closure_var_count + 1))
     return -1;
   cv = &s->closure_var[s->closure_var_count++];
   cv->is_local = is_local;
@@ -1074,7 +1110,7 @@ __exception int add_closure_variables(JSContext *ctx, JSFunctionDef *s,
   s->closure_var_size = count;
   if (count == 0)
     return 0;
-  s->closure_var = js_malloc(ctx, sizeof(s->closure_var[0]) * count);
+  s->closure_var = js_parse_alloc(s, sizeof(s->closure_var[0]) * count);
   if (!s->closure_var)
     return -1;
   /* Add lexical variables in scope at the point of evaluation */
@@ -1139,9 +1175,18 @@ JSFunctionDef *js_new_function_def(JSContext *ctx, JSFunctionDef *parent,
                                    const char *filename, int line_num) {
   JSFunctionDef *fd;
 
+  /* the function definition is not in the arena so that it is released
+     as soon as the function is created */
   fd = js_mallocz(ctx, sizeof(*fd));
   if (!fd)
     return NULL;
+  if (parent) {
+    /* the child functions share the arena of the root function */
+    fd->arena = parent->arena;
+  } else {
+    js_parse_arena_init(&fd->root_arena);
+    fd->arena = &fd->root_arena;
+  }
 
   fd->ctx = ctx;
   init_list_head(&fd->child_list);
@@ -1203,48 +1248,39 @@ void js_free_function_def(JSContext *ctx, JSFunctionDef *fd) {
   free_bytecode_atoms(ctx->rt, fd->byte_code.buf, fd->byte_code.size,
                       fd->use_short_opcodes);
   dbuf_free(&fd->byte_code);
-  js_free(ctx, fd->jump_slots);
-  js_free(ctx, fd->label_slots);
-  js_free(ctx, fd->loc_slots);
 
   for (i = 0; i < fd->cpool_count; i++) {
     JS_FreeValue(ctx, fd->cpool[i]);
   }
-  js_free(ctx, fd->cpool);
 
   JS_FreeAtom(ctx, fd->func_name);
 
   for (i = 0; i < fd->var_count; i++) {
     JS_FreeAtom(ctx, fd->vars[i].var_name);
   }
-  js_free(ctx, fd->vars);
   for (i = 0; i < fd->arg_count; i++) {
     JS_FreeAtom(ctx, fd->args[i].var_name);
   }
-  js_free(ctx, fd->args);
 
   for (i = 0; i < fd->global_var_count; i++) {
     JS_FreeAtom(ctx, fd->global_vars[i].var_name);
   }
-  js_free(ctx, fd->global_vars);
 
   for (i = 0; i < fd->closure_var_count; i++) {
     JSClosureVar *cv = &fd->closure_var[i];
     JS_FreeAtom(ctx, cv->var_name);
   }
-  js_free(ctx, fd->closure_var);
-
-  if (fd->scopes != fd->def_scope_array)
-    js_free(ctx, fd->scopes);
 
   JS_FreeAtom(ctx, fd->filename);
   dbuf_free(&fd->pc2line);
 
-  js_free(ctx, fd->source);
+  js_free_function_source(ctx->rt, fd->source_buf);
 
   if (fd->parent) {
-    /* remove in parent list */
+    /* remove in parent list. The arrays are released with the arena. */
     list_del(&fd->link);
+  } else {
+    js_parse_arena_free(ctx->rt, fd->arena);
   }
   js_free(ctx, fd);
 }
@@ -1288,6 +1324,9 @@ int add_module_variables(JSContext *ctx, JSFunctionDef *fd) {
 JSValue js_create_function(JSContext *ctx, JSFunctionDef *fd) {
   JSValue func_obj;
   JSFunctionBytecode *b;
+  JSInlineCache *ic = NULL;
+  JSPolyInlineCache *pic = NULL;
+  JSGlobalInlineCache *gic = NULL;
   struct list_head *el, *el1;
   int stack_size, scope, idx;
   int function_size, byte_code_offset, cpool_offset;
@@ -1353,7 +1392,8 @@ JSValue js_create_function(JSContext *ctx, JSFunctionDef *fd) {
     dump_byte_code(ctx, 1, fd->byte_code.buf, fd->byte_code.size, fd->args,
                    fd->arg_count, fd->vars, fd->var_count, fd->closure_var,
                    fd->closure_var_count, fd->cpool, fd->cpool_count,
-                   fd->source, fd->line_num, fd->label_slots, NULL);
+                   fd->source, fd->source_len, fd->line_num, fd->label_slots,
+                   NULL);
     printf("\n");
   }
 #endif
@@ -1374,7 +1414,8 @@ JSValue js_create_function(JSContext *ctx, JSFunctionDef *fd) {
     dump_byte_code(ctx, 2, fd->byte_code.buf, fd->byte_code.size, fd->args,
                    fd->arg_count, fd->vars, fd->var_count, fd->closure_var,
                    fd->closure_var_count, fd->cpool, fd->cpool_count,
-                   fd->source, fd->line_num, fd->label_slots, NULL);
+                   fd->source, fd->source_len, fd->line_num, fd->label_slots,
+                   NULL);
     printf("\n");
   }
 #endif
@@ -1403,10 +1444,37 @@ JSValue js_create_function(JSContext *ctx, JSFunctionDef *fd) {
   byte_code_offset = function_size;
   function_size += fd->byte_code.size;
 
+  if (fd->ic_count) {
+    ic = js_mallocz(ctx, sizeof(ic[0]) * fd->ic_count);
+    if (!ic)
+      goto fail;
+  }
+  if (fd->pic_count) {
+    pic = js_mallocz(ctx, sizeof(pic[0]) * fd->pic_count);
+    if (!pic)
+      goto fail_ic;
+  }
+  if (fd->gic_count) {
+    gic = js_mallocz(ctx, sizeof(gic[0]) * fd->gic_count);
+    if (!gic)
+      goto fail_ic;
+  }
+
   b = js_mallocz(ctx, function_size);
-  if (!b)
+  if (!b) {
+  fail_ic:
+    js_free(ctx, ic);
+    js_free(ctx, pic);
+    js_free(ctx, gic);
     goto fail;
+  }
   b->header.ref_count = 1;
+  b->ic = ic;
+  b->ic_count = fd->ic_count;
+  b->pic = pic;
+  b->pic_count = fd->pic_count;
+  b->gic = gic;
+  b->gic_count = fd->gic_count;
 
   b->byte_code_buf = (void *)((uint8_t *)b + byte_code_offset);
   b->byte_code_len = fd->byte_code.size;
@@ -1438,16 +1506,12 @@ JSValue js_create_function(JSContext *ctx, JSFunctionDef *fd) {
     b->var_count = fd->var_count;
     b->arg_count = fd->arg_count;
     b->defined_arg_count = fd->defined_arg_count;
-    js_free(ctx, fd->args);
-    js_free(ctx, fd->vars);
   }
   b->cpool_count = fd->cpool_count;
   if (b->cpool_count) {
     b->cpool = (void *)((uint8_t *)b + cpool_offset);
     memcpy(b->cpool, fd->cpool, b->cpool_count * sizeof(*b->cpool));
   }
-  js_free(ctx, fd->cpool);
-  fd->cpool = NULL;
 
   b->stack_size = stack_size;
 
@@ -1471,9 +1535,8 @@ JSValue js_create_function(JSContext *ctx, JSFunctionDef *fd) {
     b->debug.pc2line_len = fd->pc2line.size;
     b->debug.source = fd->source;
     b->debug.source_len = fd->source_len;
+    b->debug.source_buf = fd->source_buf;
   }
-  if (fd->scopes != fd->def_scope_array)
-    js_free(ctx, fd->scopes);
 
   b->closure_var_count = fd->closure_var_count;
   if (b->closure_var_count) {
@@ -1481,8 +1544,6 @@ JSValue js_create_function(JSContext *ctx, JSFunctionDef *fd) {
     memcpy(b->closure_var, fd->closure_var,
            b->closure_var_count * sizeof(*b->closure_var));
   }
-  js_free(ctx, fd->closure_var);
-  fd->closure_var = NULL;
 
   b->has_prototype = fd->has_prototype;
   b->has_simple_parameter_list = fd->has_simple_parameter_list;
@@ -1508,8 +1569,9 @@ JSValue js_create_function(JSContext *ctx, JSFunctionDef *fd) {
   if (fd->parent) {
     /* remove from parent list */
     list_del(&fd->link);
+  } else {
+    js_parse_arena_free(ctx->rt, fd->arena);
   }
-
   js_free(ctx, fd);
   return JS_MKPTR(JS_TAG_FUNCTION_BYTECODE, b);
 fail:
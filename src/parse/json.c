@@ -1,6 +1,16 @@
 #include "parse.h"
 
+#include "utils/dtoa.h"
+#include "vm/class.h"
 #include "vm/conv.h"
+#include "vm/error.h"
+#include "vm/obj.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 /* 'c' is the first character. Return JS_ATOM_NULL in case of error */
 JSAtom json_parse_ident(JSParseState *s, const uint8_t **pp, int c) {
@@ -198,17 +208,15 @@ redo:
     /* number */
   parse_number : {
     JSValue ret;
-    int flags, radix;
     if (!s->ext_json) {
-      flags = 0;
-      radix = 10;
+      /* the number starts with a digit or '-' and a digit */
+      ret = JS_NewFloat64(s->ctx, js_atod((const char *)p, (const char **)&p));
     } else {
-      flags = ATOD_ACCEPT_BIN_OCT;
-      radix = 0;
+      ret = js_atof(s->ctx, (const char *)p, (const char **)&p, 0,
+                    ATOD_ACCEPT_BIN_OCT);
+      if (JS_IsException(ret))
+        goto fail;
     }
-    ret = js_atof(s->ctx, (const char *)p, (const char **)&p, radix, flags);
-    if (JS_IsException(ret))
-      goto fail;
     s->token.val = TOK_NUMBER;
     s->token.u.num.val = ret;
   } break;
@@ -361,3 +369,587 @@ fail:
   JS_FreeValue(ctx, val);
   return JS_EXCEPTION;
 }
+
+/* -- Strict JSON scanner ----------------------------------- */
+
+/* JSON.parse() does not use the tokens of JSParseState: the values are
+   built while scanning the input */
+#define JSON_SHAPE_CACHE_SIZE 64 /* power of two */
+
+typedef struct JSONScanProp {
+  JSAtom atom;
+  JSValue val;
+} JSONScanProp;
+
+typedef struct JSONScanState {
+  JSContext *ctx;
+  const char *filename;
+  const uint8_t *buf_start;
+  const uint8_t *buf_end; /* points to the terminating zero */
+  /* stack of the properties of the objects being parsed */
+  JSONScanProp *props;
+  int props_count;
+  int props_size;
+  /* last shape built for the key sequences of each hash. The record
+     arrays repeat the same keys in the same order */
+  JSShape *shape_cache[JSON_SHAPE_CACHE_SIZE];
+} JSONScanState;
+
+static JSValue json_scan_value(JSONScanState *s, const uint8_t **pp);
+
+static void __attribute__((format(printf, 3, 4)))
+json_scan_error(JSONScanState *s, const uint8_t *ptr, const char *fmt, ...) {
+  const uint8_t *p;
+  va_list ap;
+  int line_num;
+
+  /* the line number is only computed for the errors */
+  line_num = 1;
+  for (p = s->buf_start; p < ptr; p++) {
+    if (*p == '\n' || (*p == '\r' && p[1] != '\n'))
+      line_num++;
+  }
+  va_start(ap, fmt);
+  JS_ThrowError2(s->ctx, JS_SYNTAX_ERROR, fmt, ap, FALSE);
+  va_end(ap);
+  build_backtrace(s->ctx, s->ctx->rt->current_exception, s->filename, line_num,
+                  0);
+}
+
+static BOOL json_is_ident_next(int c) {
+  return c < 128 && ((lre_id_continue_table_ascii[c >> 5] >> (c & 31)) & 1);
+}
+
+static void json_scan_unexpected(JSONScanState *s, const uint8_t *p) {
+  const uint8_t *p_end;
+
+  if (*p == '\0' && p >= s->buf_end) {
+    json_scan_error(s, p, "unexpected end of input");
+  } else if (*p >= 128) {
+    json_scan_error(s, p, "unexpected character");
+  } else {
+    p_end = p + 1;
+    if (json_is_ident_next(*p)) {
+      while (json_is_ident_next(*p_end))
+        p_end++;
+    }
+    json_scan_error(s, p, "unexpected token: '%.*s'", (int)(p_end - p), p);
+  }
+}
+
+static inline const uint8_t *json_skip_spaces(const uint8_t *p) {
+  while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
+    p++;
+  return p;
+}
+
+/* return the first '"', '\\', control or non ASCII character. The input
+   ends with a zero, which is a control character */
+static const uint8_t *json_find_special(const uint8_t *p, const uint8_t *end) {
+  int c;
+#if defined(__AVX2__)
+  __m256i quote = _mm256_set1_epi8('"'), bslash = _mm256_set1_epi8('\\');
+  __m256i space = _mm256_set1_epi8(' ');
+  for (; p + 32 <= end; p += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)p);
+    /* the signed comparison also matches the bytes >= 0x80 */
+    __m256i m = _mm256_or_si256(_mm256_cmpeq_epi8(v, quote),
+                                _mm256_cmpeq_epi8(v, bslash));
+    m = _mm256_or_si256(m, _mm256_cmpgt_epi8(space, v));
+    uint32_t mask = _mm256_movemask_epi8(m);
+    if (mask)
+      return p + ctz32(mask);
+  }
+#elif defined(__SSE2__)
+  __m128i quote = _mm_set1_epi8('"'), bslash = _mm_set1_epi8('\\');
+  __m128i space = _mm_set1_epi8(' ');
+  for (; p + 16 <= end; p += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    /* the signed comparison also matches the bytes >= 0x80 */
+    __m128i m =
+        _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, bslash));
+    m = _mm_or_si128(m, _mm_cmplt_epi8(v, space));
+    uint32_t mask = _mm_movemask_epi8(m);
+    if (mask)
+      return p + ctz32(mask);
+  }
+#endif
+  for (;;) {
+    c = *p;
+    if (c == '"' || c == '\\' || c < 0x20 || c >= 0x80)
+      break;
+    p++;
+  }
+  return p;
+}
+
+/* string with escapes or non ASCII characters. 'p_start' is after the
+   quote and 'p' is the first special character */
+static JSValue json_scan_string_slow(JSONScanState *s, const uint8_t *p_start,
+                                     const uint8_t *p, const uint8_t **pp) {
+  StringBuffer b_s, *b = &b_s;
+  const uint8_t *p_next;
+  uint32_t c;
+  int i, h;
+
+  if (string_buffer_init(s->ctx, b, p - p_start + 16))
+    goto fail;
+  if (string_buffer_write8(b, p_start, p - p_start))
+    goto fail;
+  for (;;) {
+    c = *p;
+    if (c == '"') {
+      break;
+    } else if (c == '\\') {
+      c = p[1];
+      switch (c) {
+      case '"':
+      case '\\':
+      case '/':
+        break;
+      case 'b':
+        c = '\b';
+        break;
+      case 'f':
+        c = '\f';
+        break;
+      case 'n':
+        c = '\n';
+        break;
+      case 'r':
+        c = '\r';
+        break;
+      case 't':
+        c = '\t';
+        break;
+      case 'u':
+        c = 0;
+        for (i = 0; i < 4; i++) {
+          h = from_hex(p[2 + i]);
+          if (h < 0)
+            goto invalid_escape;
+          c = (c << 4) | h;
+        }
+        p += 4;
+        break;
+      default:
+        if (c == '\0' && p + 1 >= s->buf_end)
+          goto unexpected_end;
+      invalid_escape:
+        json_scan_error(s, p, "malformed escape sequence in string literal");
+        goto fail;
+      }
+      p += 2;
+      /* the surrogate pairs are kept as two code units */
+      if (string_buffer_putc16(b, c))
+        goto fail;
+    } else if (c >= 0x80) {
+      c = unicode_from_utf8(p, UTF8_CHAR_LEN_MAX, &p_next);
+      if (c > 0x10FFFF) {
+        json_scan_error(s, p, "invalid UTF-8 sequence");
+        goto fail;
+      }
+      p = p_next;
+      if (string_buffer_putc(b, c))
+        goto fail;
+    } else if (c < 0x20) {
+      if (p >= s->buf_end) {
+      unexpected_end:
+        json_scan_error(s, p, "unexpected end of string");
+      } else {
+        json_scan_error(s, p, "invalid character in a JSON string");
+      }
+      goto fail;
+    }
+    p_start = p;
+    p = json_find_special(p, s->buf_end);
+    if (string_buffer_write8(b, p_start, p - p_start))
+      goto fail;
+  }
+  *pp = p + 1;
+  return string_buffer_end(b);
+fail:
+  string_buffer_free(b);
+  return JS_EXCEPTION;
+}
+
+/* '*pp' points to the opening quote */
+static JSValue json_scan_string(JSONScanState *s, const uint8_t **pp) {
+  const uint8_t *p_start, *p;
+
+  p_start = *pp + 1;
+  p = json_find_special(p_start, s->buf_end);
+  if (likely(*p == '"')) {
+    *pp = p + 1;
+    return js_new_string8(s->ctx, p_start, p - p_start);
+  }
+  return json_scan_string_slow(s, p_start, p, pp);
+}
+
+/* the ASCII keys are converted to atoms without creating a string if the
+   atom already exists */
+static JSAtom json_scan_key(JSONScanState *s, const uint8_t **pp) {
+  const uint8_t *p_start, *p;
+  JSValue str;
+
+  p_start = *pp + 1;
+  p = json_find_special(p_start, s->buf_end);
+  if (likely(*p == '"')) {
+    *pp = p + 1;
+    return JS_NewAtomLen(s->ctx, (const char *)p_start, p - p_start);
+  }
+  str = json_scan_string_slow(s, p_start, p, pp);
+  if (JS_IsException(str))
+    return JS_ATOM_NULL;
+  return JS_NewAtomStr(s->ctx, JS_VALUE_GET_STRING(str));
+}
+
+static JSValue json_scan_number(JSONScanState *s, const uint8_t **pp) {
+  const uint8_t *p, *p_start, *p_digits;
+  uint32_t n;
+  BOOL is_neg;
+
+  p = p_start = *pp;
+  is_neg = FALSE;
+  if (*p == '-') {
+    is_neg = TRUE;
+    p++;
+  }
+  p_digits = p;
+  n = 0;
+  if (*p == '0') {
+    /* no leading zeros */
+    if (is_digit(p[1]))
+      goto fail;
+    p++;
+  } else if (is_digit(*p)) {
+    do {
+      n = n * 10 + (*p - '0');
+      p++;
+    } while (is_digit(*p));
+  } else {
+    p = p_start;
+    goto fail;
+  }
+  /* small integer */
+  if (*p != '.' && *p != 'e' && *p != 'E' && p - p_digits <= 9 &&
+      !(is_neg && n == 0)) {
+    *pp = p;
+    return JS_NewInt32(s->ctx, is_neg ? -(int32_t)n : (int32_t)n);
+  }
+  if (*p == '.') {
+    p++;
+    if (!is_digit(*p))
+      goto fail;
+    while (is_digit(*p))
+      p++;
+  }
+  if (*p == 'e' || *p == 'E') {
+    p++;
+    if (*p == '+' || *p == '-')
+      p++;
+    if (!is_digit(*p))
+      goto fail;
+    while (is_digit(*p))
+      p++;
+  }
+  *pp = p;
+  return JS_NewFloat64(s->ctx, js_atod((const char *)p_start, NULL));
+fail:
+  json_scan_unexpected(s, p);
+  return JS_EXCEPTION;
+}
+
+/* add a property to an object created by the scanner: it has no setters
+   and all its properties are configurable and writable. 'val' is freed */
+static int json_scan_add_property(JSContext *ctx, JSObject *p, JSAtom atom,
+                                  JSValue val) {
+  JSShapeProperty *prs;
+  JSProperty *pr;
+
+  prs = find_own_property(&pr, p, atom);
+  if (unlikely(prs)) {
+    /* duplicate key: the last value is kept */
+    JS_FreeValue(ctx, pr->u.value);
+    pr->u.value = val;
+    return 0;
+  }
+  pr = add_property(ctx, p, atom, JS_PROP_C_W_E);
+  if (unlikely(!pr)) {
+    JS_FreeValue(ctx, val);
+    return -1;
+  }
+  pr->u.value = val;
+  return 0;
+}
+
+static int json_scan_push_prop(JSONScanState *s, JSAtom atom, JSValue val) {
+  JSONScanProp *props;
+  int new_size;
+
+  if (unlikely(s->props_count >= s->props_size)) {
+    new_size = max_int(16, s->props_size * 3 / 2);
+    props = js_realloc(s->ctx, s->props, sizeof(props[0]) * new_size);
+    if (!props) {
+      JS_FreeAtom(s->ctx, atom);
+      JS_FreeValue(s->ctx, val);
+      return -1;
+    }
+    s->props = props;
+    s->props_size = new_size;
+  }
+  s->props[s->props_count].atom = atom;
+  s->props[s->props_count].val = val;
+  s->props_count++;
+  return 0;
+}
+
+/* create the object from the properties above 'base' and pop them */
+static JSValue json_scan_new_object(JSONScanState *s, int base) {
+  JSContext *ctx = s->ctx;
+  JSONScanProp *props = s->props + base;
+  int i, n = s->props_count - base;
+  JSShape *sh, **psh;
+  JSObject *p;
+  JSValue obj;
+  uint32_t h;
+
+  h = n;
+  for (i = 0; i < n; i++)
+    h = (h ^ props[i].atom) * 0x9e3779b1;
+  psh = &s->shape_cache[(h >> 16) & (JSON_SHAPE_CACHE_SIZE - 1)];
+  sh = *psh;
+  if (sh && sh->prop_count == n) {
+    for (i = 0; i < n; i++) {
+      if (sh->prop[i].atom != props[i].atom)
+        goto slow_path;
+    }
+    /* same keys in the same order: the properties are filled in place */
+    obj = JS_NewObjectFromShape(ctx, js_dup_shape(sh), JS_CLASS_OBJECT);
+    if (JS_IsException(obj)) {
+      i = 0;
+      goto fail;
+    }
+    p = JS_VALUE_GET_OBJ(obj);
+    for (i = 0; i < n; i++) {
+      JS_FreeAtom(ctx, props[i].atom);
+      p->prop[i].u.value = props[i].val;
+    }
+    s->props_count = base;
+    return obj;
+  }
+slow_path:
+  i = 0;
+  obj = JS_NewObject(ctx);
+  if (JS_IsException(obj))
+    goto fail;
+  p = JS_VALUE_GET_OBJ(obj);
+  for (i = 0; i < n; i++) {
+    if (json_scan_add_property(ctx, p, props[i].atom, props[i].val)) {
+      props[i].val = JS_UNDEFINED;
+      JS_FreeValue(ctx, obj);
+      goto fail;
+    }
+    JS_FreeAtom(ctx, props[i].atom);
+  }
+  s->props_count = base;
+  /* only the shared shapes can be used by other objects. The cache keeps
+     a reference so that they are not modified in place */
+  if (p->shape->is_hashed) {
+    js_free_shape_null(ctx->rt, *psh);
+    *psh = js_dup_shape(p->shape);
+  }
+  return obj;
+fail:
+  for (; i < n; i++) {
+    JS_FreeAtom(ctx, props[i].atom);
+    JS_FreeValue(ctx, props[i].val);
+  }
+  s->props_count = base;
+  return JS_EXCEPTION;
+}
+
+static void json_scan_pop_props(JSONScanState *s, int base) {
+  while (s->props_count > base) {
+    s->props_count--;
+    JS_FreeAtom(s->ctx, s->props[s->props_count].atom);
+    JS_FreeValue(s->ctx, s->props[s->props_count].val);
+  }
+}
+
+static JSValue json_scan_object(JSONScanState *s, const uint8_t **pp) {
+  JSContext *ctx = s->ctx;
+  const uint8_t *p;
+  JSValue val;
+  JSAtom atom;
+  int base;
+
+  /* the properties are kept on a stack until the end of the object */
+  base = s->props_count;
+  p = json_skip_spaces(*pp + 1);
+  if (*p != '}') {
+    for (;;) {
+      if (*p != '"') {
+        json_scan_error(s, p, "expecting property name");
+        goto fail;
+      }
+      atom = json_scan_key(s, &p);
+      if (atom == JS_ATOM_NULL)
+        goto fail;
+      p = json_skip_spaces(p);
+      if (*p != ':') {
+        JS_FreeAtom(ctx, atom);
+        json_scan_error(s, p, "expecting '%c'", ':');
+        goto fail;
+      }
+      p = json_skip_spaces(p + 1);
+      val = json_scan_value(s, &p);
+      if (JS_IsException(val)) {
+        JS_FreeAtom(ctx, atom);
+        goto fail;
+      }
+      if (json_scan_push_prop(s, atom, val))
+        goto fail;
+      p = json_skip_spaces(p);
+      if (*p != ',')
+        break;
+      p = json_skip_spaces(p + 1);
+    }
+    if (*p != '}') {
+      json_scan_error(s, p, "expecting '%c'", '}');
+      goto fail;
+    }
+  }
+  *pp = p + 1;
+  return json_scan_new_object(s, base);
+fail:
+  json_scan_pop_props(s, base);
+  return JS_EXCEPTION;
+}
+
+static JSValue json_scan_array(JSONScanState *s, const uint8_t **pp) {
+  JSContext *ctx = s->ctx;
+  const uint8_t *p;
+  JSValue arr, val;
+
+  arr = JS_NewArray(ctx);
+  if (JS_IsException(arr))
+    return arr;
+  p = json_skip_spaces(*pp + 1);
+  if (*p != ']') {
+    for (;;) {
+      val = json_scan_value(s, &p);
+      if (JS_IsException(val))
+        goto fail;
+      /* the new array stays a fast array */
+      if (add_fast_array_element(ctx, JS_VALUE_GET_OBJ(arr), val, 0) < 0)
+        goto fail;
+      p = json_skip_spaces(p);
+      if (*p != ',')
+        break;
+      p = json_skip_spaces(p + 1);
+    }
+    if (*p != ']') {
+      json_scan_error(s, p, "expecting '%c'", ']');
+      goto fail;
+    }
+  }
+  *pp = p + 1;
+  return arr;
+fail:
+  JS_FreeValue(ctx, arr);
+  return JS_EXCEPTION;
+}
+
+/* '*pp' points to the first character of the value. It is updated to
+   the character after the value */
+static JSValue json_scan_value(JSONScanState *s, const uint8_t **pp) {
+  const uint8_t *p = *pp;
+  JSValue val;
+
+  switch (*p) {
+  case '{':
+  case '[':
+    if (js_check_stack_overflow(s->ctx->rt, 0))
+      return JS_ThrowStackOverflow(s->ctx);
+    if (*p == '{')
+      return json_scan_object(s, pp);
+    return json_scan_array(s, pp);
+  case '"':
+    return json_scan_string(s, pp);
+  case '-':
+  case '0':
+  case '1':
+  case '2':
+  case '3':
+  case '4':
+  case '5':
+  case '6':
+  case '7':
+  case '8':
+  case '9':
+    return json_scan_number(s, pp);
+  case 't':
+    if (p[1] == 'r' && p[2] == 'u' && p[3] == 'e' &&
+        !json_is_ident_next(p[4])) {
+      val = JS_TRUE;
+      p += 4;
+      break;
+    }
+    goto fail;
+  case 'f':
+    if (p[1] == 'a' && p[2] == 'l' && p[3] == 's' && p[4] == 'e' &&
+        !json_is_ident_next(p[5])) {
+      val = JS_FALSE;
+      p += 5;
+      break;
+    }
+    goto fail;
+  case 'n':
+    if (p[1] == 'u' && p[2] == 'l' && p[3] == 'l' &&
+        !json_is_ident_next(p[4])) {
+      val = JS_NULL;
+      p += 4;
+      break;
+    }
+    goto fail;
+  default:
+  fail:
+    json_scan_unexpected(s, p);
+    return JS_EXCEPTION;
+  }
+  *pp = p;
+  return val;
+}
+
+JSValue json_scan(JSContext *ctx, const char *buf, size_t buf_len,
+                  const char *filename) {
+  JSONScanState s1, *s = &s1;
+  const uint8_t *p;
+  JSValue val;
+
+  int i;
+
+  s->ctx = ctx;
+  s->filename = filename;
+  s->buf_start = (const uint8_t *)buf;
+  s->buf_end = s->buf_start + buf_len;
+  s->props = NULL;
+  s->props_count = 0;
+  s->props_size = 0;
+  memset(s->shape_cache, 0, sizeof(s->shape_cache));
+  p = json_skip_spaces(s->buf_start);
+  val = json_scan_value(s, &p);
+  if (!JS_IsException(val)) {
+    p = json_skip_spaces(p);
+    if (p < s->buf_end) {
+      JS_FreeValue(ctx, val);
+      json_scan_error(s, p, "unexpected data at the end");
+      val = JS_EXCEPTION;
+    }
+  }
+  js_free(ctx, s->props);
+  for (i = 0; i < JSON_SHAPE_CACHE_SIZE; i++)
+    js_free_shape_null(ctx->rt, s->shape_cache[i]);
+  return val;
+}
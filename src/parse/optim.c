@@ -148,6 +148,11 @@ __exception int compute_stack_size(JSContext *ctx, JSFunctionDef *fd,
       if (ss_check(ctx, s, pos + 1 + diff, op, stack_len + 1))
         goto fail;
       break;
+    case OP_get_loc_push_i32_lt_if_false:
+      diff = get_u32(bc_buf + pos + 7);
+      if (ss_check(ctx, s, pos + 7 + diff, op, stack_len))
+        goto fail;
+      break;
     case OP_with_get_var:
     case OP_with_delete_var:
       diff = get_u32(bc_buf + pos + 5);
@@ -910,7 +915,6 @@ static void instantiate_hoisted_definitions(JSContext *ctx, JSFunctionDef *s,
     s->label_slots[label_next].pos2 = bc->size;
   }
 
-  js_free(ctx, s->global_vars);
   s->global_vars = NULL;
   s->global_var_count = 0;
   s->global_var_size = 0;
@@ -1144,6 +1148,35 @@ static void push_short_int(DynBuf *bc_out, int val) {
   dbuf_put_u32(bc_out, val);
 }
 
+/* emit `get_field`, `get_field2` or `put_field` with an inline cache */
+static void put_field_code(JSFunctionDef *s, DynBuf *bc_out, int op,
+                           JSAtom atom) {
+  int *pcount;
+
+  pcount = (op == OP_get_field2) ? &s->pic_count : &s->ic_count;
+  if (*pcount < JS_MAX_INLINE_CACHES) {
+    dbuf_putc(bc_out, OP_get_field_ic + (op - OP_get_field));
+    dbuf_put_u32(bc_out, atom);
+    dbuf_put_u16(bc_out, (*pcount)++);
+  } else {
+    dbuf_putc(bc_out, op);
+    dbuf_put_u32(bc_out, atom);
+  }
+}
+
+/* emit `get_var` or `put_var` with an inline cache */
+static void put_var_code(JSFunctionDef *s, DynBuf *bc_out, int op,
+                         JSAtom atom) {
+  if (s->gic_count < JS_MAX_INLINE_CACHES) {
+    dbuf_putc(bc_out, OP_get_var_ic + (op - OP_get_var));
+    dbuf_put_u32(bc_out, atom);
+    dbuf_put_u16(bc_out, s->gic_count++);
+  } else {
+    dbuf_putc(bc_out, op);
+    dbuf_put_u32(bc_out, atom);
+  }
+}
+
 static void put_short_code(DynBuf *bc_out, int op, int idx) {
 #if SHORT_OPCODES
   if (idx < 4) {
@@ -1601,10 +1634,10 @@ static void compute_pc2line_info(JSFunctionDef *s) {
   }
 }
 
-static RelocEntry *add_reloc(JSContext *ctx, LabelSlot *ls, uint32_t addr,
+static RelocEntry *add_reloc(JSFunctionDef *s, LabelSlot *ls, uint32_t addr,
                              int size) {
   RelocEntry *re;
-  re = js_malloc(ctx, sizeof(*re));
+  re = js_parse_alloc(s, sizeof(*re));
   if (!re)
     return NULL;
   re->addr = addr;
@@ -1681,7 +1714,7 @@ done:
 }
 
 /* peephole optimizations and resolve goto/labels */
-__exception int resolve_labels(JSContext *ctx, JSFunctionDef *s) {
+static __exception int resolve_labels1(JSContext *ctx, JSFunctionDef *s) {
   int pos, pos_next, bc_len, op, op1, len, i, pos_prev;
   uint64_t loc;
   const uint8_t *bc_buf; // the bytecodes from previous phase
@@ -1703,14 +1736,14 @@ __exception int resolve_labels(JSContext *ctx, JSFunctionDef *s) {
 
 #if SHORT_OPCODES
   if (s->jump_size) {
-    s->jump_slots = js_mallocz(s->ctx, sizeof(*s->jump_slots) * s->jump_size);
+    s->jump_slots = js_parse_allocz(s, sizeof(*s->jump_slots) * s->jump_size);
     if (s->jump_slots == NULL)
       return -1;
   }
 #endif
   /* XXX: Should skip this phase if not generating SHORT_OPCODES */
   if (s->loc_size && !(s->js_mode & JS_MODE_STRIP)) {
-    s->loc_slots = js_mallocz(s->ctx, sizeof(*s->loc_slots) * s->loc_size);
+    s->loc_slots = js_parse_allocz(s, sizeof(*s->loc_slots) * s->loc_size);
     if (s->loc_slots == NULL)
       return -1;
     s->loc_last = 0;
@@ -1824,7 +1857,6 @@ __exception int resolve_labels(JSContext *ctx, JSFunctionDef *s) {
           put_u8(bc_out.buf + re->addr, diff);
           break;
         }
-        js_free(ctx, re);
       }
       ls->first_reloc = NULL;
     } break;
@@ -1956,7 +1988,7 @@ __exception int resolve_labels(JSContext *ctx, JSFunctionDef *s) {
           jp->op = OP_if_false8 + (op - OP_if_false);
           dbuf_putc(&bc_out, OP_if_false8 + (op - OP_if_false));
           dbuf_putc(&bc_out, 0);
-          if (!add_reloc(ctx, ls, bc_out.size - 1, 1))
+          if (!add_reloc(s, ls, bc_out.size - 1, 1))
             goto fail;
           break;
         }
@@ -1965,7 +1997,7 @@ __exception int resolve_labels(JSContext *ctx, JSFunctionDef *s) {
           jp->op = OP_goto16;
           dbuf_putc(&bc_out, OP_goto16);
           dbuf_put_u16(&bc_out, 0);
-          if (!add_reloc(ctx, ls, bc_out.size - 2, 2))
+          if (!add_reloc(s, ls, bc_out.size - 2, 2))
             goto fail;
           break;
         }
@@ -1992,7 +2024,7 @@ __exception int resolve_labels(JSContext *ctx, JSFunctionDef *s) {
       dbuf_put_u32(&bc_out, ls->addr - bc_out.size);
       if (ls->addr == -1) {
         /* unresolved yet: create a new relocation entry */
-        if (!add_reloc(ctx, ls, bc_out.size - 4, 4))
+        if (!add_reloc(s, ls, bc_out.size - 4, 4))
           goto fail;
       }
       break;
@@ -2027,7 +2059,7 @@ __exception int resolve_labels(JSContext *ctx, JSFunctionDef *s) {
       dbuf_put_u32(&bc_out, ls->addr - bc_out.size);
       if (ls->addr == -1) {
         /* unresolved yet: create a new relocation entry */
-        if (!add_reloc(ctx, ls, bc_out.size - 4, 4))
+        if (!add_reloc(s, ls, bc_out.size - 4, 4))
           goto fail;
       }
       dbuf_putc(&bc_out, is_with);
@@ -2153,18 +2185,6 @@ __exception int resolve_labels(JSContext *ctx, JSFunctionDef *s) {
       }
       goto no_change;
 
-    case OP_get_field:
-      if (OPTIMIZE) {
-        JSAtom atom = get_u32(bc_buf + pos + 1);
-        if (atom == JS_ATOM_length) {
-          JS_FreeAtom(ctx, atom);
-          RESOLVE_LOC(0);
-          add_pc2line_info(s, bc_out.size, loc);
-          dbuf_putc(&bc_out, OP_get_length);
-          break;
-        }
-      }
-      goto no_change;
 #endif
     case OP_push_atom_value:
       if (OPTIMIZE) {
@@ -2272,8 +2292,12 @@ __exception int resolve_labels(JSContext *ctx, JSFunctionDef *s) {
             loc = cc.loc;
           RESOLVE_LOC(0);
           add_pc2line_info(s, bc_out.size, loc);
-          dbuf_putc(&bc_out, cc.op);
-          dbuf_put_u32(&bc_out, cc.atom);
+          if (cc.op == OP_put_field) {
+            put_field_code(s, &bc_out, cc.op, cc.atom);
+          } else {
+            dbuf_putc(&bc_out, cc.op);
+            dbuf_put_u32(&bc_out, cc.atom);
+          }
           pos_next = cc.pos;
           break;
         }
@@ -2323,6 +2347,56 @@ __exception int resolve_labels(JSContext *ctx, JSFunctionDef *s) {
          */
         int idx;
         idx = get_u16(bc_buf + pos + 1);
+        /* transformation:
+           get_loc(n) get_field(a) -> get_loc_get_field_ic(a, n)
+         */
+        if (code_match(&cc, pos_next, OP_get_field, -1) &&
+            cc.atom != JS_ATOM_length && s->ic_count < JS_MAX_INLINE_CACHES) {
+          RESOLVE_LOC(0);
+          if (cc.loc != 0)
+            loc = cc.loc;
+          add_pc2line_info(s, bc_out.size, loc);
+          dbuf_putc(&bc_out, OP_get_loc_get_field_ic);
+          dbuf_put_u32(&bc_out, cc.atom);
+          dbuf_put_u16(&bc_out, s->ic_count++);
+          dbuf_put_u16(&bc_out, idx);
+          pos_next = cc.pos;
+          break;
+        }
+        /* transformation:
+           get_loc(n) push_i32(x) lt if_false(l) ->
+           get_loc_push_i32_lt_if_false(n, x, l)
+         */
+        if (code_match(&cc, pos_next, OP_push_i32, -1)) {
+          int32_t val = cc.label;
+          if (code_match(&cc, cc.pos, OP_lt, OP_if_false, -1)) {
+            label = find_jump_target(s, cc.label, &op1, NULL);
+            assert(label >= 0 && label < s->label_count);
+            ls = &label_slots[label];
+            RESOLVE_LOC(0);
+            if (cc.loc != 0)
+              loc = cc.loc;
+            add_pc2line_info(s, bc_out.size, loc);
+            dbuf_putc(&bc_out, OP_get_loc_push_i32_lt_if_false);
+            dbuf_put_u16(&bc_out, idx);
+            dbuf_put_u32(&bc_out, val);
+#if SHORT_OPCODES
+            jp = &s->jump_slots[s->jump_count++];
+            jp->op = OP_get_loc_push_i32_lt_if_false;
+            jp->size = 4;
+            jp->pos = bc_out.size;
+            jp->label = label;
+#endif
+            dbuf_put_u32(&bc_out, ls->addr - bc_out.size);
+            if (ls->addr == -1) {
+              /* unresolved yet: create a new relocation entry */
+              if (!add_reloc(s, ls, bc_out.size - 4, 4))
+                goto fail;
+            }
+            pos_next = cc.pos;
+            break;
+          }
+        }
         if (idx >= 256)
           goto no_change;
         if (code_match(&cc, pos_next, M2(OP_post_dec, OP_post_inc), OP_put_loc,
@@ -2412,6 +2486,20 @@ __exception int resolve_labels(JSContext *ctx, JSFunctionDef *s) {
       if (OPTIMIZE) {
         int idx;
         idx = get_u16(bc_buf + pos + 1);
+        /* transformation:
+           get_arg(a) get_arg(b) add -> get_arg_get_arg_add(a, b)
+         */
+        if (op == OP_get_arg &&
+            code_match(&cc, pos_next, OP_get_arg, -1, OP_add, -1)) {
+          if (cc.loc != 0)
+            loc = cc.loc;
+          add_pc2line_info(s, bc_out.size, loc);
+          dbuf_putc(&bc_out, OP_get_arg_get_arg_add);
+          dbuf_put_u16(&bc_out, idx);
+          dbuf_put_u16(&bc_out, cc.idx);
+          pos_next = cc.pos;
+          break;
+        }
         add_pc2line_info(s, bc_out.size, loc);
         put_short_code(&bc_out, op, idx);
         break;
@@ -2476,8 +2564,12 @@ __exception int resolve_labels(JSContext *ctx, JSFunctionDef *s) {
             loc = cc.loc;
           add_pc2line_info(s, bc_out.size, loc);
           dbuf_putc(&bc_out, OP_dec + (op - OP_post_dec));
-          dbuf_putc(&bc_out, cc.op);
-          dbuf_put_u32(&bc_out, cc.atom);
+          if (cc.op == OP_put_field) {
+            put_field_code(s, &bc_out, cc.op, cc.atom);
+          } else {
+            dbuf_putc(&bc_out, cc.op);
+            dbuf_put_u32(&bc_out, cc.atom);
+          }
           pos_next = cc.pos;
           break;
         }
@@ -2543,6 +2635,31 @@ __exception int resolve_labels(JSContext *ctx, JSFunctionDef *s) {
       goto no_change;
 #endif
 
+    case OP_get_field:
+    case OP_get_field2:
+    case OP_put_field: {
+      JSAtom atom = get_u32(bc_buf + pos + 1);
+#if SHORT_OPCODES
+      if (OPTIMIZE && op == OP_get_field && atom == JS_ATOM_length) {
+        JS_FreeAtom(ctx, atom);
+        RESOLVE_LOC(0);
+        add_pc2line_info(s, bc_out.size, loc);
+        dbuf_putc(&bc_out, OP_get_length);
+        break;
+      }
+#endif
+      RESOLVE_LOC(0);
+      add_pc2line_info(s, bc_out.size, loc);
+      put_field_code(s, &bc_out, op, atom);
+    } break;
+
+    case OP_get_var:
+    case OP_put_var:
+      RESOLVE_LOC(0);
+      add_pc2line_info(s, bc_out.size, loc);
+      put_var_code(s, &bc_out, op, get_u32(bc_buf + pos + 1));
+      break;
+
     default:
     no_change:
       RESOLVE_LOC(0);
@@ -2632,14 +2749,11 @@ __exception int resolve_labels(JSContext *ctx, JSFunctionDef *s) {
       }
     }
   }
-  js_free(ctx, s->jump_slots);
   s->jump_slots = NULL;
 #endif
-  js_free(ctx, s->label_slots);
   s->label_slots = NULL;
   /* XXX: should delay until copying to runtime bytecode function */
   compute_pc2line_info(s);
-  js_free(ctx, s->loc_slots);
   s->loc_slots = NULL;
   /* set the new byte code */
   dbuf_free(&s->byte_code);
@@ -2656,6 +2770,24 @@ fail:
   return -1;
 }
 
+/* the jump, location and relocation slots only live during
+   resolve_labels1(): they are allocated from a separate arena released
+   on return instead of staying in the arena of the root function until
+   all the functions are created */
+__exception int resolve_labels(JSContext *ctx, JSFunctionDef *s) {
+  JSParseArena *arena = s->arena, label_arena;
+  int ret;
+
+  js_parse_arena_init(&label_arena);
+  s->arena = &label_arena;
+  ret = resolve_labels1(ctx, s);
+  s->arena = arena;
+  js_parse_arena_free(ctx->rt, &label_arena);
+  s->jump_slots = NULL;
+  s->loc_slots = NULL;
+  return ret;
+}
+
 BOOL code_match(CodeContext *s, int pos, ...) {
   const uint8_t *tab = s->bc_buf;
   int op, len, op1, pos_next;
@@ -171,6 +171,20 @@ typedef struct JSGlobalVar {
   JSAtom var_name;        /* variable name */
 } JSGlobalVar;
 
+typedef struct JSParseArenaChunk {
+  struct JSParseArenaChunk *next;
+  size_t size;
+  uint8_t data[0];
+} JSParseArenaChunk;
+
+/* bump allocator of the compile time temporaries of a parse session */
+typedef struct JSParseArena {
+  JSParseArenaChunk *chunk_list;
+  uint8_t *ptr; /* free space of the first chunk */
+  uint8_t *end;
+  size_t chunk_size; /* size of the next chunk */
+} JSParseArena;
+
 typedef struct RelocEntry {
   struct RelocEntry *next;
   uint32_t addr; /* address to patch */
@@ -218,6 +232,11 @@ typedef enum JSParseExportEnum {
 
 typedef struct JSFunctionDef {
   JSContext *ctx;
+  /* the arrays of the function definitions of a parse session are
+     allocated from the arena of the root function, they are released
+     together with it */
+  JSParseArena *arena;
+  JSParseArena root_arena; /* only used if parent == NULL */
   struct JSFunctionDef *parent;
   int parent_cpool_idx;   /* index in the constant pool of the parent
                              or -1 if none */
@@ -312,6 +331,10 @@ typedef struct JSFunctionDef {
   int jump_size;
   int jump_count;
 
+  int ic_count;  /* number of the inline caches used by the bytecode */
+  int pic_count; /* same for the polymorphic ones */
+  int gic_count; /* same for the global variable accesses */
+
   LocSlot *loc_slots;
   int loc_size;
   int loc_count;
@@ -323,8 +346,10 @@ typedef struct JSFunctionDef {
   int line_num; /* base line for all the lines in pc2line table */
   DynBuf pc2line;
 
-  char *source; /* raw source, utf-8 encoded */
+  const char *source; /* raw source, utf-8 encoded, in 'source_buf' */
   int source_len;
+  JSFunctionSource *source_buf;
+  const uint8_t *source_ptr; /* position of the source in the input */
 
   JSModuleDef *module; /* != NULL when parsing a module */
 } JSFunctionDef;
@@ -608,6 +633,8 @@ js_parse_function_decl2(JSParseState *s, JSParseFunctionEnum func_type,
                         JSFunctionKindEnum func_kind, JSAtom func_name,
                         const uint8_t *ptr, int function_line_num,
                         JSParseExportEnum export_flag, JSFunctionDef **pfd);
+int js_parse_save_source(JSParseState *s, JSFunctionDef *fd,
+                         const uint8_t *ptr, int len);
 __exception int js_parse_function_decl(JSParseState *s,
                                        JSParseFunctionEnum func_type,
                                        JSFunctionKindEnum func_kind,
@@ -639,6 +666,44 @@ calling function */
 __exception int add_closure_variables(JSContext *ctx, JSFunctionDef *s,
                                       JSFunctionBytecode *b, int scope_idx);
 
+/* -- Arena ----------------------------------- */
+
+void js_parse_arena_init(JSParseArena *a);
+void js_parse_arena_free(JSRuntime *rt, JSParseArena *a);
+void *js_parse_arena_alloc_slow(JSFunctionDef *fd, size_t size);
+
+#define JS_PARSE_ARENA_ALIGN 16
+
+/* Throw out of memory in case of error. The blocks are not freed one by
+   one */
+static inline void *js_parse_alloc(JSFunctionDef *fd, size_t size) {
+  JSParseArena *a = fd->arena;
+  uint8_t *ptr;
+
+  size = (size + JS_PARSE_ARENA_ALIGN - 1) & ~(JS_PARSE_ARENA_ALIGN - 1);
+  if (unlikely((size_t)(a->end - a->ptr) < size))
+    return js_parse_arena_alloc_slow(fd, size);
+  ptr = a->ptr;
+  a->ptr += size;
+  return ptr;
+}
+
+void *js_parse_allocz(JSFunctionDef *fd, size_t size);
+void *js_parse_realloc(JSFunctionDef *fd, void *ptr, size_t old_size,
+                       size_t new_size);
+no_inline int js_parse_realloc_array(JSFunctionDef *fd, void **parray,
+                                     int elem_size, int *psize, int req_size);
+
+/* same as js_resize_array() for the arrays of the arena */
+static inline int js_parse_resize_array(JSFunctionDef *fd, void **parray,
+                                        int elem_size, int *psize,
+                                        int req_size) {
+  if (unlikely(req_size > *psize))
+    return js_parse_realloc_array(fd, parray, elem_size, psize, req_size);
+  else
+    return 0;
+}
+
 /* -- JSFunctionDef ----------------------------------- */
 
 JSFunctionDef *js_new_function_def(JSContext *ctx, JSFunctionDef *parent,
@@ -730,6 +795,9 @@ JSAtom json_parse_ident(JSParseState *s, const uint8_t **pp, int c);
 __exception int json_next_token(JSParseState *s);
 int json_parse_expect(JSParseState *s, int tok);
 JSValue json_parse_value(JSParseState *s);
+/* strict JSON, 'buf' must be zero terminated */
+JSValue json_scan(JSContext *ctx, const char *buf, size_t buf_len,
+                  const char *filename);
 
 /* -- Optimizing opcodes ----------------------------------- */
 
@@ -102,23 +102,21 @@ int push_scope(JSParseState *s) {
     /* XXX: should check for scope overflow */
     if ((fd->scope_count + 1) > fd->scope_size) {
       int new_size;
-      size_t slack;
       JSVarScope *new_buf;
       /* XXX: potential arithmetic overflow */
       new_size = max_int(fd->scope_count + 1, fd->scope_size * 3 / 2);
       if (fd->scopes == fd->def_scope_array) {
-        new_buf =
-            js_realloc2(s->ctx, NULL, new_size * sizeof(*fd->scopes), &slack);
+        new_buf = js_parse_alloc(fd, new_size * sizeof(*fd->scopes));
         if (!new_buf)
           return -1;
         memcpy(new_buf, fd->scopes, fd->scope_count * sizeof(*fd->scopes));
       } else {
-        new_buf = js_realloc2(s->ctx, fd->scopes,
-                              new_size * sizeof(*fd->scopes), &slack);
+        new_buf = js_parse_realloc(fd, fd->scopes,
+                                   fd->scope_size * sizeof(*fd->scopes),
+                                   new_size * sizeof(*fd->scopes));
         if (!new_buf)
           return -1;
       }
-      new_size += slack / sizeof(*new_buf);
       fd->scopes = new_buf;
       fd->scope_size = new_size;
     }
@@ -171,8 +169,8 @@ int add_var(JSContext *ctx, JSFunctionDef *fd, JSAtom name) {
     JS_ThrowInternalError(ctx, "too many local variables");
     return -1;
   }
-  if (js_resize_array(ctx, (void **)&fd->vars, sizeof(fd->vars[0]),
-                      &fd->var_size, fd->var_count + 1))
+  if (js_parse_resize_array(fd, (void **)&fd->vars, sizeof(fd->vars[0]),
+                            &fd->var_size, fd->var_count + 1))
     return -1;
   vd = &fd->vars[fd->var_count++];
   memset(vd, 0, sizeof(*vd));
@@ -246,8 +244,8 @@ int add_arg(JSContext *ctx, JSFunctionDef *fd, JSAtom name) {
     JS_ThrowInternalError(ctx, "too many arguments");
     return -1;
   }
-  if (js_resize_array(ctx, (void **)&fd->args, sizeof(fd->args[0]),
-                      &fd->arg_size, fd->arg_count + 1))
+  if (js_parse_resize_array(fd, (void **)&fd->args, sizeof(fd->args[0]),
+                            &fd->arg_size, fd->arg_count + 1))
     return -1;
   vd = &fd->args[fd->arg_count++];
   memset(vd, 0, sizeof(*vd));
@@ -260,8 +258,9 @@ int add_arg(JSContext *ctx, JSFunctionDef *fd, JSAtom name) {
 JSGlobalVar *add_global_var(JSContext *ctx, JSFunctionDef *s, JSAtom name) {
   JSGlobalVar *hf;
 
-  if (js_resize_array(ctx, (void **)&s->global_vars, sizeof(s->global_vars[0]),
-                      &s->global_var_size, s->global_var_count + 1))
+  if (js_parse_resize_array(s, (void **)&s->global_vars,
+                            sizeof(s->global_vars[0]), &s->global_var_size,
+                            s->global_var_count + 1))
     return NULL;
   hf = &s->global_vars[s->global_var_count++];
   hf->cpool_idx = -1;
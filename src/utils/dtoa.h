@@ -0,0 +1,26 @@
+#ifndef QUICKJS_DTOA_H
+#define QUICKJS_DTOA_H
+
+#include "def.h"
+
+/* Grisu3 conversions of a finite double 'v' > 0 (Florian Loitsch,
+   "Printing Floating-Point Numbers Quickly and Accurately with
+   Integers"). The digits are stored in 'buf' without terminating zero and
+   v ~= 0.buf * 10^decpt. They return the number of digits, or 0 for the
+   rare numbers which must be converted with an exact method. */
+
+/* the shortest digits which read back as 'v', the closest to 'v' if there
+   are several of them. 'buf' must have 17 bytes */
+int js_grisu_shortest(double v, char *buf, int *pdecpt);
+/* 'n_digits' digits, 1 <= n_digits <= 17, rounded to nearest. The ties
+   are reported as failures */
+int js_grisu_precision(double v, int n_digits, char *buf, int *pdecpt);
+
+/* parse [-]digits[.digits][(e|E)[+|-]digits] where one of the digit
+   sequences before the exponent is not empty, and round to nearest. The
+   numbers which the fast algorithms cannot decide are converted by
+   strtod() from the same characters. The end of the number is stored in
+   '*pp' if 'pp' is not NULL */
+double js_atod(const char *str, const char **pp);
+
+#endif
@@ -1,7 +1,11 @@
 #include "kid.h"
 #include "libs/cutils.h"
+#include <errno.h>
+#include <stdarg.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 /* -- Allocator ----------------------------------- */
 
@@ -46,15 +50,22 @@ void kid_string_free(KidString str) { kid_free(str.data); }
 static int kid_array_grow(KidArray *arr) {
   if (arr->slots == NULL) {
     arr->slots = kid_mallocz(arr->slot_size * arr->cap);
+    return !arr->slots;
   } else if (arr->len >= arr->cap) {
-    if (arr->cap < 1024) {
-      arr->cap += arr->cap;
+    size_t cap = arr->cap;
+    void *slots;
+    if (cap < 1024) {
+      cap += cap;
     } else {
-      arr->cap += arr->cap / 4;
+      cap += cap / 4;
     }
-    arr->slots = kid_realloc(arr->slots, arr->slot_size * arr->cap);
+    slots = kid_realloc(arr->slots, arr->slot_size * cap);
+    if (!slots)
+      return 1;
+    arr->slots = slots;
+    arr->cap = cap;
   }
-  return !arr->slots;
+  return 0;
 }
 
 int kid_array_init(KidArray *arr, size_t slot_size, size_t cap) {
@@ -81,44 +92,36 @@ int kid_array_push(KidArray *arr, void *item) {
 
 /* -- Hashmap ----------------------------------- */
 
-// https://www.partow.net/programming/hashfunctions/#ELFHashFunction
-unsigned int elf_Hash(const unsigned char *data, unsigned int size) {
-  unsigned int hash = 0;
-  unsigned int x = 0;
-  unsigned int i = 0;
-
-  for (i = 0; i < size; ++data, ++i) {
-    hash = (hash << 4) + (*data);
-
-    if ((x = hash & 0xF0000000L) != 0) {
-      hash ^= (x >> 24);
-    }
+// FNV-1a, the keys are short: pointers and property names
+static unsigned int kid_fnv1a_hash(const unsigned char *data, size_t size) {
+  unsigned int hash = 2166136261u;
 
-    hash &= ~x;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= data[i];
+    hash *= 16777619u;
   }
-
   return hash;
 }
 
-void kid_hashmap_init(KidHashmap *map, KidHashmapKeyCopyFunc *key_copy,
-                      KidHashmapKeyFreeFunc *key_free,
-                      KidHashmapValueFreeFunc *value_free) {
+int kid_hashmap_init(KidHashmap *map, KidHashmapKeyCopyFunc *key_copy,
+                     KidHashmapKeyFreeFunc *key_free,
+                     KidHashmapValueFreeFunc *value_free) {
   kid_list_init_head(&map->keys);
 
-  map->buckets = kid_mallocz(sizeof(*map->buckets) * KID_HASHMAP_BUCKETS_LEN);
-  if (!map->buckets) {
-    kid_free(map);
-    return;
-  }
+  map->buckets_len = KID_HASHMAP_MIN_BUCKETS_LEN;
+  map->count = 0;
+  map->buckets = kid_malloc(sizeof(*map->buckets) * map->buckets_len);
+  if (!map->buckets)
+    return -1;
 
-  for (int i = 0; i < KID_HASHMAP_BUCKETS_LEN; i++) {
+  for (size_t i = 0; i < map->buckets_len; i++) {
     kid_list_init_head(map->buckets + i);
   }
 
   map->key_copy = key_copy;
   map->key_free = key_free;
   map->value_free = value_free;
-  return;
+  return 0;
 }
 
 KidHashkey *kid_hashmap_key_copy(KidHashkey *key) {
@@ -159,16 +162,41 @@ KidHashkey *kid_hashmap_key_shallow_copy(KidHashkey *key) {
 
 void kid_hashmap_key_shallow_free(KidHashkey *key) { kid_free(key); }
 
+/* the hash does not depend on the number of buckets. The high bit is
+   set while it is not computed */
 unsigned int kid_hashmap_hash(KidHashkey *key) {
   if (key->hash & 0x80000000) {
-    key->hash = elf_Hash(key->opaque, key->size) & KID_HASHMAP_BUCKETS_MASK;
+    key->hash = kid_fnv1a_hash(key->opaque, key->size) & 0x7fffffff;
   }
   return key->hash;
 }
 
+/* the entries are kept if there is not enough memory */
+static void kid_hashmap_resize(KidHashmap *map, size_t new_len) {
+  KidListHead *new_buckets, *el, *el1;
+  KidHashmapEntry *e;
+  size_t i;
+
+  new_buckets = kid_malloc(sizeof(*new_buckets) * new_len);
+  if (!new_buckets)
+    return;
+  for (i = 0; i < new_len; i++)
+    kid_list_init_head(new_buckets + i);
+  for (i = 0; i < map->buckets_len; i++) {
+    kid_list_for_each_safe(el, el1, map->buckets + i) {
+      e = kid_list_entry(el, KidHashmapEntry, link);
+      kid_list_add_tail(&e->link,
+                        new_buckets + (e->key->hash & (new_len - 1)));
+    }
+  }
+  kid_free(map->buckets);
+  map->buckets = new_buckets;
+  map->buckets_len = new_len;
+}
+
 KidHashmapEntry *kid_hashmap_get(KidHashmap *map, KidHashkey *key) {
   unsigned int hash = kid_hashmap_hash(key);
-  KidListHead *bucket = map->buckets + hash;
+  KidListHead *bucket = map->buckets + (hash & (map->buckets_len - 1));
 
   if (kid_list_empty(bucket))
     return NULL;
@@ -187,7 +215,6 @@ KidHashmapEntry *kid_hashmap_get(KidHashmap *map, KidHashkey *key) {
   return NULL;
 }
 
-// TODO: resize buckets
 int kid_hashmap_set(KidHashmap *map, KidHashkey *key, void *value,
                     bool free_old) {
   KidHashmapEntry *old = kid_hashmap_get(map, key);
@@ -215,9 +242,12 @@ int kid_hashmap_set(KidHashmap *map, KidHashkey *key, void *value,
   e->key = keyp;
   e->value = value;
 
-  kid_hashmap_hash(keyp);
-  KidListHead *bucket = map->buckets + keyp->hash;
+  keyp->hash = kid_hashmap_hash(key);
+  if (map->count >= map->buckets_len)
+    kid_hashmap_resize(map, map->buckets_len * 2);
+  KidListHead *bucket = map->buckets + (keyp->hash & (map->buckets_len - 1));
   kid_list_add(&e->link, bucket);
+  map->count++;
   return 0;
 }
 
@@ -235,6 +265,8 @@ void kid_hashmap_del(KidHashmap *map, KidHashkey *key) {
   if (map->value_free) {
     map->value_free(e->value);
   }
+  kid_free(e);
+  map->count--;
 }
 
 void kid_hashmap_free(KidHashmap *map) {
@@ -246,7 +278,7 @@ void kid_hashmap_free(KidHashmap *map) {
     }
   }
 
-  for (int i = 0; i < KID_HASHMAP_BUCKETS_LEN; i++) {
+  for (size_t i = 0; i < map->buckets_len; i++) {
     KidListHead *bucket = (KidListHead *)map->buckets + i;
     kid_list_for_each_safe(el, el1, bucket) {
       KidHashmapEntry *e = kid_list_entry(el, KidHashmapEntry, link);
@@ -258,4 +290,119 @@ void kid_hashmap_free(KidHashmap *map) {
   }
 
   kid_free(map->buckets);
-}
\ No newline at end of file
+}
+
+/* -- Writer ----------------------------------- */
+
+void kid_writer_init(KidWriter *w, int fd) {
+  w->fd = fd;
+  w->error = 0;
+  w->len = 0;
+}
+
+static void kid_writer_write(KidWriter *w, const char *data, size_t len) {
+  ssize_t ret;
+
+  while (len > 0 && !w->error) {
+    ret = write(w->fd, data, len);
+    if (ret < 0) {
+      if (errno == EINTR)
+        continue;
+      w->error = errno;
+    } else {
+      data += ret;
+      len -= ret;
+    }
+  }
+}
+
+int kid_writer_flush(KidWriter *w) {
+  kid_writer_write(w, w->buf, w->len);
+  w->len = 0;
+  return w->error;
+}
+
+void kid_writer_put(KidWriter *w, const void *data, size_t len) {
+  if (w->len + len > sizeof(w->buf)) {
+    kid_writer_flush(w);
+    if (len > sizeof(w->buf)) {
+      kid_writer_write(w, data, len);
+      return;
+    }
+  }
+  memcpy(w->buf + w->len, data, len);
+  w->len += len;
+}
+
+void kid_writer_puts(KidWriter *w, const char *str) {
+  kid_writer_put(w, str, strlen(str));
+}
+
+void kid_writer_printf(KidWriter *w, const char *fmt, ...) {
+  va_list ap;
+  int len;
+
+  /* the formatted items are short */
+  if (sizeof(w->buf) - w->len < 256)
+    kid_writer_flush(w);
+  va_start(ap, fmt);
+  len = vsnprintf(w->buf + w->len, sizeof(w->buf) - w->len, fmt, ap);
+  va_end(ap);
+  if (len < 0)
+    return;
+  if ((size_t)len < sizeof(w->buf) - w->len) {
+    w->len += len;
+  } else {
+    char *buf = kid_malloc(len + 1);
+    if (!buf) {
+      w->error = ENOMEM;
+      return;
+    }
+    va_start(ap, fmt);
+    vsnprintf(buf, len + 1, fmt, ap);
+    va_end(ap);
+    kid_writer_put(w, buf, len);
+    kid_free(buf);
+  }
+}
+
+void kid_writer_put_json_str(KidWriter *w, const char *str, size_t len) {
+  static const char hex[] = "0123456789abcdef";
+  size_t i, start;
+  unsigned char c;
+  char esc[6];
+
+  kid_writer_put(w, "\"", 1);
+  for (i = start = 0; i < len; i++) {
+    c = str[i];
+    if (c >= 0x20 && c != '"' && c != '\\')
+      continue;
+    kid_writer_put(w, str + start, i - start);
+    start = i + 1;
+    switch (c) {
+    case '"':
+      kid_writer_put(w, "\\\"", 2);
+      break;
+    case '\\':
+      kid_writer_put(w, "\\\\", 2);
+      break;
+    case '\n':
+      kid_writer_put(w, "\\n", 2);
+      break;
+    case '\r':
+      kid_writer_put(w, "\\r", 2);
+      break;
+    case '\t':
+      kid_writer_put(w, "\\t", 2);
+      break;
+    default:
+      memcpy(esc, "\\u00", 4);
+      esc[4] = hex[c >> 4];
+      esc[5] = hex[c & 15];
+      kid_writer_put(w, esc, 6);
+      break;
+    }
+  }
+  kid_writer_put(w, str + start, len - start);
+  kid_writer_put(w, "\"", 1);
+}
@@ -21,7 +21,8 @@ void kid_set_allocator(KidAllocator *alloc);
 
 void *kid_malloc(size_t size);
 void kid_free(void *ptr);
-void *kid_malloc(size_t size);
+void *kid_realloc(void *ptr, size_t size);
+void *kid_mallocz(size_t size);
 
 /* -- String ----------------------------------- */
 
@@ -120,8 +121,9 @@ struct KidHashkey {
   unsigned int hash;
 };
 
-#define KID_HASHMAP_BUCKETS_LEN 64
-#define KID_HASHMAP_BUCKETS_MASK (KID_HASHMAP_BUCKETS_LEN - 1)
+/* initial number of buckets, doubled when there are more entries than
+   buckets */
+#define KID_HASHMAP_MIN_BUCKETS_LEN 64
 
 typedef struct KidHashmap KidHashmap;
 typedef struct KidHashmapEntry KidHashmapEntry;
@@ -137,13 +139,15 @@ typedef void KidHashmapKeyFreeFunc(KidHashkey *key);
 struct KidHashmap {
   KidListHead keys;     // List<KidHashkey*>
   KidListHead *buckets; // Array<List<KidListHead>>
+  size_t buckets_len;   // power of 2
+  size_t count;
 
   KidHashmapKeyCopyFunc *key_copy;
   KidHashmapKeyFreeFunc *key_free;
   KidHashmapValueFreeFunc *value_free;
 };
 
-void kid_hashmap_init(KidHashmap *map, KidHashmapKeyCopyFunc *key_copy,
+int kid_hashmap_init(KidHashmap *map, KidHashmapKeyCopyFunc *key_copy,
                       KidHashmapKeyFreeFunc *key_free,
                       KidHashmapValueFreeFunc *value_free);
 
@@ -159,4 +163,27 @@ KidHashmapEntry *kid_hashmap_get(KidHashmap *map, KidHashkey *key);
 void kid_hashmap_del(KidHashmap *map, KidHashkey *key);
 void kid_hashmap_free(KidHashmap *map);
 
+/* -- Writer ----------------------------------- */
+
+/* buffered output to a file descriptor */
+
+#define KID_WRITER_BUF_SIZE 65536
+
+typedef struct KidWriter {
+  int fd;
+  int error; // errno of the first failed write
+  size_t len;
+  char buf[KID_WRITER_BUF_SIZE];
+} KidWriter;
+
+void kid_writer_init(KidWriter *w, int fd);
+void kid_writer_put(KidWriter *w, const void *data, size_t len);
+void kid_writer_puts(KidWriter *w, const char *str);
+void kid_writer_printf(KidWriter *w, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+/* write the JSON string literal of `str` */
+void kid_writer_put_json_str(KidWriter *w, const char *str, size_t len);
+/* return 0 or the errno of the first failed write */
+int kid_writer_flush(KidWriter *w);
+
 #endif
\ No newline at end of file
@@ -254,9 +254,20 @@ static void bc_byte_swap(uint8_t *bc_buf, int bc_len) {
       }
       break;
     case OP_FMT_npop_u16:
+    case OP_FMT_arg_arg:
       put_u16(bc_buf + pos + 1, bswap16(get_u16(bc_buf + pos + 1)));
       put_u16(bc_buf + pos + 1 + 2, bswap16(get_u16(bc_buf + pos + 1 + 2)));
       break;
+    case OP_FMT_atom_u16_loc:
+      put_u32(bc_buf + pos + 1, bswap32(get_u32(bc_buf + pos + 1)));
+      put_u16(bc_buf + pos + 1 + 4, bswap16(get_u16(bc_buf + pos + 1 + 4)));
+      put_u16(bc_buf + pos + 1 + 6, bswap16(get_u16(bc_buf + pos + 1 + 6)));
+      break;
+    case OP_FMT_loc_i32_label:
+      put_u16(bc_buf + pos + 1, bswap16(get_u16(bc_buf + pos + 1)));
+      put_u32(bc_buf + pos + 1 + 2, bswap32(get_u32(bc_buf + pos + 1 + 2)));
+      put_u32(bc_buf + pos + 1 + 6, bswap32(get_u32(bc_buf + pos + 1 + 6)));
+      break;
     default:
       break;
     }
@@ -286,6 +297,7 @@ static int JS_WriteFunctionBytecode(BCWriterState *s, const uint8_t *bc_buf1,
     case OP_FMT_atom_u16:
     case OP_FMT_atom_label_u8:
     case OP_FMT_atom_label_u16:
+    case OP_FMT_atom_u16_loc:
       atom = get_u32(bc_buf + pos + 1);
       if (bc_atom_to_idx(s, &val, atom))
         goto fail;
@@ -742,6 +754,14 @@ static int JS_WriteObjectRec(BCWriterState *s, JSValueConst obj) {
     bc_put_u8(s, BC_TAG_STRING);
     JS_WriteString(s, p);
   } break;
+  case JS_TAG_STRING_ROPE: {
+    JSValue str = js_rope_flatten(s->ctx, obj);
+    if (JS_IsException(str))
+      goto fail;
+    bc_put_u8(s, BC_TAG_STRING);
+    JS_WriteString(s, JS_VALUE_GET_STRING(str));
+    JS_FreeValue(s->ctx, str);
+  } break;
   case JS_TAG_FUNCTION_BYTECODE:
     if (!s->allow_bytecode)
       goto invalid_tag;
@@ -1134,8 +1154,9 @@ static int JS_ReadFunctionBytecode(BCReaderState *s, JSFunctionBytecode *b,
   int pos, len, op;
   JSAtom atom;
   uint32_t idx;
+  int ic_count = 0, pic_count = 0, gic_count = 0;
 
-  if (s->is_rom_data) {
+  if (s->is_rom_data && !s->relocate_atoms) {
     /* directly use the input buffer */
     if (unlikely(s->buf_end - s->ptr < bc_len))
       return bc_read_error_end(s);
@@ -1152,14 +1173,22 @@ static int JS_ReadFunctionBytecode(BCReaderState *s, JSFunctionBytecode *b,
   while (pos < bc_len) {
     op = bc_buf[pos];
     len = short_opcode_info(op).size;
+    if (op == OP_get_field2_ic)
+      pic_count = max_int(pic_count, get_u16(bc_buf + pos + 5) + 1);
+    else if (op == OP_get_field_ic || op == OP_put_field_ic ||
+             op == OP_get_loc_get_field_ic)
+      ic_count = max_int(ic_count, get_u16(bc_buf + pos + 5) + 1);
+    else if (op == OP_get_var_ic || op == OP_put_var_ic)
+      gic_count = max_int(gic_count, get_u16(bc_buf + pos + 5) + 1);
     switch (short_opcode_info(op).fmt) {
     case OP_FMT_atom:
     case OP_FMT_atom_u8:
     case OP_FMT_atom_u16:
     case OP_FMT_atom_label_u8:
     case OP_FMT_atom_label_u16:
+    case OP_FMT_atom_u16_loc:
       idx = get_u32(bc_buf + pos + 1);
-      if (s->is_rom_data) {
+      if (s->is_rom_data && !s->relocate_atoms) {
         /* just increment the reference count of the atom */
         JS_DupAtom(s->ctx, (JSAtom)idx);
       } else {
@@ -1181,6 +1210,25 @@ static int JS_ReadFunctionBytecode(BCReaderState *s, JSFunctionBytecode *b,
     }
     pos += len;
   }
+
+  if (ic_count) {
+    b->ic = js_mallocz(s->ctx, sizeof(b->ic[0]) * ic_count);
+    if (!b->ic)
+      return -1;
+    b->ic_count = ic_count;
+  }
+  if (pic_count) {
+    b->pic = js_mallocz(s->ctx, sizeof(b->pic[0]) * pic_count);
+    if (!b->pic)
+      return -1;
+    b->pic_count = pic_count;
+  }
+  if (gic_count) {
+    b->gic = js_mallocz(s->ctx, sizeof(b->gic[0]) * gic_count);
+    if (!b->gic)
+      return -1;
+    b->gic_count = gic_count;
+  }
   return 0;
 }
 
@@ -1360,7 +1408,7 @@ static JSValue JS_ReadFunctionTag(BCReaderState *s) {
   bc.arguments_allowed = bc_get_flags(v16, &idx, 1);
   bc.has_debug = bc_get_flags(v16, &idx, 1);
   bc.backtrace_barrier = bc_get_flags(v16, &idx, 1);
-  bc.read_only_bytecode = s->is_rom_data;
+  bc.read_only_bytecode = s->is_rom_data && !s->relocate_atoms;
   if (bc_get_u8(s, &v8))
     goto fail;
   bc.js_mode = v8;
@@ -1497,7 +1545,18 @@ static JSValue JS_ReadFunctionTag(BCReaderState *s) {
       goto fail;
     if (bc_get_leb128_int(s, &b->debug.pc2line_len))
       goto fail;
-    if (b->debug.pc2line_len) {
+    if (b->debug.pc2line_len && s->is_rom_data) {
+      /* no atoms in the line table: it is used in place even when the
+         atoms are relocated, so that it is only paged in when a
+         backtrace needs it */
+      if (unlikely(s->buf_end - s->ptr < b->debug.pc2line_len)) {
+        bc_read_error_end(s);
+        goto fail;
+      }
+      b->debug.pc2line_buf = (uint8_t *)s->ptr;
+      b->read_only_pc2line = TRUE;
+      s->ptr += b->debug.pc2line_len;
+    } else if (b->debug.pc2line_len) {
       b->debug.pc2line_buf = js_mallocz(ctx, b->debug.pc2line_len);
       if (!b->debug.pc2line_buf)
         goto fail;
@@ -1995,8 +2054,8 @@ static int JS_ReadObjectAtoms(BCReaderState *s) {
     if (atom == JS_ATOM_NULL)
       return s->error_state = -1;
     s->idx_to_atom[i] = atom;
-    if (s->is_rom_data && (atom != (i + s->first_atom)))
-      s->is_rom_data = FALSE; /* atoms must be relocated */
+    if (atom != (i + s->first_atom))
+      s->relocate_atoms = TRUE;
   }
   bc_read_trace(s, "}\n");
   return 0;
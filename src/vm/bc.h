@@ -41,10 +41,13 @@ typedef enum BCTagEnum {
   BC_TAG_OBJECT_REFERENCE,
 } BCTagEnum;
 
+/* bumped with the inline cache and superinstruction opcodes. The new
+   versions differ from both old ones so that the files of one build are
+   not read by the other */
 #ifdef CONFIG_BIGNUM
-#define BC_BASE_VERSION 2
+#define BC_BASE_VERSION 4
 #else
-#define BC_BASE_VERSION 1
+#define BC_BASE_VERSION 3
 #endif
 #define BC_BE_VERSION 0x40
 #ifdef WORDS_BIGENDIAN
@@ -83,6 +86,9 @@ typedef struct BCReaderState {
   BOOL allow_sab : 8;
   BOOL allow_bytecode : 8;
   BOOL is_rom_data : 8;
+  /* the atoms of the input do not match the ones of the runtime: the
+     bytecode cannot be used in place */
+  BOOL relocate_atoms : 8;
   BOOL allow_reference : 8;
   /* object references */
   JSObject **objects;
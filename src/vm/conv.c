@@ -5,6 +5,7 @@
 #include "num.h"
 #include "obj.h"
 #include "str.h"
+#include "utils/dtoa.h"
 #include "vm.h"
 
 /* -- ToPrimitive ----------------------------------- */
@@ -104,6 +105,9 @@ int JS_ToBoolFree(JSContext *ctx, JSValue val) {
     JS_FreeValue(ctx, val);
     return ret;
   }
+  case JS_TAG_STRING_ROPE: /* never empty */
+    JS_FreeValue(ctx, val);
+    return TRUE;
 #ifdef CONFIG_BIGNUM
   case JS_TAG_BIG_INT:
   case JS_TAG_BIG_FLOAT: {
@@ -145,51 +149,44 @@ int JS_ToBool(JSContext *ctx, JSValueConst val) {
 
 /* -- ToNumber ----------------------------------- */
 
-/* XXX: remove */
-static double js_strtod(const char *p, int radix, BOOL is_float) {
+/* parse an integer in base 'radix' */
+static double js_strtod(const char *p, int radix) {
+  uint64_t n_max, n;
+  int int_exp, is_neg, c;
   double d;
-  int c;
-
-  if (!is_float || radix != 10) {
-    uint64_t n_max, n;
-    int int_exp, is_neg;
 
-    is_neg = 0;
-    if (*p == '-') {
-      is_neg = 1;
-      p++;
-    }
+  if (radix == 10)
+    return js_atod(p, NULL);
+  is_neg = 0;
+  if (*p == '-') {
+    is_neg = 1;
+    p++;
+  }
 
-    /* skip leading zeros */
-    while (*p == '0')
-      p++;
-    n = 0;
-    if (radix == 10)
-      n_max = ((uint64_t)-1 - 9) / 10; /* most common case */
-    else
-      n_max = ((uint64_t)-1 - (radix - 1)) / radix;
-    /* XXX: could be more precise */
-    int_exp = 0;
-    while (*p != '\0') {
-      c = to_digit((uint8_t)*p);
-      if (c >= radix)
-        break;
-      if (n <= n_max) {
-        n = n * radix + c;
-      } else {
-        int_exp++;
-      }
-      p++;
-    }
-    d = n;
-    if (int_exp != 0) {
-      d *= pow(radix, int_exp);
+  /* skip leading zeros */
+  while (*p == '0')
+    p++;
+  n = 0;
+  n_max = ((uint64_t)-1 - (radix - 1)) / radix;
+  /* XXX: could be more precise */
+  int_exp = 0;
+  while (*p != '\0') {
+    c = to_digit((uint8_t)*p);
+    if (c >= radix)
+      break;
+    if (n <= n_max) {
+      n = n * radix + c;
+    } else {
+      int_exp++;
     }
-    if (is_neg)
-      d = -d;
-  } else {
-    d = strtod(p, NULL);
+    p++;
+  }
+  d = n;
+  if (int_exp != 0) {
+    d *= pow(radix, int_exp);
   }
+  if (is_neg)
+    d = -d;
   return d;
 }
 
@@ -387,25 +384,6 @@ JSValue js_atof(JSContext *ctx, const char *str, const char **pp, int radix,
   if (p == p_start)
     goto fail;
 
-  buf = buf1;
-  buf_allocated = FALSE;
-  len = p - p_start;
-  if (unlikely((len + 2) > sizeof(buf1))) {
-    buf = js_malloc_rt(ctx->rt, len + 2); /* no exception raised */
-    if (!buf)
-      goto mem_error;
-    buf_allocated = TRUE;
-  }
-  /* remove the separators and the radix prefixes */
-  j = 0;
-  if (is_neg)
-    buf[j++] = '-';
-  for (i = 0; i < len; i++) {
-    if (p_start[i] != '_')
-      buf[j++] = p_start[i];
-  }
-  buf[j] = '\0';
-
 #ifdef CONFIG_BIGNUM
   if (flags & ATOD_ACCEPT_SUFFIX) {
     if (*p == 'n') {
@@ -441,11 +419,44 @@ JSValue js_atof(JSContext *ctx, const char *str, const char **pp, int radix,
       }
     }
   }
+#endif
+
+  len = p - p_start;
+  if (atod_type == ATOD_TYPE_FLOAT64 && radix == 10 &&
+      !(flags & ATOD_INT_ONLY) && !memchr(p_start, '_', len)) {
+    /* decimal number without separators: no copy. js_atod() must stop
+       where the scan above did */
+    const char *p_end;
+    double d = js_atod(p_start, &p_end);
+    if (p_end == p) {
+      val = JS_NewFloat64(ctx, is_neg ? -d : d);
+      goto done;
+    }
+  }
 
+  buf = buf1;
+  buf_allocated = FALSE;
+  if (unlikely((len + 2) > sizeof(buf1))) {
+    buf = js_malloc_rt(ctx->rt, len + 2); /* no exception raised */
+    if (!buf)
+      goto mem_error;
+    buf_allocated = TRUE;
+  }
+  /* remove the separators and the radix prefixes */
+  j = 0;
+  if (is_neg)
+    buf[j++] = '-';
+  for (i = 0; i < len; i++) {
+    if (p_start[i] != '_')
+      buf[j++] = p_start[i];
+  }
+  buf[j] = '\0';
+
+#ifdef CONFIG_BIGNUM
   switch (atod_type) {
   case ATOD_TYPE_FLOAT64: {
     double d;
-    d = js_strtod(buf, radix, is_float);
+    d = js_strtod(buf, radix);
     /* return int or float64 */
     val = JS_NewFloat64(ctx, d);
   } break;
@@ -473,7 +484,7 @@ JSValue js_atof(JSContext *ctx, const char *str, const char **pp, int radix,
     (void)has_legacy_octal;
     if (is_float && radix != 10)
       goto fail;
-    d = js_strtod(buf, radix, is_float);
+    d = js_strtod(buf, radix);
     val = JS_NewFloat64(ctx, d);
   }
 #endif
@@ -552,7 +563,8 @@ redo:
     if (JS_IsException(val))
       return JS_EXCEPTION;
     goto redo;
-  case JS_TAG_STRING: {
+  case JS_TAG_STRING:
+  case JS_TAG_STRING_ROPE: {
     const char *str;
     const char *p;
     size_t len;
@@ -794,6 +806,7 @@ redo:
     JS_FreeValue(ctx, val);
     break;
   case JS_TAG_STRING:
+  case JS_TAG_STRING_ROPE:
     val = JS_StringToBigIntErr(ctx, val);
     if (JS_IsException(val))
       return NULL;
@@ -1364,6 +1377,8 @@ JSValue JS_ToStringInternal(JSContext *ctx, JSValueConst val,
   switch (tag) {
   case JS_TAG_STRING:
     return JS_DupValue(ctx, val);
+  case JS_TAG_STRING_ROPE:
+    return js_rope_flatten(ctx, val);
   case JS_TAG_INT:
     snprintf(buf, sizeof(buf), "%d", JS_VALUE_GET_INT(val));
     str = buf;
@@ -1596,10 +1611,10 @@ const char *JS_ToCStringLen2(JSContext *ctx, size_t *plen, JSValueConst val1,
   }
 
   *q = '\0';
-  str_new->len = q - str_new->u.str8;
+  /* the allocated length is kept in str_new->len to free the string */
   JS_FreeValue(ctx, val);
   if (plen)
-    *plen = str_new->len;
+    *plen = q - str_new->u.str8;
   return (const char *)str_new->u.str8;
 fail:
   if (plen)
@@ -1641,9 +1656,22 @@ static void js_ecvt1(double d, int n_digits, int *decpt, int *sign, char *buf,
    17. Return the number of digits. */
 static int js_ecvt(double d, int n_digits, int *decpt, int *sign, char *buf,
                    BOOL is_fixed) {
-  int rounding_mode;
+  int rounding_mode, len;
   char buf_tmp[JS_DTOA_BUF_SIZE];
 
+  /* fast path, printf is only used for the cases Grisu cannot decide */
+  if (d != 0 && (!is_fixed || n_digits <= 17)) {
+    if (is_fixed)
+      len = js_grisu_precision(fabs(d), n_digits, buf, decpt);
+    else
+      len = js_grisu_shortest(fabs(d), buf, decpt);
+    if (len > 0) {
+      buf[len] = '\0';
+      *sign = (d < 0);
+      return len;
+    }
+  }
+
   if (!is_fixed) {
     unsigned int n_digits_min, n_digits_max;
     /* find the minimum amount of digits (XXX: inefficient but simple) */
@@ -2014,6 +2042,14 @@ JSValue JS_ToObject(JSContext *ctx, JSValueConst val) {
                              JS_NewInt32(ctx, p1->len), 0);
     }
     goto set_value;
+  case JS_TAG_STRING_ROPE: {
+    JSValue str = js_rope_flatten(ctx, val);
+    if (JS_IsException(str))
+      return str;
+    obj = JS_ToObject(ctx, str);
+    JS_FreeValue(ctx, str);
+    return obj;
+  }
   case JS_TAG_BOOL:
     obj = JS_NewObjectClass(ctx, JS_CLASS_BOOLEAN);
     goto set_value;
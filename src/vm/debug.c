@@ -334,86 +334,475 @@ fail:
   return JS_NULL;
 }
 
-// retrieve breakpoints at pc, the length of returned array is [0, 2]
-static JSBreakpoint *js_debug_bps_from_pc(const uint8_t *pc, JSRuntime *rt,
-                                          JSContext *ctx, uint32_t *len) {
-
-  JSBreakpoint *ret = NULL;
-  JSValue bps, bp, line, col;
-  struct JSStackFrame *sf = rt->current_stack_frame;
-  *len = 0;
-
-  if (!sf)
+typedef struct JSDebugLoc {
+  int line;
+  int col;
+} JSDebugLoc;
+
+// native index of the breakpoints of a function, it's built from the pc2line
+// table once per function and the breakpoints located at `pc` are
+// `locs[pc_index[pc]]` to `locs[pc_index[pc + 1] - 1]`
+typedef struct JSDebugBpTable {
+  JSDebugLoc *locs;
+  int loc_count;
+  uint32_t pc_index[0]; /* byte_code_len + 1 entries */
+} JSDebugBpTable;
+
+// keep in sync with `js_debug_pc2line`: besides the entry of the pc2line table,
+// the first pc of each line also accepts the breakpoint at column 0 of that
+// line
+static JSDebugBpTable *js_debug_new_bp_table(JSRuntime *rt,
+                                             JSFunctionBytecode *b) {
+  JSPc2LineReader r;
+  JSDebugBpTable *tab;
+  uint8_t *line_seen = NULL;
+  int ret, n = 0, line_min, line_max, lines, i, len = b->byte_code_len;
+
+  pc2line_reader_init(&r, b);
+  line_min = line_max = r.line;
+  while ((ret = pc2line_reader_next(&r)) > 0) {
+    if (r.pc >= len)
+      return NULL;
+    line_min = min_int(line_min, r.line);
+    line_max = max_int(line_max, r.line);
+    n++;
+  }
+  if (ret < 0)
     return NULL;
 
-  JSValue fn = sf->cur_func;
-  JSFunctionBytecode *b = JS_VALUE_GET_OBJ(fn)->u.func.function_bytecode;
-
-  size_t delta = pc - b->byte_code_buf;
-  JSAtom file = b->debug.filename;
-  JSValue debug_info = js_debug_pc2line(ctx, JS_NULL, 1, (JSValueConst *)&fn);
-  if (JS_IsException(debug_info))
+  lines = line_max - line_min + 1;
+  line_seen = js_malloc_rt(rt, (lines + 7) / 8);
+  if (!line_seen)
     return NULL;
 
-  // `debug_info` always has `pc2bp`
-  JSValue pc2bp = JS_GetPropertyStr(ctx, debug_info, "pc2bp");
-  bps = JS_GetPropertyUint32(ctx, pc2bp, delta);
-  if (JS_IsUndefined(bps))
+  // at most `n` entries plus the column 0 entry of each line
+  tab = js_mallocz_rt(rt, sizeof(*tab) + sizeof(tab->pc_index[0]) * (len + 1) +
+                              sizeof(tab->locs[0]) * (n + min_int(n, lines)));
+  if (!tab)
     goto done;
+  tab->locs = (JSDebugLoc *)(tab->pc_index + len + 1);
+
+  // count the entries of each pc into `pc_index[pc + 1]`
+  memset(line_seen, 0, (lines + 7) / 8);
+  pc2line_reader_init(&r, b);
+  while (pc2line_reader_next(&r) > 0) {
+    i = r.line - line_min;
+    tab->pc_index[r.pc + 1]++;
+    if (!(line_seen[i >> 3] & (1 << (i & 7)))) {
+      line_seen[i >> 3] |= 1 << (i & 7);
+      tab->pc_index[r.pc + 1]++;
+    }
+  }
+  for (i = 0; i < len; i++)
+    tab->pc_index[i + 1] += tab->pc_index[i];
+  tab->loc_count = tab->pc_index[len];
+
+  // fill the entries by using `pc_index[pc]` as the cursor of `pc`, which
+  // leaves `pc_index[pc]` being the start of `pc + 1`, then shift it back
+  memset(line_seen, 0, (lines + 7) / 8);
+  pc2line_reader_init(&r, b);
+  while (pc2line_reader_next(&r) > 0) {
+    i = r.line - line_min;
+    tab->locs[tab->pc_index[r.pc]++] = (JSDebugLoc){r.line, r.col};
+    if (!(line_seen[i >> 3] & (1 << (i & 7)))) {
+      line_seen[i >> 3] |= 1 << (i & 7);
+      tab->locs[tab->pc_index[r.pc]++] = (JSDebugLoc){r.line, 0};
+    }
+  }
+  for (i = len; i > 0; i--)
+    tab->pc_index[i] = tab->pc_index[i - 1];
+  tab->pc_index[0] = 0;
+
+done:
+  js_free_rt(rt, line_seen);
+  return tab;
+}
+
+static JSDebugBpTable *js_debug_get_bp_table(JSRuntime *rt,
+                                             JSFunctionBytecode *b) {
+  if (!b->debug.bp_table)
+    b->debug.bp_table = js_debug_new_bp_table(rt, b);
+  return b->debug.bp_table;
+}
+
+void js_debug_free_function_bytecode(JSRuntime *rt, JSFunctionBytecode *b) {
+  js_free_rt(rt, b->debug.bp_table);
+  js_free_rt(rt, b->debug.trap_buf);
+  b->debug.bp_table = NULL;
+  b->debug.trap_buf = NULL;
+}
 
-  if (js_get_length32(ctx, len, bps) || *len == 0)
+static JSBreakpoint *js_debug_get_bp(JSContext *ctx, JSAtom file, int line,
+                                     int col);
+static BOOL js_debug_file_has_bp(JSContext *ctx, JSAtom file);
+static void js_debug_free_bp_list(JSContext *ctx);
+
+// returns TRUE if one of the breakpoints located at `pc` is set by user
+static BOOL js_debug_has_bp_at(JSContext *ctx, JSFunctionBytecode *b,
+                               JSDebugBpTable *tab, uint32_t pc) {
+  JSDebugLoc *loc = tab->locs + tab->pc_index[pc];
+  JSDebugLoc *loc_end = tab->locs + tab->pc_index[pc + 1];
+  for (; loc < loc_end; loc++) {
+    if (js_debug_get_bp(ctx, b->debug.filename, loc->line, loc->col))
+      return TRUE;
+  }
+  return FALSE;
+}
+
+// patch `trap_buf` to make it in line with the breakpoints set by user, the
+// opcodes of `trap_buf` are only toggled between the original ones and
+// `OP_debug_trap` so the frames running on it are not disturbed
+static void js_debug_sync_traps(JSContext *ctx, JSFunctionBytecode *b) {
+  JSRuntime *rt = ctx->rt;
+  JSDebugBpTable *tab;
+  BOOL has_trap = FALSE;
+  uint32_t pc;
+
+  pthread_mutex_lock(&ctx->debug.bp_mutex);
+  b->debug.bp_gen = ctx->debug.bp_gen;
+  js_debug_free_bp_list(ctx);
+
+  // bail out before building the table or looking up the locations if there
+  // is no breakpoint in the file of `b`, and there is nothing to restore
+  if (!js_debug_file_has_bp(ctx, b->debug.filename) && !b->debug.has_trap)
     goto done;
 
-  ret = calloc(*len, sizeof(JSBreakpoint));
-  if (!ret)
+  tab = js_debug_get_bp_table(rt, b);
+  if (!tab)
     goto done;
 
-  for (uint32_t i = 0; i < *len; i++) {
-    bp = JS_GetPropertyUint32(ctx, bps, i);
+  for (pc = 0; pc < b->byte_code_len; pc++) {
+    if (tab->pc_index[pc] == tab->pc_index[pc + 1])
+      continue;
+
+    if (js_debug_has_bp_at(ctx, b, tab, pc)) {
+      if (!b->debug.trap_buf) {
+        b->debug.trap_buf = js_malloc_rt(rt, b->byte_code_len);
+        if (!b->debug.trap_buf)
+          goto done;
+        memcpy(b->debug.trap_buf, b->byte_code_buf, b->byte_code_len);
+      }
+      b->debug.trap_buf[pc] = OP_debug_trap;
+      has_trap = TRUE;
+    } else if (b->debug.trap_buf) {
+      b->debug.trap_buf[pc] = b->byte_code_buf[pc];
+    }
+  }
+
+done:
+  b->debug.has_trap = has_trap;
+  pthread_mutex_unlock(&ctx->debug.bp_mutex);
+}
 
-    ret[i].file = file;
-    line = JS_GetPropertyStr(ctx, bp, "line");
-    JS_ToInt32Free(ctx, &ret[i].line, line);
-    JS_FreeValue(ctx, line);
+const uint8_t *js_debug_code_buf(JSContext *ctx, JSFunctionBytecode *b) {
+  if (!b->has_debug)
+    return b->byte_code_buf;
 
-    col = JS_GetPropertyStr(ctx, bp, "col");
-    JS_ToInt32Free(ctx, &ret[i].col, col);
-    JS_FreeValue(ctx, line);
+  // `bp_mutex` is held while evaluating the condition or the log message
+  if (b->debug.bp_gen != ctx->debug.bp_gen && !ctx->debug.in_trap)
+    js_debug_sync_traps(ctx, b);
 
-    JS_FreeValue(ctx, bp);
+  return b->debug.has_trap ? b->debug.trap_buf : b->byte_code_buf;
+}
+
+static BOOL js_debug_is_ident(const char *str) {
+  const char *p = str;
+  if (!*p || !strcmp(str, "this"))
+    return FALSE;
+  for (; *p; p++) {
+    if (!(*p == '_' || *p == '$' || (*p >= 'a' && *p <= 'z') ||
+          (*p >= 'A' && *p <= 'Z') || (p != str && *p >= '0' && *p <= '9')))
+      return FALSE;
   }
+  return TRUE;
+}
 
-done:
-  JS_FreeValue(ctx, bps);
-  JS_FreeValue(ctx, pc2bp);
-  JS_FreeValue(ctx, debug_info);
-  return ret;
+// `log_message` is turned into a template literal, `{expr}` becomes `${expr}`
+// and the text outside of the braces is escaped
+static void js_debug_put_log_template(DynBuf *dbuf, const char *msg) {
+  int depth = 0;
+  dbuf_putc(dbuf, '`');
+  for (; *msg; msg++) {
+    if (depth) {
+      if (*msg == '{')
+        depth++;
+      else if (*msg == '}')
+        depth--;
+    } else if (*msg == '{') {
+      dbuf_putc(dbuf, '$');
+      depth++;
+    } else if (*msg == '`' || *msg == '\\' || *msg == '$') {
+      dbuf_putc(dbuf, '\\');
+    }
+    dbuf_putc(dbuf, *msg);
+  }
+  // close the unterminated expression
+  while (depth--)
+    dbuf_putc(dbuf, '}');
+  dbuf_putc(dbuf, '`');
 }
 
-JSBreakpoint *js_debug_get_bp(JSContext *ctx, JSBreakpoint bp);
-static int js_debug_interrupt(const uint8_t *pc, JSRuntime *rt, void *opaque) {
-  JSContext *ctx;
+static JSValue js_debug_compile_expr(JSContext *ctx, DynBuf *params,
+                                     const char *expr, BOOL is_log) {
+  DynBuf dbuf;
+  JSValue func;
+
+  js_dbuf_init(ctx, &dbuf);
+  dbuf_putstr(&dbuf, "(function (");
+  dbuf_put(&dbuf, params->buf, params->size);
+  dbuf_putstr(&dbuf, ") {\nreturn (");
+  if (is_log)
+    js_debug_put_log_template(&dbuf, expr);
+  else
+    dbuf_putstr(&dbuf, expr);
+  dbuf_putstr(&dbuf, "\n);\n})");
+  if (dbuf_putc(&dbuf, '\0')) {
+    dbuf_free(&dbuf);
+    return JS_ThrowOutOfMemory(ctx);
+  }
 
-  if (unlikely(rt->debug)) {
-    ctx = opaque;
+  func = JS_Eval(ctx, (const char *)dbuf.buf, dbuf.size - 1, "<debugger>",
+                 JS_EVAL_TYPE_GLOBAL);
+  dbuf_free(&dbuf);
+  return func;
+}
 
-    uint32_t len;
-    JSBreakpoint *bps = js_debug_bps_from_pc(pc, rt, ctx, &len);
-    if (len == 0)
-      return 0;
+static void js_debug_log(JSContext *ctx, JSBreakpoint *bp, const char *msg,
+                         size_t len) {
+  const char *file = JS_AtomToCString(ctx, bp->file);
+  if (!file)
+    return;
 
-    for (uint32_t i = 0; i < len; i++) {
-      if (bps[i].file && js_debug_get_bp(ctx, bps[i])) {
-        pthread_mutex_lock(&ctx->debug.bp_mutex);
-        ctx->debug.paused = TRUE;
-        pthread_cond_wait(&ctx->debug.bp_cond, &ctx->debug.bp_mutex);
-        ctx->debug.paused = FALSE;
-        pthread_mutex_unlock(&ctx->debug.bp_mutex);
+  if (ctx->debug.log_handler) {
+    ctx->debug.log_handler(ctx, file, bp->line, bp->col, msg, len,
+                           ctx->debug.log_opaque);
+  } else {
+    printf("%s:%d:%d: %.*s\n", file, bp->line, bp->col, (int)len, msg);
+    fflush(stdout);
+  }
+  JS_FreeCString(ctx, file);
+}
+
+// report the pending exception through the log handler and clear it
+static void js_debug_log_exception(JSContext *ctx, JSBreakpoint *bp) {
+  JSValue exc = JS_GetException(ctx);
+  size_t len;
+  const char *str = JS_ToCStringLen(ctx, &len, exc);
+  if (str) {
+    js_debug_log(ctx, bp, str, len);
+    JS_FreeCString(ctx, str);
+  } else {
+    JS_FreeValue(ctx, JS_GetException(ctx));
+  }
+  JS_FreeValue(ctx, exc);
+}
+
+static void js_debug_free_compiled(JSContext *ctx, JSBreakpoint *bp) {
+  JS_FreeValue(ctx, bp->compiled_for);
+  JS_FreeValue(ctx, bp->cond_func);
+  JS_FreeValue(ctx, bp->log_func);
+  bp->compiled_for = JS_UNDEFINED;
+  bp->cond_func = JS_UNDEFINED;
+  bp->log_func = JS_UNDEFINED;
+  js_free(ctx, bp->param_idx);
+  bp->param_idx = NULL;
+  bp->param_count = 0;
+}
+
+// compile the condition and the log message of `bp` into the functions whose
+// parameters are the args, vars and closure vars of `b`, so they are compiled
+// once and evaluated with the variables of any frame of `b` later. The failed
+// compilations are reported and leave the functions being JS_NULL
+static void js_debug_compile_bp(JSContext *ctx, JSBreakpoint *bp,
+                                JSFunctionBytecode *b) {
+  int i, j, var_count = b->arg_count + b->var_count + b->closure_var_count;
+  JSAtom *params = NULL, name;
+  const char *str;
+  DynBuf dbuf;
+
+  js_debug_free_compiled(ctx, bp);
+  bp->compiled_for = JS_DupValue(ctx, JS_MKPTR(JS_TAG_FUNCTION_BYTECODE, b));
+  bp->cond_func = JS_NULL;
+  bp->log_func = JS_NULL;
+
+  js_dbuf_init(ctx, &dbuf);
+  bp->param_idx = js_malloc(ctx, sizeof(bp->param_idx[0]) * max_int(var_count, 1));
+  params = js_malloc(ctx, sizeof(params[0]) * max_int(var_count, 1));
+  if (!bp->param_idx || !params)
+    goto done;
+
+  // the variables sharing the same name are bound to the same parameter,
+  // see `js_debug_eval_bp` for which one is picked
+  for (i = 0; i < var_count; i++) {
+    bp->param_idx[i] = -1;
+    if (i < b->arg_count + b->var_count) {
+      if (!b->vardefs)
+        continue;
+      name = b->vardefs[i].var_name;
+    } else {
+      name = b->closure_var[i - b->arg_count - b->var_count].var_name;
+    }
+
+    for (j = 0; j < bp->param_count; j++) {
+      if (params[j] == name)
         break;
+    }
+    if (j == bp->param_count) {
+      str = JS_AtomToCString(ctx, name);
+      if (!str)
+        goto done;
+      if (!js_debug_is_ident(str)) {
+        JS_FreeCString(ctx, str);
+        continue;
       }
+      if (bp->param_count)
+        dbuf_putc(&dbuf, ',');
+      dbuf_putstr(&dbuf, str);
+      JS_FreeCString(ctx, str);
+      params[bp->param_count++] = name;
     }
+    bp->param_idx[i] = j;
   }
-  return 0;
+
+  if (bp->condition) {
+    bp->cond_func = js_debug_compile_expr(ctx, &dbuf, bp->condition, FALSE);
+    if (JS_IsException(bp->cond_func)) {
+      js_debug_log_exception(ctx, bp);
+      bp->cond_func = JS_NULL;
+    }
+  }
+  if (bp->log_message) {
+    bp->log_func = js_debug_compile_expr(ctx, &dbuf, bp->log_message, TRUE);
+    if (JS_IsException(bp->log_func)) {
+      js_debug_log_exception(ctx, bp);
+      bp->log_func = JS_NULL;
+    }
+  }
+
+done:
+  js_free(ctx, params);
+  dbuf_free(&dbuf);
+}
+
+// call the compiled `func` with the variables of the frame `sf`. If several
+// variables share a name, the last one which is neither undefined nor
+// uninitialized wins since the scopes at the current pc are unknown
+static JSValue js_debug_eval_bp(JSContext *ctx, JSBreakpoint *bp,
+                                JSValueConst func, JSStackFrame *sf) {
+  JSObject *p = JS_VALUE_GET_OBJ(sf->cur_func);
+  JSFunctionBytecode *b = p->u.func.function_bytecode;
+  JSValue *argv, val, ret;
+  int i, k;
+
+  argv = js_malloc(ctx, sizeof(argv[0]) * max_int(bp->param_count, 1));
+  if (!argv)
+    return JS_EXCEPTION;
+  for (i = 0; i < bp->param_count; i++)
+    argv[i] = JS_UNDEFINED;
+
+  for (i = 0; i < b->arg_count + b->var_count + b->closure_var_count; i++) {
+    k = bp->param_idx[i];
+    if (k < 0)
+      continue;
+    if (i < b->arg_count) {
+      val = sf->arg_buf[i];
+    } else if (i < b->arg_count + b->var_count) {
+      val = sf->var_buf[i - b->arg_count];
+    } else {
+      JSVarRef *var_ref = p->u.func.var_refs[i - b->arg_count - b->var_count];
+      if (!var_ref)
+        continue;
+      val = *var_ref->pvalue;
+    }
+    if (!JS_IsUndefined(val) && !JS_IsUninitialized(val))
+      argv[k] = val;
+  }
+
+  ret = JS_Call(ctx, func, JS_UNDEFINED, bp->param_count,
+                (JSValueConst *)argv);
+  js_free(ctx, argv);
+  return ret;
+}
+
+// return TRUE if the vm should be paused by `bp`
+static BOOL js_debug_bp_hit(JSContext *ctx, JSBreakpoint *bp,
+                            JSFunctionBytecode *b) {
+  JSStackFrame *sf = ctx->rt->current_stack_frame;
+  JSValue ret;
+  const char *str;
+  size_t len;
+  int truthy;
+
+  if (!bp->condition && !bp->log_message)
+    return TRUE;
+
+  if (JS_VALUE_GET_PTR(bp->compiled_for) != b)
+    js_debug_compile_bp(ctx, bp, b);
+
+  if (bp->condition) {
+    if (JS_IsNull(bp->cond_func))
+      return FALSE;
+    ret = js_debug_eval_bp(ctx, bp, bp->cond_func, sf);
+    if (JS_IsException(ret)) {
+      js_debug_log_exception(ctx, bp);
+      return FALSE;
+    }
+    truthy = JS_ToBoolFree(ctx, ret);
+    if (!truthy)
+      return FALSE;
+  }
+
+  if (!bp->log_message)
+    return TRUE;
+
+  if (JS_IsNull(bp->log_func))
+    return FALSE;
+  ret = js_debug_eval_bp(ctx, bp, bp->log_func, sf);
+  if (JS_IsException(ret)) {
+    js_debug_log_exception(ctx, bp);
+    return FALSE;
+  }
+  str = JS_ToCStringLen(ctx, &len, ret);
+  JS_FreeValue(ctx, ret);
+  if (!str) {
+    js_debug_log_exception(ctx, bp);
+    return FALSE;
+  }
+  js_debug_log(ctx, bp, str, len);
+  JS_FreeCString(ctx, str);
+  return FALSE;
+}
+
+void js_debug_trap(JSContext *ctx, JSFunctionBytecode *b, uint32_t pc) {
+  JSDebugBpTable *tab = b->debug.bp_table;
+  JSDebugLoc *loc, *loc_end;
+  JSBreakpoint *bp;
+  BOOL pause = FALSE;
+
+  // ignore the traps hit by the condition or the log message
+  if (!ctx->rt->debug || !tab || ctx->debug.in_trap)
+    return;
+
+  pthread_mutex_lock(&ctx->debug.bp_mutex);
+  ctx->debug.in_trap = TRUE;
+  js_debug_free_bp_list(ctx);
+
+  // the breakpoint may be deleted after `trap_buf` was patched
+  loc = tab->locs + tab->pc_index[pc];
+  loc_end = tab->locs + tab->pc_index[pc + 1];
+  for (; loc < loc_end && !pause; loc++) {
+    bp = js_debug_get_bp(ctx, b->debug.filename, loc->line, loc->col);
+    if (bp)
+      pause = js_debug_bp_hit(ctx, bp, b);
+  }
+
+  ctx->debug.in_trap = FALSE;
+  if (pause) {
+    ctx->debug.paused = TRUE;
+    pthread_cond_wait(&ctx->debug.bp_cond, &ctx->debug.bp_mutex);
+    ctx->debug.paused = FALSE;
+  }
+  pthread_mutex_unlock(&ctx->debug.bp_mutex);
 }
 
 int js_debug_init(JSContext *ctx) {
@@ -430,9 +819,6 @@ int js_debug_init(JSContext *ctx) {
   if (pthread_cond_init(&ctx->debug.bp_cond, NULL))
     return -1;
 
-  init_list_head(&ctx->debug.bps);
-
-  JS_SetPCInterruptHandler(ctx->rt, &js_debug_interrupt, ctx);
   return 0;
 }
 
@@ -458,67 +844,280 @@ void js_debug_ready2start(JSContext *ctx) {
 void js_debug_on(JSContext *ctx) { ctx->rt->debug = TRUE; }
 void js_debug_off(JSContext *ctx) { ctx->rt->debug = FALSE; }
 
-void js_debug_free_bp(JSContext *ctx, JSBreakpoint *bp) {
+// the breakpoints set by user are kept in an open addressing hash set with
+// linear probing, besides the breakpoints themselves the set also holds an
+// entry per file whose `line` is `JS_DEBUG_BP_FILE_LINE`, it counts the
+// breakpoints in that file to skip the files without breakpoints quickly, so
+// the breakpoints themselves are restricted to the non-negative lines
+#define JS_DEBUG_BP_FILE_LINE (-1)
+#define JS_DEBUG_BP_HASH_INIT_SIZE 16
+
+static uint32_t js_debug_bp_hash(JSAtom file, int line, int col) {
+  uint32_t h = file;
+  h = h * 0x9e3779b1 + line;
+  h = h * 0x9e3779b1 + col;
+  return h ^ (h >> 16);
+}
+
+// return the slot of the breakpoint, or the empty slot to put it in
+static uint32_t js_debug_bp_find_slot(JSContext *ctx, JSAtom file, int line,
+                                      int col) {
+  uint32_t mask = ctx->debug.bp_hash_size - 1;
+  uint32_t i = js_debug_bp_hash(file, line, col) & mask;
+  JSBreakpoint *bp;
+
+  while ((bp = ctx->debug.bp_hash[i])) {
+    if (bp->file == file && bp->line == line && bp->col == col)
+      break;
+    i = (i + 1) & mask;
+  }
+  return i;
+}
+
+// get breakpoint from the breakpoints collection manually specified by user
+static JSBreakpoint *js_debug_get_bp(JSContext *ctx, JSAtom file, int line,
+                                     int col) {
+  if (!ctx->debug.bp_count)
+    return NULL;
+  return ctx->debug.bp_hash[js_debug_bp_find_slot(ctx, file, line, col)];
+}
+
+static BOOL js_debug_file_has_bp(JSContext *ctx, JSAtom file) {
+  return js_debug_get_bp(ctx, file, JS_DEBUG_BP_FILE_LINE, 0) != NULL;
+}
+
+static int js_debug_bp_hash_resize(JSContext *ctx, uint32_t new_size) {
+  JSBreakpoint **new_hash, **old_hash = ctx->debug.bp_hash, *bp;
+  uint32_t i, j, old_size = ctx->debug.bp_hash_size;
+
+  new_hash = calloc(new_size, sizeof(new_hash[0]));
+  if (!new_hash)
+    return -1;
+
+  for (i = 0; i < old_size; i++) {
+    bp = old_hash[i];
+    if (!bp)
+      continue;
+    j = js_debug_bp_hash(bp->file, bp->line, bp->col) & (new_size - 1);
+    while (new_hash[j])
+      j = (j + 1) & (new_size - 1);
+    new_hash[j] = bp;
+  }
+
+  free(old_hash);
+  ctx->debug.bp_hash = new_hash;
+  ctx->debug.bp_hash_size = new_size;
+  return 0;
+}
+
+// put the entry into the set if it's absent, `file` is duplicated in that case
+static JSBreakpoint *js_debug_bp_hash_add(JSContext *ctx, JSAtom file,
+                                          int line, int col) {
+  JSBreakpoint *bp;
+  uint32_t i;
+
+  // keep the load factor under 1/2
+  if (2 * (ctx->debug.bp_count + 1) > ctx->debug.bp_hash_size) {
+    if (js_debug_bp_hash_resize(ctx, max_int(JS_DEBUG_BP_HASH_INIT_SIZE,
+                                             2 * ctx->debug.bp_hash_size)))
+      return NULL;
+  }
+
+  i = js_debug_bp_find_slot(ctx, file, line, col);
+  if (ctx->debug.bp_hash[i])
+    return ctx->debug.bp_hash[i];
+
+  bp = calloc(1, sizeof(*bp));
+  if (!bp)
+    return NULL;
+  bp->file = JS_DupAtom(ctx, file);
+  bp->line = line;
+  bp->col = col;
+  bp->compiled_for = JS_UNDEFINED;
+  bp->cond_func = JS_UNDEFINED;
+  bp->log_func = JS_UNDEFINED;
+  ctx->debug.bp_hash[i] = bp;
+  ctx->debug.bp_count++;
+  return bp;
+}
+
+static void js_debug_free_bp(JSContext *ctx, JSBreakpoint *bp) {
+  // the compiled functions are only touched by the thread running the script
+  if (!JS_IsUndefined(bp->compiled_for)) {
+    bp->next_free = ctx->debug.bp_free_list;
+    ctx->debug.bp_free_list = bp;
+    return;
+  }
   JS_FreeAtom(ctx, bp->file);
+  free(bp->condition);
+  free(bp->log_message);
   free(bp);
 }
 
-void js_free_debug(JSContext *ctx) {
-  struct list_head *el;
+// free the breakpoints deferred by `js_debug_free_bp`, should be called on the
+// thread running the script with `bp_mutex` held
+static void js_debug_free_bp_list(JSContext *ctx) {
+  JSBreakpoint *bp;
+  while ((bp = ctx->debug.bp_free_list)) {
+    ctx->debug.bp_free_list = bp->next_free;
+    js_debug_free_compiled(ctx, bp);
+    js_debug_free_bp(ctx, bp);
+  }
+}
+
+// remove the entry at slot `i` and shift back the entries following it in the
+// same probe sequence, so no tombstone is needed
+static void js_debug_bp_hash_del(JSContext *ctx, uint32_t i) {
+  uint32_t mask = ctx->debug.bp_hash_size - 1, j = i, k;
   JSBreakpoint *bp;
 
+  js_debug_free_bp(ctx, ctx->debug.bp_hash[i]);
+  ctx->debug.bp_hash[i] = NULL;
+  ctx->debug.bp_count--;
+
+  for (;;) {
+    j = (j + 1) & mask;
+    bp = ctx->debug.bp_hash[j];
+    if (!bp)
+      break;
+    k = js_debug_bp_hash(bp->file, bp->line, bp->col) & mask;
+    // move `bp` into the hole if its home slot `k` is not in `(i, j]`
+    if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+      continue;
+    ctx->debug.bp_hash[i] = bp;
+    ctx->debug.bp_hash[j] = NULL;
+    i = j;
+  }
+}
+
+void js_free_debug(JSContext *ctx) {
+  uint32_t i;
+
   pthread_mutex_destroy(&ctx->debug.bp_mutex);
   pthread_cond_destroy(&ctx->debug.bp_cond);
 
-  list_for_each(el, &ctx->debug.bps) {
-    bp = list_entry(el, JSBreakpoint, link);
-    js_debug_free_bp(ctx, bp);
+  for (i = 0; i < ctx->debug.bp_hash_size; i++) {
+    if (ctx->debug.bp_hash[i])
+      js_debug_free_bp(ctx, ctx->debug.bp_hash[i]);
   }
+  js_debug_free_bp_list(ctx);
+  free(ctx->debug.bp_hash);
+  ctx->debug.bp_hash = NULL;
+  ctx->debug.bp_hash_size = 0;
+  ctx->debug.bp_count = 0;
 }
 
-// get breakpoint from the breakpoints collection manually specified by user
-JSBreakpoint *js_debug_get_bp(JSContext *ctx, JSBreakpoint bp) {
-  struct list_head *el;
-  JSBreakpoint *iter = NULL;
-  JSBreakpoint *bpp = NULL;
-
-  list_for_each(el, &ctx->debug.bps) {
-    iter = list_entry(el, JSBreakpoint, link);
-    if (iter->file == bp.file && iter->line == bp.line && iter->col == bp.col) {
-      bpp = iter;
-      break;
-    }
-  }
-  return bpp;
+static char *js_debug_strdup(const char *str) {
+  return str ? strdup(str) : NULL;
 }
 
-// add breakpoint to the breakpoints collection manually specified by user
-int js_debug_add_bp(JSContext *ctx, JSBreakpoint bp) {
-  JSBreakpoint *bpp;
-  if (js_debug_get_bp(ctx, bp))
-    return 0;
+// add breakpoint to the breakpoints collection manually specified by user, the
+// existing one at the same location is replaced
+static int js_debug_add_bp(JSContext *ctx, JSAtom file, int line, int col,
+                           const char *condition, const char *log_message) {
+  JSBreakpoint *bp, *file_bp;
+  char *cond_str = NULL, *log_str = NULL;
+  int ret = -1;
 
-  bpp = malloc(sizeof(*bpp));
-  if (!bpp)
+  if (line < 0)
     return -1;
 
-  memcpy(bpp, &bp, sizeof(bp));
-  list_add_tail(&bpp->link, &ctx->debug.bps);
-  return 0;
+  cond_str = js_debug_strdup(condition);
+  log_str = js_debug_strdup(log_message);
+  if ((condition && !cond_str) || (log_message && !log_str))
+    goto fail;
+
+  pthread_mutex_lock(&ctx->debug.bp_mutex);
+  file_bp = js_debug_bp_hash_add(ctx, file, JS_DEBUG_BP_FILE_LINE, 0);
+  if (!file_bp)
+    goto done;
+
+  bp = js_debug_get_bp(ctx, file, line, col);
+  if (bp) {
+    js_debug_bp_hash_del(ctx, js_debug_bp_find_slot(ctx, file, line, col));
+    file_bp->count--;
+  }
+
+  bp = js_debug_bp_hash_add(ctx, file, line, col);
+  if (!bp) {
+    if (!file_bp->count) {
+      js_debug_bp_hash_del(
+          ctx, js_debug_bp_find_slot(ctx, file, JS_DEBUG_BP_FILE_LINE, 0));
+    }
+    goto done;
+  }
+
+  bp->condition = cond_str;
+  bp->log_message = log_str;
+  cond_str = log_str = NULL;
+  file_bp->count++;
+  ctx->debug.bp_gen++;
+  ret = 0;
+
+done:
+  pthread_mutex_unlock(&ctx->debug.bp_mutex);
+fail:
+  free(cond_str);
+  free(log_str);
+  return ret;
 }
 
-void js_debug_del_bp(JSContext *ctx, JSBreakpoint bp) {
-  JSBreakpoint *bpp = js_debug_get_bp(ctx, bp);
-  if (bpp) {
-    list_del(&bpp->link);
-    js_debug_free_bp(ctx, bpp);
+static void js_debug_del_bp(JSContext *ctx, JSAtom file, int line, int col) {
+  JSBreakpoint *file_bp;
+
+  if (line < 0)
+    return;
+
+  pthread_mutex_lock(&ctx->debug.bp_mutex);
+  if (!js_debug_get_bp(ctx, file, line, col))
+    goto done;
+
+  js_debug_bp_hash_del(ctx, js_debug_bp_find_slot(ctx, file, line, col));
+
+  file_bp = js_debug_get_bp(ctx, file, JS_DEBUG_BP_FILE_LINE, 0);
+  if (--file_bp->count == 0) {
+    js_debug_bp_hash_del(
+        ctx, js_debug_bp_find_slot(ctx, file, JS_DEBUG_BP_FILE_LINE, 0));
   }
+  ctx->debug.bp_gen++;
+
+done:
+  pthread_mutex_unlock(&ctx->debug.bp_mutex);
 }
 
 int js_debug_set_breakpoint(JSContext *ctx, const char *file, int line,
                             int col) {
-  return js_debug_add_bp(ctx, (JSBreakpoint){(struct list_head){},
-                                             JS_NewAtom(ctx, file), line, col});
+  return js_debug_set_breakpoint2(ctx, file, line, col, NULL, NULL);
+}
+
+int js_debug_set_breakpoint2(JSContext *ctx, const char *file, int line,
+                             int col, const char *condition,
+                             const char *log_message) {
+  int ret;
+  JSAtom atom = JS_NewAtom(ctx, file);
+  if (atom == JS_ATOM_NULL)
+    return -1;
+
+  ret = js_debug_add_bp(ctx, atom, line, col, condition, log_message);
+  JS_FreeAtom(ctx, atom);
+  return ret;
+}
+
+void js_debug_set_log_handler(JSContext *ctx, JSDebugLogHandler *handler,
+                              void *opaque) {
+  ctx->debug.log_handler = handler;
+  ctx->debug.log_opaque = opaque;
+}
+
+int js_debug_del_breakpoint(JSContext *ctx, const char *file, int line,
+                            int col) {
+  JSAtom atom = JS_NewAtom(ctx, file);
+  if (atom == JS_ATOM_NULL)
+    return -1;
+
+  js_debug_del_bp(ctx, atom, line, col);
+  JS_FreeAtom(ctx, atom);
+  return 0;
 }
 
 void js_debug_continue(JSContext *ctx) {
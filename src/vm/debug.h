@@ -2,10 +2,22 @@
 #define QUICKJS_DEBUG_H
 
 #include "def.h"
+#include "func.h"
 
 JSValue js_debug_pc2line(JSContext *ctx, JSValueConst this_val, int argc,
                          JSValueConst *argv);
 
+void js_debug_free_function_bytecode(JSRuntime *rt, JSFunctionBytecode *b);
+
+// return the byte code to be executed by a new frame of `b`, it's the copy of
+// `b->byte_code_buf` patched with `OP_debug_trap` if `b` has breakpoints, the
+// functions without breakpoints run their original byte code at full speed
+const uint8_t *js_debug_code_buf(JSContext *ctx, JSFunctionBytecode *b);
+
+// called by `OP_debug_trap` at `pc`, pause the vm if the breakpoint is still
+// set
+void js_debug_trap(JSContext *ctx, JSFunctionBytecode *b, uint32_t pc);
+
 int js_debug_init(JSContext *ctx);
 void js_debug_wait_ready2start(JSContext *ctx);
 void js_debug_ready2start(JSContext *ctx);
@@ -15,6 +27,11 @@ void js_debug_off(JSContext *ctx);
 
 int js_debug_set_breakpoint(JSContext *ctx, const char *file, int line,
                             int col);
+int js_debug_set_breakpoint2(JSContext *ctx, const char *file, int line,
+                             int col, const char *condition,
+                             const char *log_message);
+void js_debug_set_log_handler(JSContext *ctx, JSDebugLogHandler *handler,
+                              void *opaque);
 int js_debug_del_breakpoint(JSContext *ctx, const char *file, int line,
                             int col);
 void js_debug_continue(JSContext *ctx);
@@ -267,6 +267,14 @@ __maybe_unused void JS_DumpValueShort(JSRuntime *rt, JSValueConst val) {
     p = JS_VALUE_GET_STRING(val);
     JS_DumpString(rt, p);
   } break;
+  case JS_TAG_STRING_ROPE: {
+    JSStringRope *r = JS_VALUE_GET_PTR(val);
+    if (r->depth == 0) {
+      JS_DumpString(rt, JS_VALUE_GET_STRING(r->left));
+    } else {
+      printf("[rope %u]", r->len);
+    }
+  } break;
   case JS_TAG_FUNCTION_BYTECODE: {
     JSFunctionBytecode *b = JS_VALUE_GET_PTR(val);
     char buf[ATOM_GET_STR_BUF_SIZE];
@@ -335,12 +343,20 @@ void dump_byte_code(JSContext *ctx, int pass, const uint8_t *tab, int len,
                     const JSVarDef *args, int arg_count, const JSVarDef *vars,
                     int var_count, const JSClosureVar *closure_var,
                     int closure_var_count, const JSValue *cpool,
-                    uint32_t cpool_count, const char *source, int line_num,
-                    const LabelSlot *label_slots, JSFunctionBytecode *b) {
+                    uint32_t cpool_count, const char *source, int source_len,
+                    int line_num, const LabelSlot *label_slots,
+                    JSFunctionBytecode *b) {
   const JSOpCode *oi;
   int pos, pos_next, op, size, idx, addr, line, line1, in_source;
   uint8_t *bits = js_mallocz(ctx, len * sizeof(*bits));
   BOOL use_short_opcodes = (b != NULL);
+  char *source_str = NULL;
+
+  /* the source of a nested function is not zero terminated */
+  if (source) {
+    source_str = js_strndup(ctx, source, source_len);
+    source = source_str;
+  }
 
   /* scan for jump targets */
   for (pos = 0; pos < len; pos = pos_next) {
@@ -371,6 +387,10 @@ void dump_byte_code(JSContext *ctx, int pass, const uint8_t *tab, int len,
         pos++;
         addr = get_u32(tab + pos);
         goto has_addr;
+      case OP_FMT_loc_i32_label:
+        pos += 7;
+        addr = get_u32(tab + pos);
+        goto has_addr;
       has_addr:
         if (pass == 1)
           addr = label_slots[addr].pos;
@@ -464,8 +484,20 @@ void dump_byte_code(JSContext *ctx, int pass, const uint8_t *tab, int len,
       printf(" %u", get_u16(tab + pos));
       break;
     case OP_FMT_npop_u16:
+    case OP_FMT_arg_arg:
       printf(" %u,%u", get_u16(tab + pos), get_u16(tab + pos + 2));
       break;
+    case OP_FMT_atom_u16_loc:
+      printf(" ");
+      print_atom(ctx, get_u32(tab + pos));
+      printf(",%u,%u", get_u16(tab + pos + 4), get_u16(tab + pos + 6));
+      break;
+    case OP_FMT_loc_i32_label:
+      printf(" %u,%d", get_u16(tab + pos), get_i32(tab + pos + 2));
+      addr = get_u32(tab + pos + 6);
+      if (pass == 3)
+        printf(",%u", addr + pos + 6);
+      break;
     case OP_FMT_i16:
       printf(" %d", get_i16(tab + pos));
       break;
@@ -603,6 +635,7 @@ void dump_byte_code(JSContext *ctx, int pass, const uint8_t *tab, int len,
       printf("\n");
     print_lines(source, line, INT32_MAX);
   }
+  js_free(ctx, source_str);
   js_free(ctx, bits);
 }
 
@@ -725,6 +758,7 @@ __maybe_unused void js_dump_function_bytecode(JSContext *ctx,
                  b->arg_count, b->vardefs ? b->vardefs + b->arg_count : NULL,
                  b->var_count, b->closure_var, b->closure_var_count, b->cpool,
                  b->cpool_count, b->has_debug ? b->debug.source : NULL,
+                 b->has_debug ? b->debug.source_len : 0,
                  b->has_debug ? b->debug.line_num : -1, NULL, b);
 #if defined(DUMP_BYTECODE) && (DUMP_BYTECODE & 32)
   if (b->has_debug)
@@ -733,4 +767,72 @@ __maybe_unused void js_dump_function_bytecode(JSContext *ctx,
 #endif
   printf("\n");
 }
-#endif
\ No newline at end of file
+#endif
+#ifdef DUMP_OPCODE_STATS
+#include "instr.h"
+
+#define JS_OPCODE_PAIR_STATS_TOP 50
+
+typedef struct JSOpcodeStat {
+  uint64_t count;
+  int idx;
+} JSOpcodeStat;
+
+static int js_opcode_stat_cmp(const void *a, const void *b) {
+  const JSOpcodeStat *sa = a, *sb = b;
+  if (sa->count != sb->count)
+    return sa->count < sb->count ? 1 : -1;
+  return sa->idx - sb->idx;
+}
+
+void JS_DumpOpcodeStats(JSRuntime *rt, FILE *fp) {
+  JSOpcodeStat ops[OP_COUNT], *pairs;
+  uint64_t total = 0, total_pairs = 0, cum = 0;
+  int i, n, pair_count = 0;
+
+  for (i = 0; i < OP_COUNT; i++) {
+    ops[i].count = rt->opcode_stats[i];
+    ops[i].idx = i;
+    total += ops[i].count;
+  }
+  qsort(ops, OP_COUNT, sizeof(ops[0]), js_opcode_stat_cmp);
+
+  fprintf(fp, "OPCODE STATS: %" PRIu64 " instructions\n", total);
+  fprintf(fp, "  %-28s %16s %8s %8s\n", "opcode", "count", "%", "cum%");
+  for (i = 0; i < OP_COUNT && ops[i].count; i++) {
+    cum += ops[i].count;
+    fprintf(fp, "  %-28s %16" PRIu64 " %7.2f%% %7.2f%%\n",
+            short_opcode_info(ops[i].idx).name, ops[i].count,
+            100.0 * ops[i].count / total, 100.0 * cum / total);
+  }
+
+  // the pairs starting with `OP_invalid` are the first opcodes of the frames
+  pairs = js_malloc_rt(rt, sizeof(pairs[0]) * 256 * 256);
+  if (!pairs)
+    return;
+  for (i = 0; i < 256 * 256; i++) {
+    if (!rt->opcode_pair_stats[i] || (i >> 8) == OP_invalid)
+      continue;
+    pairs[pair_count].count = rt->opcode_pair_stats[i];
+    pairs[pair_count].idx = i;
+    total_pairs += pairs[pair_count++].count;
+  }
+  qsort(pairs, pair_count, sizeof(pairs[0]), js_opcode_stat_cmp);
+
+  n = min_int(pair_count, JS_OPCODE_PAIR_STATS_TOP);
+  fprintf(fp, "\nOPCODE PAIR STATS: top %d of %d pairs\n", n, pair_count);
+  fprintf(fp, "  %-57s %16s %8s\n", "pair", "count", "%");
+  for (i = 0; i < n; i++) {
+    fprintf(fp, "  %-28s %-28s %16" PRIu64 " %7.2f%%\n",
+            short_opcode_info(pairs[i].idx >> 8).name,
+            short_opcode_info(pairs[i].idx & 0xff).name, pairs[i].count,
+            100.0 * pairs[i].count / total_pairs);
+  }
+  js_free_rt(rt, pairs);
+}
+#else
+void JS_DumpOpcodeStats(JSRuntime *rt, FILE *fp) {
+  fprintf(fp, "opcode stats are not available, rebuild with "
+              "QJS_DUMP_OPCODE_STATS=ON\n");
+}
+#endif
@@ -26,8 +26,9 @@ void dump_byte_code(JSContext *ctx, int pass, const uint8_t *tab, int len,
                     const JSVarDef *args, int arg_count, const JSVarDef *vars,
                     int var_count, const JSClosureVar *closure_var,
                     int closure_var_count, const JSValue *cpool,
-                    uint32_t cpool_count, const char *source, int line_num,
-                    const LabelSlot *label_slots, JSFunctionBytecode *b);
+                    uint32_t cpool_count, const char *source, int source_len,
+                    int line_num, const LabelSlot *label_slots,
+                    JSFunctionBytecode *b);
 __maybe_unused void dump_pc2line(JSContext *ctx, const uint8_t *buf, int len,
                                  int line_num);
 __maybe_unused void js_dump_function_bytecode(JSContext *ctx,
@@ -56,7 +56,8 @@ void build_backtrace(JSContext *ctx, JSValueConst error_obj,
       b = p->u.func.function_bytecode;
       backtrace_barrier = b->backtrace_barrier;
       if (b->has_debug) {
-        line_num1 = find_line_num(ctx, b, sf->cur_pc - b->byte_code_buf - 1);
+        line_num1 = find_line_num(
+            ctx, b, sf->cur_pc - js_frame_code_buf(b, sf->cur_pc) - 1);
         atom_str = JS_AtomToCString(ctx, b->debug.filename);
         dbuf_printf(&dbuf, " (%s", atom_str ? atom_str : "<null>");
         JS_FreeCString(ctx, atom_str);
@@ -2,6 +2,7 @@
 
 #include "class.h"
 #include "conv.h"
+#include "debug.h"
 #include "error.h"
 #include "func.h"
 #include "gc.h"
@@ -16,6 +17,48 @@
 JSValue js_regexp_constructor_internal(JSContext *ctx, JSValueConst ctor,
                                        JSValue pattern, JSValue bc);
 
+/* return the property cached by `pic` for the object `p` or NULL */
+static inline JSProperty *js_poly_ic_find(JSPolyInlineCache *pic, JSObject *p) {
+  JSShape *sh = p->shape;
+  JSPolyInlineCacheEntry *e;
+  JSObject *holder;
+  int i;
+
+  for (i = 0; i < JS_POLY_IC_SIZE; i++) {
+    e = &pic->entries[i];
+    if (e->shape == sh && sh->id == e->shape_id) {
+      if (!e->holder_shape)
+        return &p->prop[e->prop_idx];
+      /* the prototype is kept alive by the shape of `p` */
+      holder = sh->proto;
+      if (holder->shape == e->holder_shape &&
+          holder->shape->id == e->holder_shape_id)
+        return &holder->prop[e->prop_idx];
+      return NULL;
+    }
+  }
+  return NULL;
+}
+
+/* return the property cached by `gic` or NULL */
+static inline JSProperty *js_global_ic_find(JSContext *ctx,
+                                            JSGlobalInlineCache *gic) {
+  JSObject *var_p, *p;
+
+  var_p = JS_VALUE_GET_OBJ(ctx->global_var_obj);
+  if (!gic->var_shape) {
+    p = var_p;
+  } else {
+    if (var_p->shape != gic->var_shape ||
+        var_p->shape->id != gic->var_shape_id)
+      return NULL;
+    p = JS_VALUE_GET_OBJ(ctx->global_obj);
+  }
+  if (p->shape != gic->shape || p->shape->id != gic->shape_id)
+    return NULL;
+  return &p->prop[gic->prop_idx];
+}
+
 // clang-format off
 /* argv[] is modified if (flags & JS_CALL_FLAG_COPY_ARGV) = 0. */
 JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
@@ -27,17 +70,47 @@ JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
   JSObject *p;
   JSFunctionBytecode *b;
   JSStackFrame sf_s, *sf = &sf_s;
-  const uint8_t *pc;
+  const uint8_t *pc, *code_buf;
   int opcode, arg_allocated_size, i;
   JSValue *local_buf, *stack_buf, *var_buf, *arg_buf, *sp, ret_val, *pval;
   JSVarRef **var_refs;
   size_t alloca_size;
 
+#ifdef DUMP_OPCODE_STATS
+  int prev_opcode = OP_invalid;
+#define COUNT_OPCODE(op) do {                                      \
+                          rt->opcode_stats[op]++;                  \
+                          rt->opcode_pair_stats[(prev_opcode << 8) | (op)]++; \
+                          prev_opcode = (op);                      \
+                        } while (0)
+#else
+#define COUNT_OPCODE(op)
+#endif
+
+/* on the back edges, also move a running frame to the byte code matching
+   the breakpoints changed since it was entered. Both buffers have the same
+   layout so only the base of 'pc' changes. */
+#define POLL_INTERRUPTS() do {                                        \
+                          if (unlikely(--ctx->interrupt_counter <= 0)) { \
+                            if (__js_poll_interrupts(ctx))            \
+                              goto exception;                         \
+                            if (unlikely(rt->debug)) {                \
+                              const uint8_t *buf;                     \
+                              buf = js_debug_code_buf(ctx, b);        \
+                              pc = buf + (pc - code_buf);             \
+                              code_buf = buf;                         \
+                            }                                         \
+                          }                                           \
+                        } while (0)
+
 #if !DIRECT_DISPATCH || defined(INDIRECT_DISPATCH)
-#define SWITCH(pc)    switch (opcode = *pc++)
+#define SWITCH(pc)    opcode = *pc++;                       \
+                      COUNT_OPCODE(opcode);                 \
+                      dispatch: switch (opcode)
 #define CASE(op)    case op
 #define DEFAULT     default
 #define BREAK       break
+#define DISPATCH_OP(op) do { opcode = (op); goto dispatch; } while (0)
 #else
   static const void * const dispatch_table[256] = {
 #define DEF(id, size, n_pop, n_push, f) && case_OP_ ## id,
@@ -52,11 +125,14 @@ JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
 #define SWITCH(pc)    do {                                      \
                           if (js_pc_interrupts(pc, caller_ctx)) \
                             return JS_EXCEPTION;                \
-                        goto *dispatch_table[opcode = *pc++];   \
+                        opcode = *pc++;                         \
+                        COUNT_OPCODE(opcode);                   \
+                        goto *dispatch_table[opcode];           \
                       } while(0);
 #define CASE(op)    case_ ## op
 #define DEFAULT     case_default
 #define BREAK       SWITCH(pc)
+#define DISPATCH_OP(op) goto *dispatch_table[opcode = (op)]
 #endif
 
   if (js_poll_interrupts(caller_ctx))
@@ -77,6 +153,7 @@ JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
       sp = sf->cur_sp;
       sf->cur_sp = NULL; /* cur_sp is NULL if the function is running */
       pc = sf->cur_pc;
+      code_buf = js_frame_code_buf(b, pc);
       sf->prev_frame = rt->current_stack_frame;
       rt->current_stack_frame = sf;
       if (s->throw_flag)
@@ -138,6 +215,9 @@ JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
   stack_buf = var_buf + b->var_count;
   sp = stack_buf;
   pc = b->byte_code_buf;
+  if (unlikely(rt->debug))
+    pc = js_debug_code_buf(b->realm, b);
+  code_buf = pc;
   sf->prev_frame = rt->current_stack_frame;
   rt->current_stack_frame = sf;
   ctx = b->realm; /* set the current realm */
@@ -758,6 +838,51 @@ JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
       }
       BREAK;
 
+    CASE(OP_get_var_ic):
+      {
+        JSValue val;
+        JSAtom atom;
+        JSGlobalInlineCache *gic;
+        JSProperty *pr;
+        atom = get_u32(pc);
+        gic = &b->gic[get_u16(pc + 4)];
+        pc += 6;
+
+        pr = js_global_ic_find(ctx, gic);
+        if (likely(pr && !JS_IsUninitialized(pr->u.value))) {
+          val = JS_DupValue(ctx, pr->u.value);
+        } else {
+          val = js_get_var_ic_miss(ctx, gic, atom);
+          if (unlikely(JS_IsException(val)))
+            goto exception;
+        }
+        *sp++ = val;
+      }
+      BREAK;
+
+    CASE(OP_put_var_ic):
+      {
+        int ret;
+        JSAtom atom;
+        JSGlobalInlineCache *gic;
+        JSProperty *pr;
+        atom = get_u32(pc);
+        gic = &b->gic[get_u16(pc + 4)];
+        pc += 6;
+
+        pr = js_global_ic_find(ctx, gic);
+        if (likely(pr && !JS_IsUninitialized(pr->u.value))) {
+          set_value(ctx, &pr->u.value, sp[-1]);
+          ret = 0;
+        } else {
+          ret = js_put_var_ic_miss(ctx, gic, atom, sp[-1]);
+        }
+        sp--;
+        if (unlikely(ret < 0))
+          goto exception;
+      }
+      BREAK;
+
     CASE(OP_put_var_strict):
       {
         int ret;
@@ -1080,19 +1205,16 @@ JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
 
     CASE(OP_goto):
       pc += (int32_t)get_u32(pc);
-      if (unlikely(js_poll_interrupts(ctx)))
-        goto exception;
+      POLL_INTERRUPTS();
       BREAK;
 #if SHORT_OPCODES
     CASE(OP_goto16):
       pc += (int16_t)get_u16(pc);
-      if (unlikely(js_poll_interrupts(ctx)))
-        goto exception;
+      POLL_INTERRUPTS();
       BREAK;
     CASE(OP_goto8):
       pc += (int8_t)pc[0];
-      if (unlikely(js_poll_interrupts(ctx)))
-        goto exception;
+      POLL_INTERRUPTS();
       BREAK;
 #endif
     CASE(OP_if_true):
@@ -1111,8 +1233,7 @@ JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
         if (res) {
           pc += (int32_t)get_u32(pc - 4) - 4;
         }
-        if (unlikely(js_poll_interrupts(ctx)))
-          goto exception;
+        POLL_INTERRUPTS();
       }
       BREAK;
     CASE(OP_if_false):
@@ -1131,8 +1252,35 @@ JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
         if (!res) {
           pc += (int32_t)get_u32(pc - 4) - 4;
         }
-        if (unlikely(js_poll_interrupts(ctx)))
-          goto exception;
+        POLL_INTERRUPTS();
+      }
+      BREAK;
+    CASE(OP_get_loc_push_i32_lt_if_false):
+      {
+        int res;
+        int32_t val;
+        JSValue op1;
+
+        op1 = var_buf[get_u16(pc)];
+        val = get_u32(pc + 2);
+        pc += 10;
+        if (likely(JS_VALUE_GET_TAG(op1) == JS_TAG_INT)) {
+          res = JS_VALUE_GET_INT(op1) < val;
+        } else if (JS_TAG_IS_FLOAT64(JS_VALUE_GET_TAG(op1))) {
+          res = JS_VALUE_GET_FLOAT64(op1) < val;
+        } else {
+          /* the operands are not counted in the stack size */
+          JSValue tab[2];
+          tab[0] = JS_DupValue(ctx, op1);
+          tab[1] = JS_NewInt32(ctx, val);
+          if (js_relational_slow(ctx, tab + 2, OP_lt))
+            goto exception;
+          res = JS_VALUE_GET_BOOL(tab[0]);
+        }
+        if (!res) {
+          pc += (int32_t)get_u32(pc - 4) - 4;
+        }
+        POLL_INTERRUPTS();
       }
       BREAK;
 #if SHORT_OPCODES
@@ -1152,8 +1300,7 @@ JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
         if (res) {
           pc += (int8_t)pc[-1] - 1;
         }
-        if (unlikely(js_poll_interrupts(ctx)))
-          goto exception;
+        POLL_INTERRUPTS();
       }
       BREAK;
     CASE(OP_if_false8):
@@ -1172,8 +1319,7 @@ JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
         if (!res) {
           pc += (int8_t)pc[-1] - 1;
         }
-        if (unlikely(js_poll_interrupts(ctx)))
-          goto exception;
+        POLL_INTERRUPTS();
       }
       BREAK;
 #endif
@@ -1181,7 +1327,7 @@ JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
       {
         int32_t diff;
         diff = get_u32(pc);
-        sp[0] = JS_NewCatchOffset(ctx, pc + diff - b->byte_code_buf);
+        sp[0] = JS_NewCatchOffset(ctx, pc + diff - code_buf);
         sp++;
         pc += 4;
       }
@@ -1191,7 +1337,7 @@ JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
         int32_t diff;
         diff = get_u32(pc);
         /* XXX: should have a different tag to avoid security flaw */
-        sp[0] = JS_NewInt32(ctx, pc + 4 - b->byte_code_buf);
+        sp[0] = JS_NewInt32(ctx, pc + 4 - code_buf);
         sp++;
         pc += diff;
       }
@@ -1210,7 +1356,7 @@ JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
           goto exception;
         }
         sp--;
-        pc = b->byte_code_buf + pos;
+        pc = code_buf + pos;
       }
       BREAK;
 
@@ -1397,6 +1543,108 @@ JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
       }
       BREAK;
 
+    CASE(OP_get_field_ic):
+      {
+        JSValue val;
+        JSAtom atom;
+        JSInlineCache *ic;
+        JSObject *p;
+        atom = get_u32(pc);
+        ic = &b->ic[get_u16(pc + 4)];
+        pc += 6;
+
+        p = JS_VALUE_GET_OBJ(sp[-1]);
+        if (likely(JS_VALUE_GET_TAG(sp[-1]) == JS_TAG_OBJECT &&
+                   p->shape == ic->shape && p->shape->id == ic->shape_id)) {
+          val = JS_DupValue(ctx, p->prop[ic->prop_idx].u.value);
+        } else {
+          val = js_get_field_ic_miss(ctx, ic, sp[-1], atom);
+          if (unlikely(JS_IsException(val)))
+            goto exception;
+        }
+        JS_FreeValue(ctx, sp[-1]);
+        sp[-1] = val;
+      }
+      BREAK;
+
+    CASE(OP_get_field2_ic):
+      {
+        JSValue val;
+        JSAtom atom;
+        JSPolyInlineCache *pic;
+        JSProperty *pr;
+        atom = get_u32(pc);
+        pic = &b->pic[get_u16(pc + 4)];
+        pc += 6;
+
+        pr = NULL;
+        if (likely(JS_VALUE_GET_TAG(sp[-1]) == JS_TAG_OBJECT))
+          pr = js_poly_ic_find(pic, JS_VALUE_GET_OBJ(sp[-1]));
+        if (likely(pr)) {
+          val = JS_DupValue(ctx, pr->u.value);
+        } else {
+          val = js_get_field2_ic_miss(ctx, pic, sp[-1], atom);
+          if (unlikely(JS_IsException(val)))
+            goto exception;
+        }
+        *sp++ = val;
+      }
+      BREAK;
+
+    CASE(OP_put_field_ic):
+      {
+        int ret;
+        JSAtom atom;
+        JSInlineCache *ic;
+        JSObject *p;
+        atom = get_u32(pc);
+        ic = &b->ic[get_u16(pc + 4)];
+        pc += 6;
+
+        p = JS_VALUE_GET_OBJ(sp[-2]);
+        if (likely(JS_VALUE_GET_TAG(sp[-2]) == JS_TAG_OBJECT &&
+                   p->shape == ic->shape && p->shape->id == ic->shape_id)) {
+          set_value(ctx, &p->prop[ic->prop_idx].u.value, sp[-1]);
+          ret = TRUE;
+        } else {
+          ret = js_put_field_ic_miss(ctx, ic, sp[-2], atom, sp[-1],
+                                     JS_PROP_THROW_STRICT);
+        }
+        JS_FreeValue(ctx, sp[-2]);
+        sp -= 2;
+        if (unlikely(ret < 0))
+          goto exception;
+      }
+      BREAK;
+
+    CASE(OP_get_loc_get_field_ic):
+      {
+        JSValue val;
+        JSAtom atom;
+        JSInlineCache *ic;
+        JSObject *p;
+        atom = get_u32(pc);
+        ic = &b->ic[get_u16(pc + 4)];
+        val = var_buf[get_u16(pc + 6)];
+        pc += 8;
+
+        p = JS_VALUE_GET_OBJ(val);
+        if (likely(JS_VALUE_GET_TAG(val) == JS_TAG_OBJECT &&
+                   p->shape == ic->shape && p->shape->id == ic->shape_id)) {
+          *sp++ = JS_DupValue(ctx, p->prop[ic->prop_idx].u.value);
+        } else {
+          /* the object is kept on the stack as a getter may modify the
+             variable */
+          *sp++ = JS_DupValue(ctx, val);
+          val = js_get_field_ic_miss(ctx, ic, sp[-1], atom);
+          if (unlikely(JS_IsException(val)))
+            goto exception;
+          JS_FreeValue(ctx, sp[-1]);
+          sp[-1] = val;
+        }
+      }
+      BREAK;
+
     CASE(OP_private_symbol):
       {
         JSAtom atom;
@@ -1754,6 +2002,32 @@ JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
         }
       }
       BREAK;
+    CASE(OP_get_arg_get_arg_add):
+      {
+        JSValue op1, op2, tab[2];
+        op1 = arg_buf[get_u16(pc)];
+        op2 = arg_buf[get_u16(pc + 2)];
+        pc += 4;
+        if (likely(JS_VALUE_IS_BOTH_INT(op1, op2))) {
+          int64_t r;
+          r = (int64_t)JS_VALUE_GET_INT(op1) + JS_VALUE_GET_INT(op2);
+          if (unlikely((int)r != r))
+            goto get_arg_add_slow;
+          *sp++ = JS_NewInt32(ctx, r);
+        } else if (JS_VALUE_IS_BOTH_FLOAT(op1, op2)) {
+          *sp++ = __JS_NewFloat64(ctx, JS_VALUE_GET_FLOAT64(op1) +
+                                  JS_VALUE_GET_FLOAT64(op2));
+        } else {
+        get_arg_add_slow:
+          /* only the result is counted in the stack size */
+          tab[0] = JS_DupValue(ctx, op1);
+          tab[1] = JS_DupValue(ctx, op2);
+          if (js_add_slow(ctx, tab + 2))
+            goto exception;
+          *sp++ = tab[0];
+        }
+      }
+      BREAK;
     CASE(OP_add_loc):
       {
         JSValue *pv;
@@ -1770,13 +2044,23 @@ JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
             goto add_loc_slow;
           *pv = JS_NewInt32(ctx, r);
           sp--;
-        } else if (JS_VALUE_GET_TAG(*pv) == JS_TAG_STRING) {
+        } else if (JS_VALUE_GET_TAG(*pv) == JS_TAG_STRING ||
+                   JS_VALUE_GET_TAG(*pv) == JS_TAG_STRING_ROPE) {
           JSValue op1;
+          int res;
           op1 = sp[-1];
           sp--;
           op1 = JS_ToPrimitiveFree(ctx, op1, HINT_NONE);
           if (JS_IsException(op1))
             goto exception;
+          /* the variable is usually the only reference to the string */
+          res = JS_ConcatStringInPlace(ctx, *pv, op1);
+          if (res != 0) {
+            JS_FreeValue(ctx, op1);
+            if (res < 0)
+              goto exception;
+            BREAK;
+          }
           op1 = JS_ConcatString(ctx, JS_DupValue(ctx, *pv), op1);
           if (JS_IsException(op1))
             goto exception;
@@ -2469,10 +2753,17 @@ JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
       JS_FreeValue(ctx, sp[-1]);
       sp[-1] = JS_FALSE;
       BREAK;
+    CASE(OP_debug_trap):
+      {
+        uint32_t pos = pc - 1 - code_buf;
+        sf->cur_pc = pc;
+        js_debug_trap(ctx, b, pos);
+        DISPATCH_OP(b->byte_code_buf[pos]);
+      }
     CASE(OP_invalid):
     DEFAULT:
       JS_ThrowInternalError(ctx, "invalid opcode: pc=%u opcode=0x%02x",
-                  (int)(pc - b->byte_code_buf - 1), opcode);
+                  (int)(pc - code_buf - 1), opcode);
       goto exception;
     }
   }
@@ -2498,7 +2789,7 @@ JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
         } else {
           *sp++ = rt->current_exception;
           rt->current_exception = JS_NULL;
-          pc = b->byte_code_buf + pos;
+          pc = code_buf + pos;
           goto restart;
         }
       }
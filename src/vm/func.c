@@ -1,8 +1,10 @@
 #include "func.h"
 
 #include "class.h"
+#include "debug.h"
 #include "error.h"
 #include "exec.h"
+#include "gc.h"
 #include "intrins/intrins.h"
 #include "iter.h"
 #include "obj.h"
@@ -551,51 +553,137 @@ JSValue js_call_c_function(JSContext *ctx, JSValueConst func_obj,
 
 /* -- Function utils ----------------------------------- */
 
+/* return NULL if the table is malformed or if there is not enough memory:
+   the lookups then scan the table */
+static JSPc2LineIndex *build_pc2line_index(JSRuntime *rt,
+                                           JSFunctionBytecode *b) {
+  JSPc2LineIndex *idx;
+  JSPc2LineCheckpoint *cp;
+  JSPc2LineReader r;
+  int n, ret;
+
+  /* an entry takes at least 2 bytes */
+  idx = js_malloc_rt(rt, sizeof(*idx) + sizeof(idx->tab[0]) *
+                     (b->debug.pc2line_len / (2 * JS_PC2LINE_INDEX_STEP)));
+  if (!idx)
+    return NULL;
+  idx->count = 0;
+  pc2line_reader_init(&r, b);
+  n = 0;
+  while ((ret = pc2line_reader_next(&r)) > 0) {
+    if (++n == JS_PC2LINE_INDEX_STEP) {
+      cp = &idx->tab[idx->count++];
+      cp->pc = r.pc;
+      cp->line = r.line;
+      cp->col = r.col;
+      cp->offset = r.p - b->debug.pc2line_buf;
+      n = 0;
+    }
+  }
+  if (ret < 0) {
+    js_free_rt(rt, idx);
+    return NULL;
+  }
+  return idx;
+}
+
+/* position `r` after the last checkpoint whose pc is <= `pc_value` */
+static void pc2line_reader_seek(JSPc2LineReader *r, JSFunctionBytecode *b,
+                                uint32_t pc_value) {
+  JSPc2LineIndex *idx = b->debug.pc2line_index;
+  JSPc2LineCheckpoint *cp;
+  int lo, hi, mid;
+
+  lo = 0;
+  hi = idx->count;
+  while (lo < hi) {
+    mid = (lo + hi) >> 1;
+    if (idx->tab[mid].pc <= pc_value)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo > 0) {
+    cp = &idx->tab[lo - 1];
+    r->p = b->debug.pc2line_buf + cp->offset;
+    r->pc = cp->pc;
+    r->line = cp->line;
+    r->col = cp->col;
+  }
+}
+
 int find_line_num(JSContext *ctx, JSFunctionBytecode *b, uint32_t pc_value) {
-  const uint8_t *p_end, *p;
-  int new_line_num, line_num, pc, v, ret;
-  unsigned int op;
+  JSPc2LineReader r;
+  int line_num, ret;
 
   if (!b->has_debug || !b->debug.pc2line_buf) {
     /* function was stripped */
     return -1;
   }
 
-  p = b->debug.pc2line_buf;
-  p_end = p + b->debug.pc2line_len;
-  pc = 0;
-  line_num = b->debug.line_num;
-  while (p < p_end) {
-    op = *p++;
-    if (op == 0) {
-      uint32_t val;
-      ret = get_leb128(&val, p, p_end);
-      if (ret < 0)
-        goto fail;
-      pc += val;
-      p += ret;
-      ret = get_sleb128(&v, p, p_end);
-      if (ret < 0) {
-      fail:
-        /* should never happen */
-        return b->debug.line_num;
-      }
-      p += ret;
-      new_line_num = line_num + v;
-    } else {
-      op -= PC2LINE_OP_FIRST;
-      pc += (op / PC2LINE_RANGE);
-      new_line_num = line_num + (op % PC2LINE_RANGE) + PC2LINE_BASE;
-    }
-    if (pc_value < pc)
-      return line_num;
-    line_num = new_line_num;
-    // read `col_num`
-    get_sleb128(&v, p, p_end);
+  pc2line_reader_init(&r, b);
+  if (b->debug.pc2line_len >= JS_PC2LINE_INDEX_MIN_LEN) {
+    if (!b->debug.pc2line_index)
+      b->debug.pc2line_index = build_pc2line_index(ctx->rt, b);
+    if (b->debug.pc2line_index)
+      pc2line_reader_seek(&r, b, pc_value);
+  }
+  line_num = r.line;
+  while ((ret = pc2line_reader_next(&r)) > 0) {
+    if (pc_value < r.pc)
+      break;
+    line_num = r.line;
+  }
+  if (ret < 0) {
+    /* should never happen */
+    return b->debug.line_num;
   }
   return line_num;
 }
 
+void pc2line_reader_init(JSPc2LineReader *r, JSFunctionBytecode *b) {
+  r->p = b->debug.pc2line_buf;
+  r->p_end = r->p + b->debug.pc2line_len;
+  r->pc = 0;
+  r->line = b->debug.line_num;
+  r->col = 0;
+}
+
+int pc2line_reader_next(JSPc2LineReader *r) {
+  unsigned int op;
+  uint32_t val;
+  int32_t v;
+  int ret;
+
+  if (r->p >= r->p_end)
+    return 0;
+
+  op = *r->p++;
+  if (op == 0) {
+    ret = get_leb128(&val, r->p, r->p_end);
+    if (ret < 0)
+      return -1;
+    r->pc += val;
+    r->p += ret;
+    ret = get_sleb128(&v, r->p, r->p_end);
+    if (ret < 0)
+      return -1;
+    r->p += ret;
+    r->line += v;
+  } else {
+    op -= PC2LINE_OP_FIRST;
+    r->pc += (op / PC2LINE_RANGE);
+    r->line += (op % PC2LINE_RANGE) + PC2LINE_BASE;
+  }
+
+  ret = get_sleb128(&v, r->p, r->p_end);
+  if (ret < 0)
+    return -1;
+  r->p += ret;
+  r->col = v;
+  return 1;
+}
+
 /* in order to avoid executing arbitrary code during the stack trace
    generation, we only look at simple 'name' properties containing a
    string. */
@@ -612,7 +700,7 @@ const char *get_func_name(JSContext *ctx, JSValueConst func) {
   if ((prs->flags & JS_PROP_TMASK) != JS_PROP_NORMAL)
     return NULL;
   val = pr->u.value;
-  if (JS_VALUE_GET_TAG(val) != JS_TAG_STRING)
+  if (!JS_IsString(val))
     return NULL;
   return JS_ToCString(ctx, val);
 }
@@ -753,7 +841,7 @@ JSVarRef *get_var_ref(JSContext *ctx, JSStackFrame *sf, int var_idx,
     }
   }
   /* create a new one */
-  var_ref = js_malloc(ctx, sizeof(JSVarRef));
+  var_ref = js_slab_alloc(ctx, sizeof(JSVarRef));
   if (!var_ref)
     return NULL;
   var_ref->header.ref_count = 1;
@@ -918,6 +1006,8 @@ __exception int async_func_init(JSContext *ctx, JSAsyncFunctionState *s,
   b = p->u.func.function_bytecode;
   sf->js_mode = b->js_mode;
   sf->cur_pc = b->byte_code_buf;
+  if (unlikely(ctx->rt->debug))
+    sf->cur_pc = js_debug_code_buf(b->realm, b);
   arg_buf_len = max_int(b->arg_count, argc);
   local_count = arg_buf_len + b->var_count + b->stack_size;
   sf->arg_buf = js_malloc(ctx, sizeof(JSValue) * max_int(local_count, 1));
@@ -1010,6 +1100,8 @@ void js_async_function_free0(JSRuntime *rt, JSAsyncFunctionData *s) {
 void js_async_function_free(JSRuntime *rt, JSAsyncFunctionData *s) {
   if (--s->header.ref_count == 0) {
     js_async_function_free0(rt, s);
+  } else {
+    gc_add_possible_root(rt, &s->header);
   }
 }
 
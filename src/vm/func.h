@@ -87,6 +87,71 @@ typedef enum JSFunctionKindEnum {
   JS_FUNC_ASYNC_GENERATOR = (JS_FUNC_GENERATOR | JS_FUNC_ASYNC),
 } JSFunctionKindEnum;
 
+/* inline cache of `OP_get_field_ic` and `OP_put_field_ic`, records where the
+   property was found in the object of the last miss */
+typedef struct JSInlineCache {
+  JSShape *shape; /* NULL if the cache is empty */
+  uint32_t shape_id;
+  uint32_t prop_idx;
+} JSInlineCache;
+
+#define JS_POLY_IC_SIZE 4
+
+/* entry of the inline cache of `OP_get_field2_ic`. The property is either an
+   own property of the receiver (`holder_shape` is NULL) or a property of its
+   prototype. The prototype is fixed by the shape of the receiver, so the
+   shape of the prototype is the only other thing to check: it is the
+   validity cell of the lookup */
+typedef struct JSPolyInlineCacheEntry {
+  JSShape *shape; /* NULL if the entry is empty */
+  uint32_t shape_id;
+  uint32_t prop_idx;
+  JSShape *holder_shape;
+  uint32_t holder_shape_id;
+} JSPolyInlineCacheEntry;
+
+/* method lookups see several receiver shapes more often than the other
+   property accesses, so they keep up to JS_POLY_IC_SIZE of them */
+typedef struct JSPolyInlineCache {
+  JSPolyInlineCacheEntry entries[JS_POLY_IC_SIZE];
+  uint32_t next; /* entry replaced by the next miss when all are used */
+} JSPolyInlineCache;
+
+/* inline cache of `OP_get_var_ic` and `OP_put_var_ic`. The variable is a
+   property of the global lexical object (`var_shape` is NULL) or of the
+   global object, in which case the lexical object must also be unchanged
+   since a new lexical declaration would shadow the property */
+typedef struct JSGlobalInlineCache {
+  JSShape *shape; /* shape of the holder, NULL if the cache is empty */
+  uint32_t shape_id;
+  uint32_t prop_idx;
+  JSShape *var_shape;
+  uint32_t var_shape_id;
+} JSGlobalInlineCache;
+
+/* maximum number of the inline caches per function, the property accesses
+   beyond this use the uncached instructions */
+#define JS_MAX_INLINE_CACHES 65536
+
+/* source code of a function for Function.prototype.toString(). The
+   functions defined inside it point to the same copy. */
+typedef struct JSFunctionSource {
+  int ref_count;
+  int len;
+  char buf[0]; /* zero terminated */
+} JSFunctionSource;
+
+static inline JSFunctionSource *js_dup_function_source(JSFunctionSource *src) {
+  src->ref_count++;
+  return src;
+}
+
+static inline void js_free_function_source(JSRuntime *rt,
+                                           JSFunctionSource *src) {
+  if (src && --src->ref_count == 0)
+    js_free_rt(rt, src);
+}
+
 typedef struct JSFunctionBytecode {
   JSGCObjectHeader header; /* must come first */
   uint8_t js_mode;
@@ -103,7 +168,9 @@ typedef struct JSFunctionBytecode {
   uint8_t has_debug : 1;
   uint8_t backtrace_barrier : 1; /* stop backtrace on this function */
   uint8_t read_only_bytecode : 1;
-  /* XXX: 4 bits available */
+  /* debug.pc2line_buf is in the input buffer of JS_ReadObject() */
+  uint8_t read_only_pc2line : 1;
+  /* XXX: 3 bits available */
   uint8_t *byte_code_buf; /* (self pointer) */
   int byte_code_len;
   JSAtom func_name;
@@ -122,17 +189,47 @@ typedef struct JSFunctionBytecode {
   JSValue *cpool;             /* constant pool (self pointer) */
   int cpool_count;
   int closure_var_count;
+  /* indexed by the u16 operand of the `*_ic` opcodes, `pic` is used by
+     `OP_get_field2_ic`, `gic` by the global variable accesses and `ic` by
+     the others */
+  JSInlineCache *ic;
+  int ic_count;
+  JSPolyInlineCache *pic;
+  int pic_count;
+  JSGlobalInlineCache *gic;
+  int gic_count;
   struct {
-    /* debug info, move to separate structure to save memory? */
+    /* debug info, only allocated if has_debug is set */
     JSAtom filename;
     int line_num;
     int source_len;
     int pc2line_len;
     uint8_t *pc2line_buf;
-    char *source;
+    const char *source; /* in 'source_buf', not zero terminated */
+    struct JSFunctionSource *source_buf;
+    /* checkpoints in `pc2line_buf`, built by the first lookup */
+    struct JSPc2LineIndex *pc2line_index;
+    /* pc -> breakpoints index, built lazily by the debugger */
+    struct JSDebugBpTable *bp_table;
+    /* copy of `byte_code_buf` whose opcodes at the pc of the breakpoints are
+       replaced by `OP_debug_trap`, executed instead of `byte_code_buf` if
+       `has_trap` is set */
+    uint8_t *trap_buf;
+    uint32_t bp_gen; /* `ctx->debug.bp_gen` when `trap_buf` was patched */
+    BOOL has_trap;
   } debug;
 } JSFunctionBytecode;
 
+/* return the byte code which contains `pc`, it's either `byte_code_buf` or
+   the `trap_buf` of the debugger */
+static inline const uint8_t *js_frame_code_buf(JSFunctionBytecode *b,
+                                               const uint8_t *pc) {
+  if (b->has_debug && b->debug.trap_buf && pc >= b->debug.trap_buf &&
+      pc <= b->debug.trap_buf + b->byte_code_len)
+    return b->debug.trap_buf;
+  return b->byte_code_buf;
+}
+
 typedef struct JSBoundFunction {
   JSValue func_obj;
   JSValue this_val;
@@ -233,6 +330,39 @@ JSValue js_call_c_function(JSContext *ctx, JSValueConst func_obj,
 /* -- Function utils ----------------------------------- */
 
 int find_line_num(JSContext *ctx, JSFunctionBytecode *b, uint32_t pc_value);
+
+/* sequential decoder of the pc2line table, see `compute_pc2line_info` */
+typedef struct JSPc2LineReader {
+  const uint8_t *p;
+  const uint8_t *p_end;
+  int pc;
+  int line;
+  int col;
+} JSPc2LineReader;
+
+/* the decoder state after every JS_PC2LINE_INDEX_STEP entries of the
+   pc2line table so that a lookup only decodes the entries following the
+   last checkpoint before the pc */
+#define JS_PC2LINE_INDEX_STEP 64
+/* smaller tables are scanned from the start */
+#define JS_PC2LINE_INDEX_MIN_LEN 256
+
+typedef struct JSPc2LineCheckpoint {
+  uint32_t pc;
+  int line;
+  int col;
+  uint32_t offset; /* of the next entry in `pc2line_buf` */
+} JSPc2LineCheckpoint;
+
+typedef struct JSPc2LineIndex {
+  int count;
+  JSPc2LineCheckpoint tab[0];
+} JSPc2LineIndex;
+
+void pc2line_reader_init(JSPc2LineReader *r, JSFunctionBytecode *b);
+/* return 1 if an entry is decoded into `r->pc`, `r->line` and `r->col`, 0 at
+   the end of the table and -1 if the table is malformed */
+int pc2line_reader_next(JSPc2LineReader *r);
 const char *get_func_name(JSContext *ctx, JSValueConst func);
 
 /* return NULL without exception if not a function or no bytecode */
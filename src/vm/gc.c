@@ -2,6 +2,7 @@
 
 #include "cfunc.h"
 #include "class.h"
+#include "debug.h"
 #include "def.h"
 #include "func.h"
 #include "include/quickjs.h"
@@ -15,7 +16,10 @@
 #include "obj.h"
 #include "utils/dbuf.h"
 #include "vm/str.h"
+#include <errno.h>
+#include <fcntl.h>
 #include <time.h>
+#include <unistd.h>
 
 /* -- Malloc ----------------------------------- */
 
@@ -107,6 +111,169 @@ size_t js_malloc_usable_size(JSContext *ctx, const void *ptr) {
   return js_malloc_usable_size_rt(ctx->rt, ptr);
 }
 
+/* -- Slab allocator ----------------------------------- */
+
+/* the blocks of a page start after its header, aligned like malloc() */
+#define JS_SLAB_PAGE_HEADER_SIZE 16
+
+/* allocate a new page for the size class of 'size' when its free list
+   is empty. The page is released by js_slab_trim() once all its blocks
+   are free. */
+void *js_slab_alloc_page(JSRuntime *rt, size_t size) {
+  JSSlabPage *page;
+  JSSlabBlock *b, **plist;
+  size_t block_size;
+  uint8_t *ptr, *end;
+
+  page = js_malloc_rt(rt, JS_SLAB_PAGE_SIZE);
+  if (unlikely(!page))
+    return NULL;
+  page->next = rt->slab_page_list;
+  page->size_class = js_slab_class(size);
+  rt->slab_page_list = page;
+  rt->slab_page_count++;
+
+  block_size = (js_slab_class(size) + 1) << JS_SLAB_CLASS_SHIFT;
+  ptr = (uint8_t *)page + JS_SLAB_PAGE_HEADER_SIZE;
+  end = (uint8_t *)page + JS_SLAB_PAGE_SIZE - block_size;
+  /* the first block is returned, the others are queued in address
+     order */
+  plist = &rt->slab_free_list[js_slab_class(size)];
+  b = (JSSlabBlock *)ptr;
+  for (ptr += block_size; ptr <= end; ptr += block_size) {
+    JSSlabBlock *b1 = (JSSlabBlock *)ptr;
+    b1->next = *plist;
+    *plist = b1;
+  }
+  rt->slab_count++;
+  rt->slab_size += block_size;
+  return b;
+}
+
+static int js_slab_page_cmp(const void *a, const void *b, void *opaque) {
+  uintptr_t pa = (uintptr_t)*(JSSlabPage *const *)a;
+  uintptr_t pb = (uintptr_t)*(JSSlabPage *const *)b;
+  return (pa > pb) - (pa < pb);
+}
+
+/* 'pages' is sorted by address */
+static JSSlabPage *js_slab_find_page(JSSlabPage **pages, int64_t n,
+                                     JSSlabBlock *b) {
+  int64_t lo, hi, mid;
+
+  lo = 0;
+  hi = n - 1;
+  while (lo < hi) {
+    mid = (lo + hi + 1) >> 1;
+    if ((uintptr_t)pages[mid] <= (uintptr_t)b)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  return pages[lo];
+}
+
+static BOOL js_slab_page_is_empty(JSSlabPage *page) {
+  size_t block_size = (size_t)(page->size_class + 1) << JS_SLAB_CLASS_SHIFT;
+  return (size_t)page->free_count ==
+         (JS_SLAB_PAGE_SIZE - JS_SLAB_PAGE_HEADER_SIZE) / block_size;
+}
+
+/* Release the pages whose blocks are all free so that the memory of a
+   past allocation peak is not kept by the runtime. The free blocks are
+   counted per page, so it is only done when at least a quarter of the
+   page memory is free. */
+void js_slab_trim(JSRuntime *rt) {
+  JSSlabPage **pages, *page, **ppage;
+  JSSlabBlock *b, **pb;
+  int64_t n, i;
+  int c;
+
+  n = rt->slab_page_count;
+  if (n == 0 || rt->slab_size > n * JS_SLAB_PAGE_SIZE * 3 / 4)
+    return;
+  pages = js_malloc_rt(rt, n * sizeof(pages[0]));
+  if (!pages)
+    return;
+  i = 0;
+  for (page = rt->slab_page_list; page != NULL; page = page->next) {
+    page->free_count = 0;
+    pages[i++] = page;
+  }
+  rqsort(pages, n, sizeof(pages[0]), js_slab_page_cmp, NULL);
+
+  for (c = 0; c < JS_SLAB_CLASS_COUNT; c++) {
+    for (b = rt->slab_free_list[c]; b != NULL; b = b->next)
+      js_slab_find_page(pages, n, b)->free_count++;
+  }
+  for (c = 0; c < JS_SLAB_CLASS_COUNT; c++) {
+    pb = &rt->slab_free_list[c];
+    while ((b = *pb) != NULL) {
+      if (js_slab_page_is_empty(js_slab_find_page(pages, n, b)))
+        *pb = b->next;
+      else
+        pb = &b->next;
+    }
+  }
+  js_free_rt(rt, pages);
+
+  ppage = &rt->slab_page_list;
+  while ((page = *ppage) != NULL) {
+    if (js_slab_page_is_empty(page)) {
+      *ppage = page->next;
+      js_free_rt(rt, page);
+      rt->slab_page_count--;
+    } else {
+      ppage = &page->next;
+    }
+  }
+}
+
+void js_slab_free_pages(JSRuntime *rt) {
+  JSSlabPage *page, *page_next;
+  int i;
+
+  for (page = rt->slab_page_list; page != NULL; page = page_next) {
+    page_next = page->next;
+    js_free_rt(rt, page);
+  }
+  rt->slab_page_list = NULL;
+  rt->slab_page_count = 0;
+  for (i = 0; i < JS_SLAB_CLASS_COUNT; i++)
+    rt->slab_free_list[i] = NULL;
+}
+
+/* Throw out of memory in case of error */
+void *js_slab_alloc(JSContext *ctx, size_t size) {
+  void *ptr;
+  ptr = js_slab_alloc_rt(ctx->rt, size);
+  if (unlikely(!ptr)) {
+    JS_ThrowOutOfMemory(ctx);
+    return NULL;
+  }
+  return ptr;
+}
+
+/* Throw out of memory in case of error. 'ptr' is left unchanged if the
+   allocation fails */
+void *js_slab_realloc(JSContext *ctx, void *ptr, size_t old_size,
+                      size_t new_size) {
+  JSRuntime *rt = ctx->rt;
+  void *new_ptr;
+
+  if (!js_slab_has_size(rt, old_size) && !js_slab_has_size(rt, new_size))
+    return js_realloc(ctx, ptr, new_size);
+  if (js_slab_has_size(rt, old_size) && js_slab_has_size(rt, new_size) &&
+      js_slab_class(old_size) == js_slab_class(new_size))
+    return ptr;
+  new_ptr = js_slab_alloc(ctx, new_size);
+  if (unlikely(!new_ptr))
+    return NULL;
+  memcpy(new_ptr, ptr, min_uint32(old_size, new_size));
+  js_slab_free_rt(rt, ptr, old_size);
+  return new_ptr;
+}
+
 /* Throw out of memory exception in case of error */
 char *js_strndup(JSContext *ctx, const char *s, size_t n) {
   char *ptr;
@@ -153,7 +320,9 @@ void free_var_ref(JSRuntime *rt, JSVarRef *var_ref) {
       } else {
         list_del(&var_ref->header.link); /* still on the stack */
       }
-      js_free_rt(rt, var_ref);
+      js_slab_free_rt(rt, var_ref, sizeof(JSVarRef));
+    } else if (var_ref->is_detached) {
+      gc_add_possible_root(rt, &var_ref->header);
     }
   }
 }
@@ -352,15 +521,38 @@ static void JS_MarkContext(JSRuntime *rt, JSContext *ctx,
 
 /* -- Garbage collection ----------------------------------- */
 
+/* number of automatic GCs from the possible roots between two full GCs */
+#define JS_GC_ROOT_RUN_MAX 8
+/* number of subgraph objects visited between two checks of the pause
+   budget */
+#define JS_GC_SLICE_OBJ_COUNT 256
+
 void add_gc_object(JSRuntime *rt, JSGCObjectHeader *h,
                    JSGCObjectTypeEnum type) {
   h->mark = 0;
+  h->root_buffered = 0;
   h->gc_obj_type = type;
   list_add_tail(&h->link, &rt->gc_obj_list);
 }
 
 void remove_gc_object(JSGCObjectHeader *h) { list_del(&h->link); }
 
+/* Move 'h' to the possible roots at the head of gc_obj_list. Only a GC
+   object whose reference count was decremented to a non zero value can
+   become the last externally referenced member of a garbage cycle, so
+   the cycle collection starts from these objects. The contexts are
+   never recorded because they are only freed by JS_FreeContext(). */
+void gc_add_possible_root(JSRuntime *rt, JSGCObjectHeader *h) {
+  /* the objects being freed by gc_free_cycles() have mark = 1 and must
+     stay in tmp_obj_list */
+  if (h->root_buffered ||
+      (rt->gc_phase == JS_GC_PHASE_REMOVE_CYCLES && h->mark != 0))
+    return;
+  h->root_buffered = 1;
+  list_del(&h->link);
+  list_add(&h->link, &rt->gc_obj_list);
+}
+
 void JS_MarkValue(JSRuntime *rt, JSValueConst val, JS_MarkFunc *mark_func) {
   if (JS_VALUE_HAS_REF_COUNT(val)) {
     switch (JS_VALUE_GET_TAG(val)) {
@@ -481,6 +673,7 @@ void gc_decref(JSRuntime *rt) {
     assert(p->mark == 0);
     mark_children(rt, p, gc_decref_child);
     p->mark = 1;
+    p->root_buffered = 0;
     if (p->ref_count == 0) {
       list_del(&p->link);
       list_add_tail(&p->link, &rt->tmp_obj_list);
@@ -564,10 +757,14 @@ static void gc_free_cycles(JSRuntime *rt) {
     p = list_entry(el, JSGCObjectHeader, link);
     assert(p->gc_obj_type == JS_GC_OBJ_TYPE_JS_OBJECT ||
            p->gc_obj_type == JS_GC_OBJ_TYPE_FUNCTION_BYTECODE);
-    js_free_rt(rt, p);
+    if (p->gc_obj_type == JS_GC_OBJ_TYPE_JS_OBJECT)
+      js_slab_free_rt(rt, p, sizeof(JSObject));
+    else
+      js_free_rt(rt, p);
   }
 
   init_list_head(&rt->gc_zero_ref_count_list);
+  js_slab_trim(rt);
 }
 
 void JS_RunGC(JSRuntime *rt) {
@@ -580,6 +777,227 @@ void JS_RunGC(JSRuntime *rt) {
 
   /* free the GC objects in a cycle */
   gc_free_cycles(rt);
+
+  rt->gc_root_run_count = 0;
+  rt->gc_slice_pending = FALSE;
+}
+
+/* The trial deletion is restricted to the subgraph reachable from the
+   possible roots. mark = 0 for the objects outside the subgraph, 1 for
+   the subgraph objects not known to be alive, 2 for the alive ones and
+   3 for the objects directly referenced by a context. The contexts and
+   the objects with mark = 3 (global object, prototypes, ...) are not
+   entered: they are alive as long as the context is, so their
+   references count as external ones. Otherwise most possible roots
+   would reach the whole heap through them. */
+
+static void gc_pin_child(JSRuntime *rt, JSGCObjectHeader *p) { p->mark = 3; }
+
+static void gc_unpin_child(JSRuntime *rt, JSGCObjectHeader *p) { p->mark = 0; }
+
+static void gc_mark_contexts(JSRuntime *rt, JS_MarkFunc *mark_func) {
+  struct list_head *el;
+  JSContext *ctx;
+
+  list_for_each(el, &rt->context_list) {
+    ctx = list_entry(el, JSContext, link);
+    JS_MarkContext(rt, ctx, mark_func);
+  }
+}
+
+static void gc_decref_root_child(JSRuntime *rt, JSGCObjectHeader *p) {
+  if (p->gc_obj_type == JS_GC_OBJ_TYPE_JS_CONTEXT || p->mark == 3)
+    return;
+  assert(p->ref_count > 0);
+  p->ref_count--;
+  if (p->mark == 0) {
+    /* enter the subgraph, its children are visited by gc_decref_roots() */
+    p->mark = 1;
+    p->root_buffered = 0;
+    list_del(&p->link);
+    list_add_tail(&p->link, &rt->tmp_obj_list);
+  }
+}
+
+static int64_t gc_get_time_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static BOOL gc_has_possible_roots(JSRuntime *rt) {
+  struct list_head *el = rt->gc_obj_list.next;
+  return el != &rt->gc_obj_list &&
+         list_entry(el, JSGCObjectHeader, link)->root_buffered;
+}
+
+/* stop the trial deletion at 'deadline' (in microseconds, 0 if no
+   limit). The roots left keep root_buffered for the next slice. The
+   subgraph of the first root is always finished so that each slice
+   makes progress. The one of another root can be cut: the objects whose
+   children are not visited yet are moved to 'frontier'. */
+static void gc_decref_roots(JSRuntime *rt, int64_t deadline,
+                            struct list_head *frontier) {
+  struct list_head *el, *el1;
+  JSGCObjectHeader *p;
+  int count = 0;
+  BOOL root_done = FALSE, stop = FALSE;
+
+  init_list_head(&rt->tmp_obj_list);
+  init_list_head(frontier);
+  gc_mark_contexts(rt, gc_pin_child);
+
+  /* the possible roots are at the head of gc_obj_list. Each of them is
+     moved to tmp_obj_list with the children it reaches which are
+     handled while the root is still in the cache. */
+  el1 = &rt->tmp_obj_list;
+  while (!stop) {
+    el = rt->gc_obj_list.next;
+    if (el == &rt->gc_obj_list)
+      break;
+    p = list_entry(el, JSGCObjectHeader, link);
+    if (!p->root_buffered)
+      break;
+    p->root_buffered = 0;
+    list_del(&p->link);
+    if (p->mark == 3) {
+      list_add_tail(&p->link, &rt->gc_obj_list);
+      continue;
+    }
+    p->mark = 1;
+    list_add_tail(&p->link, &rt->tmp_obj_list);
+    /* decrement the refcount of the children of the subgraph objects
+       not handled yet, the list grows while new children are reached */
+    while (el1->next != &rt->tmp_obj_list) {
+      el1 = el1->next;
+      p = list_entry(el1, JSGCObjectHeader, link);
+      mark_children(rt, p, gc_decref_root_child);
+      if (deadline != 0 && ++count == JS_GC_SLICE_OBJ_COUNT) {
+        count = 0;
+        if (gc_get_time_us() >= deadline) {
+          if (root_done) {
+            while (el1->next != &rt->tmp_obj_list) {
+              p = list_entry(el1->next, JSGCObjectHeader, link);
+              list_del(&p->link);
+              list_add_tail(&p->link, frontier);
+            }
+            return;
+          }
+          stop = TRUE;
+        }
+      }
+    }
+    root_done = TRUE;
+  }
+}
+
+static void gc_scan_root_child(JSRuntime *rt, JSGCObjectHeader *p) {
+  if (p->mark == 0 || p->mark == 3)
+    return;
+  p->ref_count++;
+  if (p->mark == 1) {
+    p->mark = 2;
+    list_del(&p->link);
+    list_add_tail(&p->link, &rt->gc_obj_list);
+  }
+}
+
+static void gc_scan_root_child2(JSRuntime *rt, JSGCObjectHeader *p) {
+  if (p->mark == 1 || p->mark == 2)
+    p->ref_count++;
+}
+
+static void gc_scan_roots(JSRuntime *rt, struct list_head *frontier) {
+  struct list_head *el, *el1, *alive_start;
+  JSGCObjectHeader *p;
+
+  /* the frontier objects are kept alive without entering them: with
+     mark = 2, the subgraph objects give back the references to them
+     they took */
+  list_for_each(el, frontier) {
+    p = list_entry(el, JSGCObjectHeader, link);
+    p->mark = 2;
+  }
+
+  /* the subgraph objects referenced from outside are alive. They are
+     moved at the end of gc_obj_list after 'alive_start' */
+  alive_start = rt->gc_obj_list.prev;
+  list_for_each_safe(el, el1, &rt->tmp_obj_list) {
+    p = list_entry(el, JSGCObjectHeader, link);
+    if (p->ref_count > 0) {
+      p->mark = 2;
+      list_del(&p->link);
+      list_add_tail(&p->link, &rt->gc_obj_list);
+    }
+  }
+
+  /* so are their children */
+  for (el = alive_start->next; el != &rt->gc_obj_list; el = el->next) {
+    p = list_entry(el, JSGCObjectHeader, link);
+    mark_children(rt, p, gc_scan_root_child);
+  }
+
+  /* restore the refcount of the objects to be deleted. Their children
+     can be alive objects, so it must be done before resetting the
+     marks. */
+  list_for_each(el, &rt->tmp_obj_list) {
+    p = list_entry(el, JSGCObjectHeader, link);
+    mark_children(rt, p, gc_scan_root_child2);
+  }
+
+  for (el = alive_start->next; el != &rt->gc_obj_list; el = el->next) {
+    p = list_entry(el, JSGCObjectHeader, link);
+    p->mark = 0;
+  }
+  gc_mark_contexts(rt, gc_unpin_child);
+
+  /* the next slice goes on from the frontier */
+  list_for_each_safe(el, el1, frontier) {
+    p = list_entry(el, JSGCObjectHeader, link);
+    p->mark = 0;
+    gc_add_possible_root(rt, p);
+  }
+}
+
+/* Collect the garbage cycles going through the possible roots. The
+   work is proportional to the size of the subgraph reachable from them
+   instead of the size of the heap. With a pause budget, only the roots
+   which can be handled in the budget are taken: each slice is a complete
+   trial deletion, so the mutator can run between two slices. Return
+   TRUE if possible roots are left. */
+static BOOL gc_run_roots(JSRuntime *rt) {
+  struct list_head frontier;
+  int64_t deadline = 0;
+
+  if (rt->gc_pause_budget > 0) {
+    /* the scan and the free are not interrupted. They only go through
+       the part of the subgraph visited by gc_decref_roots() and take
+       about as long as it, so it gets half of the budget. The budget is
+       exceeded when the subgraph of the first root is larger. */
+    deadline = gc_get_time_us() + rt->gc_pause_budget / 2;
+  }
+  gc_decref_roots(rt, deadline, &frontier);
+  gc_scan_roots(rt, &frontier);
+  gc_free_cycles(rt);
+  return deadline != 0 && gc_has_possible_roots(rt);
+}
+
+static void gc_update_threshold(JSRuntime *rt) {
+  rt->malloc_gc_threshold =
+      rt->malloc_state.malloc_size + (rt->malloc_state.malloc_size >> 1);
+}
+
+/* Run a slice of the cycle collection started by the automatic GC when a
+   pause budget is set. Can be called when the event loop is idle. Return
+   TRUE if the collection is not finished. */
+BOOL JS_RunGCSlice(JSRuntime *rt) {
+  if (!rt->gc_slice_pending)
+    return FALSE;
+  if (gc_run_roots(rt))
+    return TRUE;
+  rt->gc_slice_pending = FALSE;
+  gc_update_threshold(rt);
+  return FALSE;
 }
 
 void js_trigger_gc(JSRuntime *rt, size_t size) {
@@ -593,9 +1011,23 @@ void js_trigger_gc(JSRuntime *rt, size_t size) {
 #ifdef DUMP_GC
     printf("GC: size=%" PRIu64 "\n", (uint64_t)rt->malloc_state.malloc_size);
 #endif
-    JS_RunGC(rt);
-    rt->malloc_gc_threshold =
-        rt->malloc_state.malloc_size + (rt->malloc_state.malloc_size >> 1);
+    if (rt->gc_pause_budget > 0) {
+      /* the full GC cannot be split, it is left to JS_RunGC() */
+      rt->gc_slice_pending = TRUE;
+      if (JS_RunGCSlice(rt)) {
+        /* next slice after a small allocation step */
+        rt->malloc_gc_threshold =
+            rt->malloc_state.malloc_size + (rt->malloc_state.malloc_size >> 4);
+      }
+      return;
+    }
+    /* a full GC is still run periodically to collect the cycles going
+       through a context */
+    if (++rt->gc_root_run_count >= JS_GC_ROOT_RUN_MAX)
+      JS_RunGC(rt);
+    else
+      gc_run_roots(rt);
+    gc_update_threshold(rt);
   }
 }
 
@@ -608,6 +1040,12 @@ void JS_SetGCThreshold(JSRuntime *rt, size_t gc_threshold) {
   rt->malloc_gc_threshold = gc_threshold;
 }
 
+/* bound the pause of each slice of the automatic cycle collection to
+   about 'budget_us' microseconds, 0 means no limit */
+void JS_SetGCPauseBudget(JSRuntime *rt, int budget_us) {
+  rt->gc_pause_budget = max_int(budget_us, 0);
+}
+
 #define malloc(s) malloc_is_forbidden(s)
 #define free(p) free_is_forbidden(p)
 #define realloc(p, s) realloc_is_forbidden(p, s)
@@ -615,32 +1053,42 @@ void JS_SetGCThreshold(JSRuntime *rt, size_t gc_threshold) {
 /* -- Free ----------------------------------- */
 
 static void reset_weak_ref(JSRuntime *rt, JSObject *p) {
-  JSMapRecord *mr, *mr_next;
+  JSMapRecord **pmr, *mr, *mr_next, *first_weak_ref;
 #ifndef NDEBUG
   JSMapState *s;
 #endif
 
-  /* first pass to remove the records from the WeakMap/WeakSet
-     lists */
-  for (mr = p->first_weak_ref; mr != NULL; mr = mr->next_weak_ref) {
+  /* first pass to remove the records from the weak reference hash
+     table and from the WeakMap/WeakSet lists */
+  first_weak_ref = NULL;
+  pmr = &rt->weak_ref_hash[js_weak_ref_hash(rt, p)];
+  while ((mr = *pmr) != NULL) {
+    if (JS_VALUE_GET_OBJ(mr->key) != p) {
+      pmr = &mr->next_weak_ref;
+      continue;
+    }
 #ifndef NDEBUG
     s = mr->map;
 #endif
     assert(s->is_weak);
     assert(!mr->empty); /* no iterator on WeakMap/WeakSet */
+    *pmr = mr->next_weak_ref;
+    rt->weak_ref_count--;
     list_del(&mr->hash_link);
     list_del(&mr->link);
+    mr->next_weak_ref = first_weak_ref;
+    first_weak_ref = mr;
   }
 
   /* second pass to free the values to avoid modifying the weak
-     reference list while traversing it. */
-  for (mr = p->first_weak_ref; mr != NULL; mr = mr_next) {
+     reference hash table while traversing it. */
+  for (mr = first_weak_ref; mr != NULL; mr = mr_next) {
     mr_next = mr->next_weak_ref;
     JS_FreeValueRT(rt, mr->value);
     js_free_rt(rt, mr);
   }
 
-  p->first_weak_ref = NULL; /* fail safe */
+  p->header.has_weak_ref = 0;
 }
 
 void free_bytecode_atoms(JSRuntime *rt, const uint8_t *bc_buf, int bc_len,
@@ -664,6 +1112,7 @@ void free_bytecode_atoms(JSRuntime *rt, const uint8_t *bc_buf, int bc_len,
     case OP_FMT_atom_u16:
     case OP_FMT_atom_label_u8:
     case OP_FMT_atom_label_u16:
+    case OP_FMT_atom_u16_loc:
       atom = get_u32(bc_buf + pos + 1);
       JS_FreeAtomRT(rt, atom);
       break;
@@ -698,7 +1147,7 @@ static void free_object(JSRuntime *rt, JSObject *p) {
   p->shape = NULL;
   p->prop = NULL;
 
-  if (unlikely(p->first_weak_ref)) {
+  if (unlikely(p->header.has_weak_ref)) {
     reset_weak_ref(rt, p);
   }
 
@@ -716,7 +1165,7 @@ static void free_object(JSRuntime *rt, JSObject *p) {
   if (rt->gc_phase == JS_GC_PHASE_REMOVE_CYCLES && p->header.ref_count != 0) {
     list_add_tail(&p->header.link, &rt->gc_zero_ref_count_list);
   } else {
-    js_free_rt(rt, p);
+    js_slab_free_rt(rt, p, sizeof(JSObject));
   }
 }
 
@@ -731,6 +1180,9 @@ static void free_function_bytecode(JSRuntime *rt, JSFunctionBytecode *b) {
     }
 #endif
   free_bytecode_atoms(rt, b->byte_code_buf, b->byte_code_len, TRUE);
+  js_free_rt(rt, b->ic);
+  js_free_rt(rt, b->pic);
+  js_free_rt(rt, b->gic);
 
   if (b->vardefs) {
     for (i = 0; i < b->arg_count + b->var_count; i++) {
@@ -750,8 +1202,11 @@ static void free_function_bytecode(JSRuntime *rt, JSFunctionBytecode *b) {
   JS_FreeAtomRT(rt, b->func_name);
   if (b->has_debug) {
     JS_FreeAtomRT(rt, b->debug.filename);
-    js_free_rt(rt, b->debug.pc2line_buf);
-    js_free_rt(rt, b->debug.source);
+    if (!b->read_only_pc2line)
+      js_free_rt(rt, b->debug.pc2line_buf);
+    js_free_rt(rt, b->debug.pc2line_index);
+    js_free_function_source(rt, b->debug.source_buf);
+    js_debug_free_function_bytecode(rt, b);
   }
 
   remove_gc_object(&b->header);
@@ -791,10 +1246,19 @@ static void free_zero_refcount(JSRuntime *rt) {
   rt->gc_phase = JS_GC_PHASE_NONE;
 }
 
-/* called with the ref_count of 'v' reaches zero. */
+/* called with the ref_count of 'v' reaches zero or when it is
+   decremented for a GC object. */
 void __JS_FreeValueRT(JSRuntime *rt, JSValue v) {
   uint32_t tag = JS_VALUE_GET_TAG(v);
 
+  if (JS_VALUE_IS_GC_OBJECT(v)) {
+    JSGCObjectHeader *p = JS_VALUE_GET_PTR(v);
+    if (p->ref_count > 0) {
+      gc_add_possible_root(rt, p);
+      return;
+    }
+  }
+
 #ifdef DUMP_FREE
   {
     printf("Freeing ");
@@ -816,9 +1280,12 @@ void __JS_FreeValueRT(JSRuntime *rt, JSValue v) {
 #ifdef DUMP_LEAKS
       list_del(&p->link);
 #endif
-      js_free_rt(rt, p);
+      js_free_string_struct(rt, p);
     }
   } break;
+  case JS_TAG_STRING_ROPE:
+    js_free_rope(rt, JS_VALUE_GET_PTR(v));
+    break;
   case JS_TAG_OBJECT:
   case JS_TAG_FUNCTION_BYTECODE: {
     JSGCObjectHeader *p = JS_VALUE_GET_PTR(v);
@@ -920,15 +1387,22 @@ static void compute_bytecode_size(JSFunctionBytecode *b,
   }
   if (b->has_debug) {
     js_func_size += sizeof(*b) - offsetof(JSFunctionBytecode, debug);
-    if (b->debug.source) {
+    /* a shared source is counted by the function which owns it */
+    if (b->debug.source && b->debug.source == b->debug.source_buf->buf) {
       memory_used_count++;
-      js_func_size += b->debug.source_len + 1;
+      js_func_size += sizeof(JSFunctionSource) + b->debug.source_len + 1;
     }
-    if (b->debug.pc2line_len) {
+    if (b->debug.pc2line_len && !b->read_only_pc2line) {
       memory_used_count++;
       hp->js_func_pc2line_count += 1;
       hp->js_func_pc2line_size += b->debug.pc2line_len;
     }
+    if (b->debug.pc2line_index) {
+      memory_used_count++;
+      hp->js_func_pc2line_size +=
+          sizeof(JSPc2LineIndex) +
+          b->debug.pc2line_index->count * sizeof(JSPc2LineCheckpoint);
+    }
   }
   hp->js_func_size += js_func_size;
   hp->js_func_count += 1;
@@ -940,6 +1414,13 @@ static void compute_value_size(JSValueConst val, JSMemoryUsage_helper *hp) {
   case JS_TAG_STRING:
     compute_jsstring_size(JS_VALUE_GET_STRING(val), hp);
     break;
+  case JS_TAG_STRING_ROPE: {
+    /* the children are not counted */
+    JSStringRope *r = JS_VALUE_GET_PTR(val);
+    double s_ref_count = r->header.ref_count;
+    hp->str_count += 1 / s_ref_count;
+    hp->str_size += sizeof(*r) / s_ref_count;
+  } break;
 #ifdef CONFIG_BIGNUM
   case JS_TAG_BIG_INT:
   case JS_TAG_BIG_FLOAT:
@@ -959,6 +1440,10 @@ void JS_ComputeMemoryUsage(JSRuntime *rt, JSMemoryUsage *s) {
   s->malloc_count = rt->malloc_state.malloc_count;
   s->malloc_size = rt->malloc_state.malloc_size;
   s->malloc_limit = rt->malloc_state.malloc_limit;
+  s->slab_count = rt->slab_count;
+  s->slab_size = rt->slab_size;
+  s->slab_page_count = rt->slab_page_count;
+  s->slab_page_size = rt->slab_page_count * JS_SLAB_PAGE_SIZE;
 
   s->memory_used_count = 2; /* rt + rt->class_array */
   s->memory_used_size = sizeof(JSRuntime) + sizeof(JSValue) * rt->class_count;
@@ -1373,6 +1858,14 @@ void JS_DumpMemoryUsage(FILE *fp, const JSMemoryUsage *s, JSRuntime *rt) {
     fprintf(fp, "%-20s %8" PRId64 " %8" PRId64 "\n", "binary objects",
             s->binary_object_count, s->binary_object_size);
   }
+  if (s->slab_page_count) {
+    fprintf(fp, "%-20s %8" PRId64 " %8" PRId64 "  (%0.1f per block)\n",
+            "slab blocks", s->slab_count, s->slab_size,
+            s->slab_count ? (double)s->slab_size / s->slab_count : 0.0);
+    fprintf(fp, "%-20s %8" PRId64 " %8" PRId64 "  (%0.1f%% used)\n",
+            "  slab pages", s->slab_page_count, s->slab_page_size,
+            100.0 * s->slab_size / s->slab_page_size);
+  }
 }
 
 /* -- GC dump ----------------------------------- */
@@ -1455,11 +1948,9 @@ static void JS_Context_gcdump(JSRuntime *rt, JSContext *ctx,
   const char *cstr = "native_error_proto";
   edge.name_or_idx = js_gcdump_add_cstr(dctx.dc, cstr, strlen(cstr));
   edge.type = JSGCDumpEdge_TYPE_INTERNAL;
-  edge.to = node_i * NODE_FIELD_COUNT;
+  edge.to = node_i;
 
-  node = kid_array_el(&dctx.dc->nodes, JSGCDumpNode, dctx.parent);
-  kid_array_push(&node->edges, &edge);
-  dctx.dc->edges_len++;
+  js_gcdump_add_edge(dctx.dc, dctx.parent, &edge);
 
   JS_GCDumpFuncContext dctx1 = dctx;
   dctx1.parent = node_i;
@@ -1479,11 +1970,9 @@ static void JS_Context_gcdump(JSRuntime *rt, JSContext *ctx,
   cstr = "class_proto";
   edge.name_or_idx = js_gcdump_add_cstr(dctx.dc, cstr, strlen(cstr));
   edge.type = JSGCDumpEdge_TYPE_INTERNAL;
-  edge.to = node_i * NODE_FIELD_COUNT;
+  edge.to = node_i;
 
-  node = kid_array_el(&dctx.dc->nodes, JSGCDumpNode, dctx.parent);
-  kid_array_push(&node->edges, &edge);
-  dctx.dc->edges_len++;
+  js_gcdump_add_edge(dctx.dc, dctx.parent, &edge);
 
   dctx1 = dctx;
   dctx1.parent = node_i;
@@ -1630,7 +2119,9 @@ static void gcdump_children(JSRuntime *rt, JSGCObjectHeader *gp,
 }
 
 JSGCDumpContext *js_gcdump_new_ctx(JSContext *ctx) {
-  JSGCDumpContext *dc = js_mallocz_rt(ctx->rt, sizeof(*ctx));
+  JSGCDumpContext *dc = js_mallocz_rt(ctx->rt, sizeof(*dc));
+  if (!dc)
+    return NULL;
   dc->jc = ctx;
 
   dc->kid_allocator.opaque = ctx->rt;
@@ -1639,15 +2130,27 @@ JSGCDumpContext *js_gcdump_new_ctx(JSContext *ctx) {
   dc->kid_allocator.realloc = (KidReallocFunc *)&js_realloc_rt;
   kid_set_allocator(&dc->kid_allocator);
 
-  kid_array_init(&dc->nodes, sizeof(JSGCDumpNode), 0);
+  kid_array_init(&dc->nodes, sizeof(JSGCDumpNode), 1024);
+  kid_array_init(&dc->edges, sizeof(JSGCDumpEdge), 1024);
 
   kid_array_init(&dc->strs, sizeof(KidString), 0);
-  kid_hashmap_init(&dc->str2id, kid_hashmap_key_shallow_copy,
-                   kid_hashmap_key_shallow_free, NULL);
+  if (kid_hashmap_init(&dc->str2id, kid_hashmap_key_shallow_copy,
+                       kid_hashmap_key_shallow_free, NULL))
+    goto fail;
 
-  kid_hashmap_init(&dc->obj2node, kid_hashmap_key_copy, kid_hashmap_key_free,
-                   NULL);
+  if (kid_hashmap_init(&dc->obj2node, kid_hashmap_key_copy,
+                       kid_hashmap_key_free, NULL)) {
+    kid_hashmap_free(&dc->str2id);
+    goto fail;
+  }
   return dc;
+fail:
+  kid_array_free(&dc->nodes);
+  kid_array_free(&dc->edges);
+  kid_array_free(&dc->strs);
+  kid_set_allocator(NULL);
+  js_free_rt(ctx->rt, dc);
+  return NULL;
 }
 
 #define cast_void_ptr_int(ptr)                                                 \
@@ -1673,22 +2176,36 @@ int js_gcdump_node_from_gp(JSGCDumpContext *dc, void *gp) {
   if (e)
     return cast_void_ptr_int(e->value);
 
-  JSGCDumpNode item = {dc->nodes.len, 0, JSGCDumpNode_TYPE_HIDDEN, 0,
-                       (KidArray){0}};
+  JSGCDumpNode item = {dc->nodes.len, -2, JSGCDumpNode_TYPE_HIDDEN, 0, 0, -1,
+                       -1};
   int i = kid_array_push(&dc->nodes, &item);
   if (i < 0)
     return -1;
 
-  JSGCDumpNode *node = kid_array_el(&dc->nodes, JSGCDumpNode, i);
-  node->name = -2;
-  kid_array_init(&node->edges, sizeof(JSGCDumpEdge), 0);
-
   kid_hashmap_set(&dc->obj2node, &key, NULL, false);
   e = kid_hashmap_get(&dc->obj2node, &key);
   e->value = cast_int_void_ptr(i);
   return i;
 }
 
+/* append `edge` to the edges of the node `from` */
+void js_gcdump_add_edge(JSGCDumpContext *dc, int from, JSGCDumpEdge *edge) {
+  JSGCDumpNode *node;
+  int i;
+
+  edge->next = -1;
+  i = kid_array_push(&dc->edges, edge);
+  if (i < 0)
+    return;
+  node = kid_array_el(&dc->nodes, JSGCDumpNode, from);
+  if (node->last_edge < 0)
+    node->first_edge = i;
+  else
+    kid_array_el(&dc->edges, JSGCDumpEdge, node->last_edge)->next = i;
+  node->last_edge = i;
+  node->edge_count++;
+}
+
 int js_gcdump_add_cstr(JSGCDumpContext *dc, const char *cstr, size_t len) {
   KidHashkey key;
   key.opaque = (void *)cstr;
@@ -1736,7 +2253,7 @@ int js_gcdump_get_node_name(JSGCDumpContext *dc, JSObject *objp) {
   JSPropertyDescriptor desc;
   int res, name = -1;
   res = JS_GetOwnPropertyInternal(dc->jc, &desc, objp, JS_ATOM_name);
-  if (res > 0 && JS_IsString(desc.value)) {
+  if (res > 0 && JS_VALUE_GET_TAG(desc.value) == JS_TAG_STRING) {
     JSAtom atom = JS_NewAtomStr(dc->jc, JS_VALUE_GET_PTR(desc.value));
     if (atom != JS_ATOM_NULL) {
       name = js_gcdump_add_atom(dc, atom);
@@ -1825,9 +2342,8 @@ void js_gcdump_process_obj(JSRuntime *rt, void *cell,
         if (proto_i >= 0) {
           edge.name_or_idx = js_gcdump_add_atom(dc, JS_ATOM___proto__);
           edge.type = JSGCDumpEdge_TYPE_PROP;
-          edge.to = proto_i * NODE_FIELD_COUNT;
-          kid_array_push(&node->edges, &edge);
-          dc->edges_len++;
+          edge.to = proto_i;
+          js_gcdump_add_edge(dc, node_i, &edge);
         }
 
         // shape
@@ -1838,9 +2354,8 @@ void js_gcdump_process_obj(JSRuntime *rt, void *cell,
           edge.name_or_idx = js_gcdump_add_atom(dc, JS_ATOM_shape);
           // display this prop as internal which reflects in gray color
           edge.type = JSGCDumpEdge_TYPE_INTERNAL;
-          edge.to = shape_i * NODE_FIELD_COUNT;
-          kid_array_push(&node->edges, &edge);
-          dc->edges_len++;
+          edge.to = shape_i;
+          js_gcdump_add_edge(dc, node_i, &edge);
         }
 
         // container of arraybuffer
@@ -1850,11 +2365,10 @@ void js_gcdump_process_obj(JSRuntime *rt, void *cell,
 
           const char *cstr = "typed_array";
           edge.name_or_idx = js_gcdump_add_cstr(dc, cstr, strlen(cstr));
-          edge.to = ta_i * NODE_FIELD_COUNT;
+          edge.to = ta_i;
 
           node = kid_array_el(&dc->nodes, JSGCDumpNode, node_i);
-          kid_array_push(&node->edges, &edge);
-          dc->edges_len++;
+          js_gcdump_add_edge(dc, node_i, &edge);
         }
 
         // if obj is function also traverse its bytecode
@@ -1877,9 +2391,8 @@ void js_gcdump_process_obj(JSRuntime *rt, void *cell,
             edge.name_or_idx = js_gcdump_add_atom(dc, JS_ATOM_code);
             // display this prop as internal which reflects in gray color
             edge.type = JSGCDumpEdge_TYPE_INTERNAL;
-            edge.to = bytecode_i * NODE_FIELD_COUNT;
-            kid_array_push(&node->edges, &edge);
-            dc->edges_len++;
+            edge.to = bytecode_i;
+            js_gcdump_add_edge(dc, node_i, &edge);
           }
         }
 
@@ -1901,10 +2414,9 @@ void js_gcdump_process_obj(JSRuntime *rt, void *cell,
 
               edge.name_or_idx = i;
               edge.type = JSGCDumpEdge_TYPE_ELEM;
-              edge.to = el_i * NODE_FIELD_COUNT;
+              edge.to = el_i;
 
-              kid_array_push(&node->edges, &edge);
-              dc->edges_len++;
+              js_gcdump_add_edge(dc, node_i, &edge);
 
               JS_FreeValue(dc->jc, el);
             }
@@ -1950,9 +2462,8 @@ void js_gcdump_process_obj(JSRuntime *rt, void *cell,
             JSGCDumpEdge edge;
             edge.name_or_idx = i;
             edge.type = JSGCDumpEdge_TYPE_ELEM;
-            edge.to = prs_node_i * NODE_FIELD_COUNT;
-            kid_array_push(&node->edges, &edge);
-            dc->edges_len++;
+            edge.to = prs_node_i;
+            js_gcdump_add_edge(dc, node_i, &edge);
           }
         }
       }
@@ -1965,8 +2476,6 @@ void js_gcdump_process_obj(JSRuntime *rt, void *cell,
 
   // create edge to connect node to its parent
   if (dctx.parent >= 0 && node_i != 0 && (dctx.plen || dctx.prs)) {
-    JSGCDumpNode *pn = kid_array_el(&dc->nodes, JSGCDumpNode, dctx.parent);
-
     if (dctx.plen) {
       if (dctx.plen > 0) {
         edge.name_or_idx = js_gcdump_add_cstr(dc, dctx.p.n, dctx.plen);
@@ -1985,68 +2494,139 @@ void js_gcdump_process_obj(JSRuntime *rt, void *cell,
       }
     }
 
-    edge.to = node_i * NODE_FIELD_COUNT;
-    kid_array_push(&pn->edges, &edge);
-    dc->edges_len++;
+    edge.to = node_i;
+    js_gcdump_add_edge(dc, dctx.parent, &edge);
   }
 }
 
-void js_gcdump_write_nodes(FILE *fp, JSGCDumpContext *dc) {
-  DynBuf dbuf;
-  js_dbuf_init(dc->jc, &dbuf);
-
-  for (int i = 0, len = dc->nodes.len; i < len; i++) {
+static void js_gcdump_write_nodes(KidWriter *w, JSGCDumpContext *dc) {
+  for (size_t i = 0, len = dc->nodes.len; i < len; i++) {
     JSGCDumpNode *node = kid_array_el(&dc->nodes, JSGCDumpNode, i);
-    dbuf_printf(&dbuf, "%d,%d,%zu,%zu,%zu", node->type, node->name, node->id,
-                node->self_size, node->edges.len);
-    if (i != len - 1)
-      dbuf_putstr(&dbuf, ",\n");
-    else
-      dbuf_putstr(&dbuf, "\n");
+    kid_writer_printf(w, "%d,%d,%zu,%zu,%u%s", node->type, node->name,
+                      node->id, node->self_size, node->edge_count,
+                      i != len - 1 ? ",\n" : "\n");
   }
-  fwrite(dbuf.buf, 1, dbuf.size, fp);
-  dbuf_free(&dbuf);
 }
 
-void js_gcdump_write_edges(FILE *fp, JSGCDumpContext *dc) {
-  DynBuf dbuf;
-  js_dbuf_init(dc->jc, &dbuf);
+/* the edges are written in the order of their source node */
+static void js_gcdump_write_edges(KidWriter *w, JSGCDumpContext *dc) {
+  size_t h = 0;
 
-  for (int i = 0, len = dc->nodes.len, h = 0; i < len; i++) {
+  for (size_t i = 0, len = dc->nodes.len; i < len; i++) {
     JSGCDumpNode *node = kid_array_el(&dc->nodes, JSGCDumpNode, i);
 
-    for (int j = 0, k = node->edges.len; j < k; j++, h++) {
-      JSGCDumpEdge *edge = kid_array_el(&node->edges, JSGCDumpEdge, j);
-      dbuf_printf(&dbuf, "%d,%d,%zu", edge->type, edge->name_or_idx, edge->to);
-      if (h != dc->edges_len - 1)
-        dbuf_putstr(&dbuf, ",\n");
-      else
-        dbuf_putstr(&dbuf, "\n");
+    for (int j = node->first_edge; j >= 0;) {
+      JSGCDumpEdge *edge = kid_array_el(&dc->edges, JSGCDumpEdge, j);
+      kid_writer_printf(w, "%d,%d,%zu%s", edge->type, edge->name_or_idx,
+                        (size_t)edge->to * NODE_FIELD_COUNT,
+                        ++h != dc->edges.len ? ",\n" : "\n");
+      j = edge->next;
     }
   }
-  fwrite(dbuf.buf, 1, dbuf.size, fp);
-  dbuf_free(&dbuf);
 }
 
-void js_gcdump_write_strs(FILE *fp, JSGCDumpContext *dc) {
-  DynBuf dbuf;
-  js_dbuf_init(dc->jc, &dbuf);
-
-  for (int i = 0, len = dc->strs.len; i < len; i++) {
+static void js_gcdump_write_strs(KidWriter *w, JSGCDumpContext *dc) {
+  for (size_t i = 0, len = dc->strs.len; i < len; i++) {
     KidString *str = kid_array_el(&dc->strs, KidString, i);
-    dbuf_putc(&dbuf, '"');
-    dbuf_put(&dbuf, (const uint8_t *)str->data, str->len);
-    dbuf_putc(&dbuf, '"');
-    if (i != len - 1)
-      dbuf_putstr(&dbuf, ",\n");
-    else
-      dbuf_putstr(&dbuf, "\n");
+    kid_writer_put_json_str(w, str->data, str->len);
+    kid_writer_puts(w, i != len - 1 ? ",\n" : "\n");
   }
-  fwrite(dbuf.buf, 1, dbuf.size, fp);
-  dbuf_free(&dbuf);
 }
 
-void js_gcdump_write2file(JSGCDumpContext *dc) {
+/* stream the snapshot in the format of the Chrome DevTools to `fd`. Return
+   0 or an errno value */
+static int js_gcdump_write(JSGCDumpContext *dc, int fd) {
+  KidWriter *w;
+  int ret;
+
+  w = kid_malloc(sizeof(*w));
+  if (!w)
+    return ENOMEM;
+  kid_writer_init(w, fd);
+
+  // clang-format off
+  kid_writer_puts(w, "{\n"); // begin
+
+  kid_writer_puts(w, "  \"snapshot\": {\n"); // snapshot
+  kid_writer_puts(w, "    \"meta\": {\n");   // meta
+
+  kid_writer_puts(w, "      \"node_fields\": [\n"); // node_fields
+  kid_writer_puts(w, "        \"type\",\n");
+  kid_writer_puts(w, "        \"name\",\n");
+  kid_writer_puts(w, "        \"id\",\n");
+  kid_writer_puts(w, "        \"self_size\",\n");
+  kid_writer_puts(w, "        \"edge_count\"\n");
+  kid_writer_puts(w, "      ],\n"); // node_fields close
+
+  kid_writer_puts(w, "      \"node_types\": [\n"); // node_types
+  kid_writer_puts(w, "        [\n");  // node_types enum
+  kid_writer_puts(w, "          \"hidden\",\n");
+  kid_writer_puts(w, "          \"array\",\n");
+  kid_writer_puts(w, "          \"string\",\n");
+  kid_writer_puts(w, "          \"object\",\n");
+  kid_writer_puts(w, "          \"code\",\n");
+  kid_writer_puts(w, "          \"closure\",\n");
+  kid_writer_puts(w, "          \"regexp\",\n");
+  kid_writer_puts(w, "          \"number\",\n");
+  kid_writer_puts(w, "          \"native\",\n");
+  kid_writer_puts(w, "          \"synthetic\",\n");
+  kid_writer_puts(w, "          \"concatenated string\",\n");
+  kid_writer_puts(w, "          \"sliced string\",\n");
+  kid_writer_puts(w, "          \"symbol\",\n");
+  kid_writer_puts(w, "          \"bigint\"\n");
+  kid_writer_puts(w, "        ],\n"); // node_types enum close
+  kid_writer_puts(w, "        \"string\",\n");
+  kid_writer_puts(w, "        \"number\",\n");
+  kid_writer_puts(w, "        \"number\",\n");
+  kid_writer_puts(w, "        \"number\"\n");
+  kid_writer_puts(w, "      ],\n");                // node_types close
+
+  kid_writer_puts(w, "      \"edge_fields\": [\n"); // edge_fields
+  kid_writer_puts(w, "        \"type\",\n");
+  kid_writer_puts(w, "        \"name_or_index\",\n");
+  kid_writer_puts(w, "        \"to_node\"\n");
+  kid_writer_puts(w, "      ],\n");                 // edge_fields close
+
+  kid_writer_puts(w, "      \"edge_types\": [\n"); // edge_types
+  kid_writer_puts(w, "        [\n");  // edge_types enum
+  kid_writer_puts(w, "          \"context\",\n");
+  kid_writer_puts(w, "          \"element\",\n");
+  kid_writer_puts(w, "          \"property\",\n");
+  kid_writer_puts(w, "          \"internal\",\n");
+  kid_writer_puts(w, "          \"hidden\",\n");
+  kid_writer_puts(w, "          \"shortcut\",\n");
+  kid_writer_puts(w, "          \"weak\"\n");
+  kid_writer_puts(w, "        ],\n"); // edge_types enum close
+  kid_writer_puts(w, "        \"string_or_number\",\n");
+  kid_writer_puts(w, "        \"node\"\n");
+  kid_writer_puts(w, "      ]\n");                 // edge_types close
+
+  kid_writer_puts(w, "    },\n"); // meta close
+
+  kid_writer_printf(w, "    \"node_count\": %zu,\n", dc->nodes.len);
+  kid_writer_printf(w, "    \"edge_count\": %zu\n", dc->edges.len);
+  kid_writer_puts(w, "  },\n"); // snapshot close
+
+  kid_writer_puts(w, "  \"nodes\": [\n"); // nodes
+  js_gcdump_write_nodes(w, dc);
+  kid_writer_puts(w, "  ],\n");           // nodes close
+
+  kid_writer_puts(w, "  \"edges\": [\n"); // edges
+  js_gcdump_write_edges(w, dc);
+  kid_writer_puts(w, "  ],\n");            // edges close
+
+  kid_writer_puts(w, "  \"strings\": [\n"); // strings
+  js_gcdump_write_strs(w, dc);
+  kid_writer_puts(w, "  ]\n");            // strings close
+
+  kid_writer_puts(w, "}"); // end
+  // clang-format on
+  ret = kid_writer_flush(w);
+  kid_free(w);
+  return ret;
+}
+
+static int js_gcdump_open_file(void) {
   struct timeval tv;
   char buf1[64], buf2[128];
   struct tm *ti;
@@ -2055,94 +2635,22 @@ void js_gcdump_write2file(JSGCDumpContext *dc) {
   ti = localtime(&tv.tv_sec);
 
   strftime(buf1, sizeof(buf1), "Heap.%Y%m%d.%H%M%S", ti);
-  snprintf(buf2, sizeof(buf2), "%s.%03d.heapsnapshot", buf1, tv.tv_usec / 1000);
-
-  FILE *fp = fopen(buf2, "w");
-
-  // clang-format off
-  fprintf(fp, "{\n"); // begin
-
-  fprintf(fp, "  \"snapshot\": {\n"); // snapshot
-  fprintf(fp, "    \"meta\": {\n");   // meta
-
-  fprintf(fp, "      \"node_fields\": [\n"); // node_fields
-  fprintf(fp, "        \"type\",\n");
-  fprintf(fp, "        \"name\",\n");
-  fprintf(fp, "        \"id\",\n");
-  fprintf(fp, "        \"self_size\",\n");
-  fprintf(fp, "        \"edge_count\"\n"); 
-  fprintf(fp, "      ],\n"); // node_fields close
-
-  fprintf(fp, "      \"node_types\": [\n"); // node_types
-  fprintf(fp, "        [\n");  // node_types enum
-  fprintf(fp, "          \"hidden\",\n");
-  fprintf(fp, "          \"array\",\n");
-  fprintf(fp, "          \"string\",\n");
-  fprintf(fp, "          \"object\",\n");
-  fprintf(fp, "          \"code\",\n");
-  fprintf(fp, "          \"closure\",\n");
-  fprintf(fp, "          \"regexp\",\n");
-  fprintf(fp, "          \"number\",\n");
-  fprintf(fp, "          \"native\",\n");
-  fprintf(fp, "          \"synthetic\",\n");
-  fprintf(fp, "          \"concatenated string\",\n");
-  fprintf(fp, "          \"sliced string\",\n");
-  fprintf(fp, "          \"symbol\",\n");
-  fprintf(fp, "          \"bigint\"\n");
-  fprintf(fp, "        ],\n"); // node_types enum close
-  fprintf(fp, "        \"string\",\n");  
-  fprintf(fp, "        \"number\",\n");  
-  fprintf(fp, "        \"number\",\n");  
-  fprintf(fp, "        \"number\"\n");  
-  fprintf(fp, "      ],\n");                // node_types close
-
-  fprintf(fp, "      \"edge_fields\": [\n"); // edge_fields
-  fprintf(fp, "        \"type\",\n");
-  fprintf(fp, "        \"name_or_index\",\n");
-  fprintf(fp, "        \"to_node\"\n");
-  fprintf(fp, "      ],\n");                 // edge_fields close
-
-  fprintf(fp, "      \"edge_types\": [\n"); // edge_types
-  fprintf(fp, "        [\n");  // edge_types enum
-  fprintf(fp, "          \"context\",\n");
-  fprintf(fp, "          \"element\",\n");
-  fprintf(fp, "          \"property\",\n");
-  fprintf(fp, "          \"internal\",\n");
-  fprintf(fp, "          \"hidden\",\n");
-  fprintf(fp, "          \"shortcut\",\n");
-  fprintf(fp, "          \"weak\"\n");
-  fprintf(fp, "        ],\n"); // edge_types enum close
-  fprintf(fp, "        \"string_or_number\",\n"); 
-  fprintf(fp, "        \"node\"\n"); 
-  fprintf(fp, "      ]\n");                 // edge_types close
-
-  fprintf(fp, "    },\n"); // meta close
-
-  fprintf(fp, "    \"node_count\": %zu,\n", dc->nodes.len);
-  fprintf(fp, "    \"edge_count\": %zu\n", dc->edges_len);
-  fprintf(fp, "  },\n"); // snapshot close
-
-  fprintf(fp, "  \"nodes\": [\n"); // nodes
-  js_gcdump_write_nodes(fp, dc);
-  fprintf(fp, "  ],\n");           // nodes close
-
-  fprintf(fp, "  \"edges\": [\n"); // edges
-  js_gcdump_write_edges(fp, dc);
-  fprintf(fp, "  ],\n");            // edges close
-
-  fprintf(fp, "  \"strings\": [\n"); // edges
-  js_gcdump_write_strs(fp, dc);
-  fprintf(fp, "  ]\n");            // edges close
-
-  fprintf(fp, "}"); // end
-  // clang-format on
-  fclose(fp);
+  snprintf(buf2, sizeof(buf2), "%s.%03d.heapsnapshot", buf1,
+           (int)(tv.tv_usec / 1000));
+  return open(buf2, O_WRONLY | O_CREAT | O_TRUNC, 0644);
 }
 
-void __js_gcdump_objects(JSContext *ctx) {
+/* write the snapshot to `fd` or to a new file named after the time if `fd`
+   is negative. Return 0 or an errno value */
+static int __js_gcdump_objects(JSContext *ctx, int fd) {
   JSRuntime *rt = ctx->rt;
   struct list_head *el;
-  JSGCDumpContext *dc = js_gcdump_new_ctx(ctx);
+  JSGCDumpContext *dc;
+  int ret;
+
+  dc = js_gcdump_new_ctx(ctx);
+  if (!dc)
+    return ENOMEM;
 
   // make sure ctx is root node with index 0
   js_gcdump_node_from_gp(dc, ctx);
@@ -2161,13 +2669,20 @@ void __js_gcdump_objects(JSContext *ctx) {
     gcdump_children(rt, gp, js_gcdump_process_obj, dctx);
   }
 
-  js_gcdump_write2file(dc);
-
-  for (int i = 0, len = dc->nodes.len; i < len; i++) {
-    JSGCDumpNode *node = kid_array_el(&dc->nodes, JSGCDumpNode, i);
-    kid_array_free(&node->edges);
+  if (fd >= 0) {
+    ret = js_gcdump_write(dc, fd);
+  } else {
+    fd = js_gcdump_open_file();
+    if (fd < 0) {
+      ret = errno;
+    } else {
+      ret = js_gcdump_write(dc, fd);
+      close(fd);
+    }
   }
+
   kid_array_free(&dc->nodes);
+  kid_array_free(&dc->edges);
 
   for (int i = 0, len = dc->strs.len; i < len; i++) {
     KidString str = *kid_array_el(&dc->strs, KidString, i);
@@ -2180,10 +2695,23 @@ void __js_gcdump_objects(JSContext *ctx) {
 
   kid_set_allocator(NULL);
   js_free_rt(rt, dc);
+  return ret;
 }
 
+/* __js_gcdump_objects([fd]) */
 JSValue js_gcdump_objects(JSContext *ctx, JSValueConst this_val, int argc,
                           JSValueConst *argv) {
-  __js_gcdump_objects(ctx);
+  int fd = -1, ret;
+
+  if (argc > 0 && !JS_IsUndefined(argv[0])) {
+    if (JS_ToInt32(ctx, &fd, argv[0]))
+      return JS_EXCEPTION;
+    if (fd < 0)
+      return JS_ThrowRangeError(ctx, "invalid file descriptor");
+  }
+  ret = __js_gcdump_objects(ctx, fd);
+  if (ret)
+    return JS_ThrowInternalError(ctx, "could not write the heap snapshot: %s",
+                                 strerror(ret));
   return JS_NULL;
-}
\ No newline at end of file
+}
@@ -23,6 +23,61 @@ static inline int js_resize_array(JSContext *ctx, void **parray, int elem_size,
 /* called by libbf */
 void *js_bf_realloc(void *opaque, void *ptr, size_t size);
 
+/* -- Slab allocator ----------------------------------- */
+
+/* The size of a slab block is not stored: it must be given again when
+   the block is freed. */
+
+#define JS_SLAB_SIZE_MAX (JS_SLAB_CLASS_COUNT << JS_SLAB_CLASS_SHIFT)
+
+/* TRUE if the blocks of 'size' bytes are allocated from the slabs */
+static inline BOOL js_slab_has_size(JSRuntime *rt, size_t size) {
+  return rt->slab_enabled && size <= JS_SLAB_SIZE_MAX;
+}
+
+static inline int js_slab_class(size_t size) {
+  return (size - 1) >> JS_SLAB_CLASS_SHIFT;
+}
+
+void *js_slab_alloc_page(JSRuntime *rt, size_t size);
+void js_slab_trim(JSRuntime *rt);
+void js_slab_free_pages(JSRuntime *rt);
+
+static inline void *js_slab_alloc_rt(JSRuntime *rt, size_t size) {
+  JSSlabBlock **plist, *b;
+
+  if (!js_slab_has_size(rt, size))
+    return js_malloc_rt(rt, size);
+  plist = &rt->slab_free_list[js_slab_class(size)];
+  b = *plist;
+  if (unlikely(!b))
+    return js_slab_alloc_page(rt, size);
+  *plist = b->next;
+  rt->slab_count++;
+  rt->slab_size += (js_slab_class(size) + 1) << JS_SLAB_CLASS_SHIFT;
+  return b;
+}
+
+static inline void js_slab_free_rt(JSRuntime *rt, void *ptr, size_t size) {
+  JSSlabBlock **plist, *b;
+
+  if (!js_slab_has_size(rt, size)) {
+    js_free_rt(rt, ptr);
+    return;
+  }
+  plist = &rt->slab_free_list[js_slab_class(size)];
+  b = ptr;
+  b->next = *plist;
+  *plist = b;
+  rt->slab_count--;
+  rt->slab_size -= (js_slab_class(size) + 1) << JS_SLAB_CLASS_SHIFT;
+}
+
+/* Throw out of memory in case of error */
+void *js_slab_alloc(JSContext *ctx, size_t size);
+void *js_slab_realloc(JSContext *ctx, void *ptr, size_t old_size,
+                      size_t new_size);
+
 /* -- Garbage collection ----------------------------------- */
 
 static inline void set_value(JSContext *ctx, JSValue *pval, JSValue new_val) {
@@ -38,6 +93,17 @@ void set_cycle_flag(JSContext *ctx, JSValueConst obj);
 
 void add_gc_object(JSRuntime *rt, JSGCObjectHeader *h, JSGCObjectTypeEnum type);
 void remove_gc_object(JSGCObjectHeader *h);
+void gc_add_possible_root(JSRuntime *rt, JSGCObjectHeader *h);
+
+/* insert again in gc_obj_list a GC object whose header was moved in
+   memory, keeping the possible roots at the head of the list */
+static inline void gc_relink_object(JSRuntime *rt, JSGCObjectHeader *h) {
+  if (h->root_buffered)
+    list_add(&h->link, &rt->gc_obj_list);
+  else
+    list_add_tail(&h->link, &rt->gc_obj_list);
+}
+
 void free_gc_object(JSRuntime *rt, JSGCObjectHeader *gp);
 void gc_decref(JSRuntime *rt);
 
@@ -50,7 +116,8 @@ void free_bytecode_atoms(JSRuntime *rt, const uint8_t *bc_buf, int bc_len,
 typedef struct JSGCDumpEdge {
   uint8_t type;
   uint32_t name_or_idx;
-  size_t to;
+  uint32_t to;  // node index
+  int32_t next; // next edge of the same node in `edges`, -1 if last
 } JSGCDumpEdge;
 
 #define NODE_FIELD_COUNT 5
@@ -60,14 +127,16 @@ typedef struct JSGCDumpNode {
   JSAtom name;
   uint16_t type;
   size_t self_size;
-  KidArray edges; // Array<JSGCDumpEdge>
+  uint32_t edge_count;
+  int32_t first_edge; // in `edges`, -1 if none
+  int32_t last_edge;
 } JSGCDumpNode;
 
 typedef struct JSGCDumpContext {
   JSContext *jc;
   KidAllocator kid_allocator;
   KidArray nodes;
-  size_t edges_len;
+  KidArray edges; // Array<JSGCDumpEdge>, the edges of a node are chained
 
   KidArray strs;     // Array<KidString>
   KidHashmap str2id; // Hashmap<JSString*, int>
@@ -79,6 +148,7 @@ int js_gcdump_node_from_gp(JSGCDumpContext *dc, void *gp);
 int js_gcdump_add_cstr(JSGCDumpContext *dc, const char *cstr, size_t len);
 int js_gcdump_add_str(JSGCDumpContext *dc, JSString *str);
 int js_gcdump_add_atom(JSGCDumpContext *dc, JSAtom atom);
+void js_gcdump_add_edge(JSGCDumpContext *dc, int from, JSGCDumpEdge *edge);
 JSValue js_gcdump_objects(JSContext *ctx, JSValueConst this_val, int argc,
                           JSValueConst *argv);
 
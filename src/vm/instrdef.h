@@ -55,6 +55,9 @@ FMT(atom_u16)
 FMT(atom_label_u8)
 FMT(atom_label_u16)
 FMT(label_u16)
+FMT(atom_u16_loc)
+FMT(loc_i32_label)
+FMT(arg_arg)
 #undef FMT
 #endif /* FMT */
 
@@ -362,6 +365,26 @@ DEF(typeof_is_undefined, 1, 1, 1, none)
 DEF( typeof_is_function, 1, 1, 1, none)
 #endif
 
+/* only in the copy of the bytecode patched by the debugger */
+DEF(     debug_trap, 1, 0, 0, none)
+
+/* emitted by resolve_labels(), the u16 is the index of `b->ic` */
+DEF(   get_field_ic, 7, 1, 1, atom_u16)
+DEF(  get_field2_ic, 7, 1, 2, atom_u16) /* must come after get_field_ic */
+DEF(   put_field_ic, 7, 2, 0, atom_u16) /* must come after get_field2_ic */
+/* the u16 is the index of `b->gic` */
+DEF(     get_var_ic, 7, 0, 1, atom_u16)
+DEF(     put_var_ic, 7, 1, 0, atom_u16) /* must come after get_var_ic */
+
+/* superinstructions of the most frequent opcode sequences, emitted by
+   resolve_labels() */
+DEF(get_loc_get_field_ic, 9, 0, 1, atom_u16_loc)
+DEF(get_loc_push_i32_lt_if_false, 11, 0, 0, loc_i32_label)
+DEF(get_arg_get_arg_add, 5, 0, 1, arg_arg)
+
+/* the opcodes are stored in a byte: with CONFIG_BIGNUM, OP_COUNT is now 255
+   and only one opcode can still be added here */
+
 #undef DEF
 #undef def
 #endif  /* DEF */
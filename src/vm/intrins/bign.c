@@ -348,6 +348,7 @@ redo:
       break;
     goto redo;
   case JS_TAG_STRING:
+  case JS_TAG_STRING_ROPE:
     val = JS_StringToBigIntErr(ctx, val);
     break;
   case JS_TAG_OBJECT:
@@ -870,7 +871,8 @@ static JSValue js_bigfloat_constructor(JSContext *ctx, JSValueConst new_target,
       if (JS_IsException(val))
         break;
       goto redo;
-    case JS_TAG_STRING: {
+    case JS_TAG_STRING:
+    case JS_TAG_STRING_ROPE: {
       const char *str, *p;
       size_t len;
       int err;
@@ -1525,7 +1527,8 @@ redo:
     if (JS_IsException(val))
       break;
     goto redo;
-  case JS_TAG_STRING: {
+  case JS_TAG_STRING:
+  case JS_TAG_STRING_ROPE: {
     const char *str, *p;
     size_t len;
     int err;
@@ -299,7 +299,7 @@ typedef struct JSMapRecord {
   int ref_count; /* used during enumeration to avoid freeing the record */
   BOOL empty;    /* TRUE if the record is deleted */
   struct JSMapState *map;
-  struct JSMapRecord *next_weak_ref;
+  struct JSMapRecord *next_weak_ref; /* in JSRuntime.weak_ref_hash[h] list */
   struct list_head link;
   struct list_head hash_link;
   JSValue key;
@@ -319,6 +319,13 @@ typedef struct JSMapState {
 #define MAGIC_SET (1 << 0)
 #define MAGIC_WEAK (1 << 1)
 
+/* index in JSRuntime.weak_ref_hash of the records whose key is 'p' */
+static inline uint32_t js_weak_ref_hash(JSRuntime *rt, JSObject *p) {
+  /* same magic hash multiplier as the shape hash */
+  uint32_t h = (uint32_t)((uintptr_t)p >> 3) * 0x9e370001;
+  return h >> (32 - rt->weak_ref_hash_bits);
+}
+
 void js_map_finalizer(JSRuntime *rt, JSValue val);
 void js_map_mark(JSRuntime *rt, JSValueConst val, JS_MarkFunc *mark_func);
 void js_map_gcdump(JSRuntime *rt, JSValueConst val, JS_GCDumpFunc *walk_func,
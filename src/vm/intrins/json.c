@@ -12,8 +12,10 @@ JSValue JS_ParseJSON2(JSContext *ctx, const char *buf, size_t buf_len,
   JSParseState s1, *s = &s1;
   JSValue val = JS_UNDEFINED;
 
+  if (!(flags & JS_PARSE_JSON_EXT))
+    return json_scan(ctx, buf, buf_len, filename);
   js_parse_init(ctx, s, buf, buf_len, filename);
-  s->ext_json = ((flags & JS_PARSE_JSON_EXT) != 0);
+  s->ext_json = TRUE;
   if (json_next_token(s))
     goto fail;
   val = json_parse_value(s);
@@ -192,6 +194,7 @@ static JSValue js_json_check(JSContext *ctx, JSONStringifyContext *jsc,
     if (JS_IsFunction(ctx, val))
       break;
   case JS_TAG_STRING:
+  case JS_TAG_STRING_ROPE:
   case JS_TAG_INT:
   case JS_TAG_FLOAT64:
 #ifdef CONFIG_BIGNUM
@@ -374,6 +377,7 @@ static int js_json_to_str(JSContext *ctx, JSONStringifyContext *jsc,
     JS_FreeValue(ctx, prop);
     return 0;
   case JS_TAG_STRING:
+  case JS_TAG_STRING_ROPE:
     val = JS_ToQuotedStringFree(ctx, val);
     if (JS_IsException(val))
       goto exception;
@@ -496,6 +500,9 @@ JSValue JS_JSONStringify(JSContext *ctx, JSValueConst obj,
       goto exception;
     }
   }
+  space = js_string_flatten_free(ctx, space);
+  if (JS_IsException(space))
+    goto exception;
   if (JS_IsNumber(space)) {
     int n;
     if (JS_ToInt32Clamp(ctx, &n, space, 0, 10, 0))
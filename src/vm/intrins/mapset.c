@@ -124,6 +124,13 @@ static JSValueConst map_normalize_key(JSContext *ctx, JSValueConst key) {
   /* convert -0.0 to +0.0 */
   if (JS_TAG_IS_FLOAT64(tag) && JS_VALUE_GET_FLOAT64(key) == 0.0) {
     key = JS_NewInt32(ctx, 0);
+  } else if (tag == JS_TAG_STRING_ROPE) {
+    JSValue str = js_rope_flatten(ctx, key);
+    if (JS_IsException(str))
+      return str;
+    /* the flat string is kept by the rope */
+    JS_FreeValue(ctx, str);
+    key = str;
   }
   return key;
 }
@@ -144,7 +151,10 @@ static uint32_t map_hash_key(JSContext *ctx, JSValueConst key) {
     break;
   case JS_TAG_OBJECT:
   case JS_TAG_SYMBOL:
-    h = (uintptr_t)JS_VALUE_GET_PTR(key) * 3163;
+    /* the low bits of the pointers are zero because of the alignment
+       of the slab blocks, so the high bits of the product are used */
+    h = ((uint64_t)(uintptr_t)JS_VALUE_GET_PTR(key) * 0x9e3779b97f4a7c15) >>
+        32;
     break;
   case JS_TAG_INT:
     d = JS_VALUE_GET_INT(key) * 3163;
@@ -182,7 +192,6 @@ static JSMapRecord *map_find_record(JSContext *ctx, JSMapState *s,
 
 static void map_hash_resize(JSContext *ctx, JSMapState *s) {
   uint32_t new_hash_size, i, h;
-  size_t slack;
   struct list_head *new_hash_table, *el;
   JSMapRecord *mr;
 
@@ -191,11 +200,11 @@ static void map_hash_resize(JSContext *ctx, JSMapState *s) {
     new_hash_size = 4;
   else
     new_hash_size = s->hash_size * 2;
-  new_hash_table = js_realloc2(
-      ctx, s->hash_table, sizeof(new_hash_table[0]) * new_hash_size, &slack);
+  /* the slack is not used because the size must stay a power of two */
+  new_hash_table = js_realloc(ctx, s->hash_table,
+                              sizeof(new_hash_table[0]) * new_hash_size);
   if (!new_hash_table)
     return;
-  new_hash_size += slack / sizeof(*new_hash_table);
 
   for (i = 0; i < new_hash_size; i++)
     init_list_head(&new_hash_table[i]);
@@ -212,11 +221,42 @@ static void map_hash_resize(JSContext *ctx, JSMapState *s) {
   s->record_count_threshold = new_hash_size * 2;
 }
 
+static int weak_ref_hash_resize(JSContext *ctx, int new_hash_bits) {
+  JSRuntime *rt = ctx->rt;
+  int new_hash_size, i;
+  uint32_t h;
+  JSMapRecord **new_hash, *mr, *mr_next;
+
+  new_hash_size = 1 << new_hash_bits;
+  new_hash = js_mallocz(ctx, sizeof(rt->weak_ref_hash[0]) * new_hash_size);
+  if (!new_hash)
+    return -1;
+  /* js_weak_ref_hash() uses the new size */
+  rt->weak_ref_hash_bits = new_hash_bits;
+  for (i = 0; i < rt->weak_ref_hash_size; i++) {
+    for (mr = rt->weak_ref_hash[i]; mr != NULL; mr = mr_next) {
+      mr_next = mr->next_weak_ref;
+      h = js_weak_ref_hash(rt, JS_VALUE_GET_OBJ(mr->key));
+      mr->next_weak_ref = new_hash[h];
+      new_hash[h] = mr;
+    }
+  }
+  js_free(ctx, rt->weak_ref_hash);
+  rt->weak_ref_hash_size = new_hash_size;
+  rt->weak_ref_hash = new_hash;
+  return 0;
+}
+
 static JSMapRecord *map_add_record(JSContext *ctx, JSMapState *s,
                                    JSValueConst key) {
+  JSRuntime *rt = ctx->rt;
   uint32_t h;
   JSMapRecord *mr;
 
+  if (s->is_weak && rt->weak_ref_count >= rt->weak_ref_hash_size) {
+    if (weak_ref_hash_resize(ctx, max_int(rt->weak_ref_hash_bits + 1, 4)))
+      return NULL;
+  }
   mr = js_malloc(ctx, sizeof(*mr));
   if (!mr)
     return NULL;
@@ -226,8 +266,11 @@ static JSMapRecord *map_add_record(JSContext *ctx, JSMapState *s,
   if (s->is_weak) {
     JSObject *p = JS_VALUE_GET_OBJ(key);
     /* Add the weak reference */
-    mr->next_weak_ref = p->first_weak_ref;
-    p->first_weak_ref = mr;
+    h = js_weak_ref_hash(rt, p);
+    mr->next_weak_ref = rt->weak_ref_hash[h];
+    rt->weak_ref_hash[h] = mr;
+    rt->weak_ref_count++;
+    p->header.has_weak_ref = 1;
   } else {
     JS_DupValue(ctx, key);
   }
@@ -242,16 +285,13 @@ static JSMapRecord *map_add_record(JSContext *ctx, JSMapState *s,
   return mr;
 }
 
-/* Remove the weak reference from the object weak
-   reference list. we don't use a doubly linked list to
-   save space, assuming a given object has few weak
-       references to it */
+/* Remove the weak reference from the weak reference hash table. we
+   don't use a doubly linked list to save space, the hash lists being
+   short */
 static void delete_weak_ref(JSRuntime *rt, JSMapRecord *mr) {
   JSMapRecord **pmr, *mr1;
-  JSObject *p;
 
-  p = JS_VALUE_GET_OBJ(mr->key);
-  pmr = &p->first_weak_ref;
+  pmr = &rt->weak_ref_hash[js_weak_ref_hash(rt, JS_VALUE_GET_OBJ(mr->key))];
   for (;;) {
     mr1 = *pmr;
     assert(mr1 != NULL);
@@ -260,6 +300,7 @@ static void delete_weak_ref(JSRuntime *rt, JSMapRecord *mr) {
     pmr = &mr1->next_weak_ref;
   }
   *pmr = mr1->next_weak_ref;
+  rt->weak_ref_count--;
 }
 
 static void map_delete_record(JSRuntime *rt, JSMapState *s, JSMapRecord *mr) {
@@ -302,6 +343,8 @@ static JSValue js_map_set(JSContext *ctx, JSValueConst this_val, int argc,
   if (!s)
     return JS_EXCEPTION;
   key = map_normalize_key(ctx, argv[0]);
+  if (JS_IsException(key))
+    return JS_EXCEPTION;
   if (s->is_weak && !JS_IsObject(key))
     return JS_ThrowTypeErrorNotAnObject(ctx);
   if (magic & MAGIC_SET)
@@ -329,6 +372,8 @@ static JSValue js_map_get(JSContext *ctx, JSValueConst this_val, int argc,
   if (!s)
     return JS_EXCEPTION;
   key = map_normalize_key(ctx, argv[0]);
+  if (JS_IsException(key))
+    return JS_EXCEPTION;
   mr = map_find_record(ctx, s, key);
   if (!mr)
     return JS_UNDEFINED;
@@ -345,6 +390,8 @@ static JSValue js_map_has(JSContext *ctx, JSValueConst this_val, int argc,
   if (!s)
     return JS_EXCEPTION;
   key = map_normalize_key(ctx, argv[0]);
+  if (JS_IsException(key))
+    return JS_EXCEPTION;
   mr = map_find_record(ctx, s, key);
   return JS_NewBool(ctx, (mr != NULL));
 }
@@ -358,6 +405,8 @@ static JSValue js_map_delete(JSContext *ctx, JSValueConst this_val, int argc,
   if (!s)
     return JS_EXCEPTION;
   key = map_normalize_key(ctx, argv[0]);
+  if (JS_IsException(key))
+    return JS_EXCEPTION;
   mr = map_find_record(ctx, s, key);
   if (!mr)
     return JS_FALSE;
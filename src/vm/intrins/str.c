@@ -5,6 +5,12 @@
 #include "vm/obj.h"
 #include "vm/str.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 /* String */
 
 static int js_string_get_own_property(JSContext *ctx,
@@ -131,6 +137,8 @@ JSValue js_string_constructor(JSContext *ctx, JSValueConst new_target, int argc,
 static JSValue js_thisStringValue(JSContext *ctx, JSValueConst this_val) {
   if (JS_VALUE_GET_TAG(this_val) == JS_TAG_STRING)
     return JS_DupValue(ctx, this_val);
+  if (JS_VALUE_GET_TAG(this_val) == JS_TAG_STRING_ROPE)
+    return js_rope_flatten(ctx, this_val);
 
   if (JS_VALUE_GET_TAG(this_val) == JS_TAG_OBJECT) {
     JSObject *p = JS_VALUE_GET_OBJ(this_val);
@@ -371,35 +379,100 @@ static int string_cmp(JSString *p1, JSString *p2, int x1, int x2, int len) {
   return 0;
 }
 
+#define string_char(p, i) ((p)->is_wide_char ? (p)->u.str16[i] : (p)->u.str8[i])
+
+/* TRUE if the 'len' characters at 'x1' in 'p1' and at 'x2' in 'p2' are
+   equal */
+static BOOL string_eq(JSString *p1, JSString *p2, int x1, int x2, int len) {
+  if (p1->is_wide_char != p2->is_wide_char)
+    return !string_cmp(p1, p2, x1, x2, len);
+  if (p1->is_wide_char)
+    return !memcmp(p1->u.str16 + x1, p2->u.str16 + x2, len * 2);
+  return !memcmp(p1->u.str8 + x1, p2->u.str8 + x2, len);
+}
+
+static int str16_indexof_char(const uint16_t *tab, uint16_t c, int from,
+                              int len) {
+  int i = from;
+#if defined(__AVX2__)
+  __m256i vc = _mm256_set1_epi16(c);
+  for (; i + 16 <= len; i += 16) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(tab + i));
+    uint32_t mask = _mm256_movemask_epi8(_mm256_cmpeq_epi16(v, vc));
+    if (mask)
+      return i + (ctz32(mask) >> 1);
+  }
+#elif defined(__SSE2__)
+  __m128i vc = _mm_set1_epi16(c);
+  for (; i + 8 <= len; i += 8) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(tab + i));
+    uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi16(v, vc));
+    if (mask)
+      return i + (ctz32(mask) >> 1);
+  }
+#endif
+  for (; i < len; i++) {
+    if (tab[i] == c)
+      return i;
+  }
+  return -1;
+}
+
 int string_indexof_char(JSString *p, int c, int from) {
   /* assuming 0 <= from <= p->len */
-  int i, len = p->len;
+  int len = p->len;
   if (p->is_wide_char) {
-    for (i = from; i < len; i++) {
-      if (p->u.str16[i] == c)
-        return i;
-    }
+    if ((c & ~0xffff) == 0)
+      return str16_indexof_char(p->u.str16, c, from, len);
   } else {
-    if ((c & ~0xff) == 0) {
-      for (i = from; i < len; i++) {
-        if (p->u.str8[i] == (uint8_t)c)
-          return i;
-      }
+    if ((c & ~0xff) == 0 && from < len) {
+      /* memchr() is vectorized by the C library */
+      const uint8_t *q = memchr(p->u.str8 + from, c, len - from);
+      if (q)
+        return q - p->u.str8;
     }
   }
   return -1;
 }
 
+/* Horspool search, used for the long patterns. The shifts are indexed by
+   the low byte of the characters so that the table is the same for both
+   string widths */
+#define STRING_HORSPOOL_MIN_LEN 16
+
+static int string_indexof_horspool(JSString *p1, JSString *p2, int from) {
+  int shift[256];
+  int i, c, last, len1 = p1->len, len2 = p2->len;
+
+  for (i = 0; i < 256; i++)
+    shift[i] = len2;
+  for (i = 0; i < len2 - 1; i++)
+    shift[string_char(p2, i) & 0xff] = len2 - 1 - i;
+  last = string_char(p2, len2 - 1);
+  for (i = from; i <= len1 - len2;) {
+    c = string_char(p1, i + len2 - 1);
+    if (c == last && string_eq(p1, p2, i, 0, len2 - 1))
+      return i;
+    i += shift[c & 0xff];
+  }
+  return -1;
+}
+
 int string_indexof(JSString *p1, JSString *p2, int from) {
   /* assuming 0 <= from <= p1->len */
   int c, i, j, len1 = p1->len, len2 = p2->len;
   if (len2 == 0)
     return from;
-  for (i = from, c = string_get(p2, 0); i + len2 <= len1; i = j + 1) {
+  if (len2 > len1 - from)
+    return -1;
+  /* the table is not worth building for short texts */
+  if (len2 >= STRING_HORSPOOL_MIN_LEN && len1 - from >= 256)
+    return string_indexof_horspool(p1, p2, from);
+  for (i = from, c = string_char(p2, 0); i + len2 <= len1; i = j + 1) {
     j = string_indexof_char(p1, c, i);
     if (j < 0 || j + len2 > len1)
       break;
-    if (!string_cmp(p1, p2, j + 1, 1, len2 - 1))
+    if (string_eq(p1, p2, j + 1, 1, len2 - 1))
       return j;
   }
   return -1;
@@ -461,13 +534,17 @@ JSValue js_string_indexOf(JSContext *ctx, JSValueConst this_val, int argc,
   }
   ret = -1;
   if (len >= v_len && inc * (stop - start) >= 0) {
-    for (i = start;; i += inc) {
-      if (!string_cmp(p, p1, i, 0, v_len)) {
-        ret = i;
-        break;
+    if (inc > 0) {
+      ret = string_indexof(p, p1, start);
+    } else {
+      for (i = start;; i += inc) {
+        if (string_eq(p, p1, i, 0, v_len)) {
+          ret = i;
+          break;
+        }
+        if (i == stop)
+          break;
       }
-      if (i == stop)
-        break;
     }
   }
   JS_FreeValue(ctx, str);
@@ -483,7 +560,7 @@ fail:
 static JSValue js_string_includes(JSContext *ctx, JSValueConst this_val,
                                   int argc, JSValueConst *argv, int magic) {
   JSValue str, v = JS_UNDEFINED;
-  int i, len, v_len, pos, start, stop, ret;
+  int len, v_len, pos, start, stop, ret;
   JSString *p;
   JSString *p1;
 
@@ -523,14 +600,10 @@ static JSValue js_string_includes(JSContext *ctx, JSValueConst this_val,
     start = stop = pos;
   }
   if (start >= 0 && start <= stop) {
-    for (i = start;; i++) {
-      if (!string_cmp(p, p1, i, 0, v_len)) {
-        ret = 1;
-        break;
-      }
-      if (i == stop)
-        break;
-    }
+    if (magic == 0)
+      ret = string_indexof(p, p1, start) >= 0;
+    else
+      ret = string_eq(p, p1, start, 0, v_len);
   }
 done:
   JS_FreeValue(ctx, str);
@@ -638,7 +711,8 @@ JSValue js_string___GetSubstitution(JSContext *ctx, JSValueConst this_val,
   namedCaptures = argv[4];
   rep = argv[5];
 
-  if (!JS_IsString(rep) || !JS_IsString(str))
+  if (JS_VALUE_GET_TAG(rep) != JS_TAG_STRING ||
+      JS_VALUE_GET_TAG(str) != JS_TAG_STRING)
     return JS_ThrowTypeError(ctx, "not a string");
 
   sp = JS_VALUE_GET_STRING(str);
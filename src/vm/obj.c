@@ -109,6 +109,7 @@ JSValueConst JS_GetPrototypePrimitive(JSContext *ctx, JSValueConst val) {
     val = ctx->class_proto[JS_CLASS_BOOLEAN];
     break;
   case JS_TAG_STRING:
+  case JS_TAG_STRING_ROPE:
     val = ctx->class_proto[JS_CLASS_STRING];
     break;
   case JS_TAG_SYMBOL:
@@ -382,6 +383,20 @@ JSValue JS_GetPropertyInternal(JSContext *ctx, JSValueConst obj, JSAtom prop,
         return JS_NewInt32(ctx, p1->len);
       }
     } break;
+    case JS_TAG_STRING_ROPE:
+      if (prop == JS_ATOM_length) {
+        return JS_NewInt32(ctx, js_string_value_len(obj));
+      } else if (__JS_AtomIsTaggedInt(prop)) {
+        JSValue str, ret;
+        str = js_rope_flatten(ctx, obj);
+        if (JS_IsException(str))
+          return str;
+        ret = JS_GetPropertyInternal(ctx, str, prop, this_obj,
+                                     throw_ref_error);
+        JS_FreeValue(ctx, str);
+        return ret;
+      }
+      break;
     default:
       break;
     }
@@ -1639,6 +1654,107 @@ int JS_SetPropertyGeneric(JSContext *ctx, JSValueConst obj, JSAtom prop,
   return ret;
 }
 
+static void js_ic_update(JSInlineCache *ic, JSShape *sh,
+                         JSShapeProperty *prs) {
+  ic->shape = sh;
+  ic->shape_id = sh->id;
+  ic->prop_idx = prs - get_shape_prop(sh);
+}
+
+JSValue js_get_field_ic_miss(JSContext *ctx, JSInlineCache *ic,
+                             JSValueConst obj, JSAtom prop) {
+  JSObject *p;
+  JSProperty *pr;
+  JSShapeProperty *prs;
+
+  if (likely(JS_VALUE_GET_TAG(obj) == JS_TAG_OBJECT)) {
+    p = JS_VALUE_GET_OBJ(obj);
+    prs = find_own_property(&pr, p, prop);
+    if (prs && !(prs->flags & JS_PROP_TMASK)) {
+      js_ic_update(ic, p->shape, prs);
+      return JS_DupValue(ctx, pr->u.value);
+    }
+  }
+  return JS_GetProperty(ctx, obj, prop);
+}
+
+/* the properties of the prototype are visible from `p` if the own properties
+   of `p` are all in its shape, as in JS_GetPropertyInternal() */
+static BOOL js_poly_ic_can_skip_own(JSObject *p, JSAtom prop) {
+  if (likely(!p->is_exotic))
+    return TRUE;
+  return p->fast_array && !__JS_AtomIsTaggedInt(prop) &&
+         !(p->class_id >= JS_CLASS_UINT8C_ARRAY &&
+           p->class_id <= JS_CLASS_FLOAT64_ARRAY);
+}
+
+JSValue js_get_field2_ic_miss(JSContext *ctx, JSPolyInlineCache *pic,
+                              JSValueConst obj, JSAtom prop) {
+  JSObject *p, *holder;
+  JSProperty *pr;
+  JSShapeProperty *prs;
+  JSPolyInlineCacheEntry *e;
+  int i;
+
+  if (unlikely(JS_VALUE_GET_TAG(obj) != JS_TAG_OBJECT))
+    return JS_GetProperty(ctx, obj, prop);
+  p = JS_VALUE_GET_OBJ(obj);
+  holder = p;
+  prs = find_own_property(&pr, p, prop);
+  if (!prs) {
+    if (!js_poly_ic_can_skip_own(p, prop) || !p->shape->proto)
+      return JS_GetProperty(ctx, obj, prop);
+    holder = p->shape->proto;
+    prs = find_own_property(&pr, holder, prop);
+  }
+  /* not cached: the generic lookup restarts from `holder` */
+  if (!prs || (prs->flags & JS_PROP_TMASK))
+    return JS_GetPropertyInternal(ctx, JS_MKPTR(JS_TAG_OBJECT, holder), prop,
+                                  obj, FALSE);
+
+  /* reuse the entry of the shape if its holder changed */
+  for (i = 0; i < JS_POLY_IC_SIZE; i++) {
+    if (pic->entries[i].shape == p->shape)
+      break;
+  }
+  if (i == JS_POLY_IC_SIZE) {
+    i = pic->next;
+    pic->next = (i + 1) % JS_POLY_IC_SIZE;
+  }
+  e = &pic->entries[i];
+  e->shape = p->shape;
+  e->shape_id = p->shape->id;
+  e->prop_idx = prs - get_shape_prop(holder->shape);
+  if (holder == p) {
+    e->holder_shape = NULL;
+  } else {
+    e->holder_shape = holder->shape;
+    e->holder_shape_id = holder->shape->id;
+  }
+  return JS_DupValue(ctx, pr->u.value);
+}
+
+int js_put_field_ic_miss(JSContext *ctx, JSInlineCache *ic,
+                         JSValueConst obj, JSAtom prop, JSValue val,
+                         int flags) {
+  JSObject *p;
+  JSProperty *pr;
+  JSShapeProperty *prs;
+
+  if (likely(JS_VALUE_GET_TAG(obj) == JS_TAG_OBJECT)) {
+    p = JS_VALUE_GET_OBJ(obj);
+    prs = find_own_property(&pr, p, prop);
+    /* same condition as the fast case of JS_SetPropertyInternal() */
+    if (prs && (prs->flags & (JS_PROP_TMASK | JS_PROP_WRITABLE |
+                              JS_PROP_LENGTH)) == JS_PROP_WRITABLE) {
+      js_ic_update(ic, p->shape, prs);
+      set_value(ctx, &pr->u.value, val);
+      return TRUE;
+    }
+  }
+  return JS_SetPropertyInternal(ctx, obj, prop, val, flags);
+}
+
 /* return -1 in case of exception or TRUE or FALSE. Warning: 'val' is
    freed by the function. 'flags' is a bitmask of JS_PROP_NO_ADD,
    JS_PROP_THROW or JS_PROP_THROW_STRICT. If JS_PROP_NO_ADD is set,
@@ -2244,6 +2360,8 @@ int js_shape_prepare_update(JSContext *ctx, JSObject *p,
       sh->is_hashed = FALSE;
     }
   }
+  /* the properties are about to be modified in place */
+  sh->id = js_new_shape_id(ctx->rt);
   return 0;
 }
 
@@ -2687,12 +2805,12 @@ int JS_DefineObjectNameComputed(JSContext *ctx, JSValueConst obj,
 
 /* -- Utils ----------------------------------- */
 
-static JSValue JS_NewObjectFromShape(JSContext *ctx, JSShape *sh,
-                                     JSClassID class_id) {
+JSValue JS_NewObjectFromShape(JSContext *ctx, JSShape *sh,
+                              JSClassID class_id) {
   JSObject *p;
 
   js_trigger_gc(ctx->rt, sizeof(JSObject));
-  p = js_malloc(ctx, sizeof(JSObject));
+  p = js_slab_alloc(ctx, sizeof(JSObject));
   if (unlikely(!p))
     goto fail;
   p->class_id = class_id;
@@ -2704,12 +2822,12 @@ static JSValue JS_NewObjectFromShape(JSContext *ctx, JSShape *sh,
   p->is_uncatchable_error = 0;
   p->tmp_mark = 0;
   p->is_HTMLDDA = 0;
-  p->first_weak_ref = NULL;
+  p->header.has_weak_ref = 0;
   p->u.opaque = NULL;
   p->shape = sh;
   p->prop = js_malloc(ctx, sizeof(JSProperty) * sh->prop_size);
   if (unlikely(!p->prop)) {
-    js_free(ctx, p);
+    js_slab_free_rt(ctx->rt, p, sizeof(JSObject));
   fail:
     js_free_shape(ctx->rt, sh);
     return JS_EXCEPTION;
@@ -71,9 +71,6 @@ struct JSObject {
   JSShape *shape;   /* prototype and property names + flag */
   JSProperty *prop; /* array of properties */
   /* byte offsets: 24/40 */
-  struct JSMapRecord
-      *first_weak_ref; /* XXX: use a bit and an external hash table? */
-  /* byte offsets: 28/48 */
   union {
     void *opaque;
     struct JSBoundFunction *bound_function; /* JS_CLASS_BOUND_FUNCTION */
@@ -150,7 +147,7 @@ struct JSObject {
     JSRegExp regexp;     /* JS_CLASS_REGEXP: 8/16 bytes */
     JSValue object_data; /* for JS_SetObjectData(): 8/16/16 bytes */
   } u;
-  /* byte sizes: 40/48/72 */
+  /* byte sizes: 36/44/64 */
 };
 
 /* -- Prototype ----------------------------------- */
@@ -242,6 +239,20 @@ JS_PROP_THROW or JS_PROP_THROW_STRICT. If JS_PROP_NO_ADD is set,
 the new property is not added and an error is raised. */
 int JS_SetPropertyInternal(JSContext *ctx, JSValueConst this_obj, JSAtom prop,
                            JSValue val, int flags);
+
+/* the slow paths of the property access instructions with an inline cache,
+   `ic` records the own data property found in `obj` */
+struct JSInlineCache;
+JSValue js_get_field_ic_miss(JSContext *ctx, struct JSInlineCache *ic,
+                             JSValueConst obj, JSAtom prop);
+/* same for `OP_get_field2_ic`, which also caches the data properties found in
+   the prototype of `obj` */
+struct JSPolyInlineCache;
+JSValue js_get_field2_ic_miss(JSContext *ctx, struct JSPolyInlineCache *pic,
+                              JSValueConst obj, JSAtom prop);
+int js_put_field_ic_miss(JSContext *ctx, struct JSInlineCache *ic,
+                         JSValueConst obj, JSAtom prop, JSValue val,
+                         int flags);
 /* flags can be JS_PROP_THROW or JS_PROP_THROW_STRICT */
 int JS_SetPropertyValue(JSContext *ctx, JSValueConst this_obj, JSValue prop,
                         JSValue val, int flags);
@@ -347,6 +358,9 @@ force_inline JSShapeProperty *find_own_property(JSProperty **ppr, JSObject *p,
 
 /* -- Utils ----------------------------------- */
 
+/* 'sh' is freed in case of error. The properties of the shape are not
+   initialized */
+JSValue JS_NewObjectFromShape(JSContext *ctx, JSShape *sh, JSClassID class_id);
 /* WARNING: proto must be an object or JS_NULL */
 JSValue JS_NewObjectProtoClass(JSContext *ctx, JSValueConst proto_val,
                                JSClassID class_id);
@@ -1087,10 +1087,10 @@ no_inline __exception int js_add_slow(JSContext *ctx, JSValue *sp) {
     /* try to call an overloaded operator */
     if ((tag1 == JS_TAG_OBJECT &&
          (tag2 != JS_TAG_NULL && tag2 != JS_TAG_UNDEFINED &&
-          tag2 != JS_TAG_STRING)) ||
+          !js_tag_is_string(tag2))) ||
         (tag2 == JS_TAG_OBJECT &&
          (tag1 != JS_TAG_NULL && tag1 != JS_TAG_UNDEFINED &&
-          tag1 != JS_TAG_STRING))) {
+          !js_tag_is_string(tag1)))) {
       ret = js_call_binary_op_fallback(ctx, &res, op1, op2, OP_add, FALSE,
                                        HINT_NONE);
       if (ret != 0) {
@@ -1120,7 +1120,7 @@ no_inline __exception int js_add_slow(JSContext *ctx, JSValue *sp) {
     tag2 = JS_VALUE_GET_NORM_TAG(op2);
   }
 
-  if (tag1 == JS_TAG_STRING || tag2 == JS_TAG_STRING) {
+  if (js_tag_is_string(tag1) || js_tag_is_string(tag2)) {
     sp[-2] = JS_ConcatString(ctx, op1, op2);
     if (JS_IsException(sp[-2]))
       goto exception;
@@ -1397,6 +1397,13 @@ no_inline int js_relational_slow(JSContext *ctx, JSValue *sp, OPCodeEnum op) {
     JS_FreeValue(ctx, op1);
     goto exception;
   }
+  op1 = js_string_flatten_free(ctx, op1);
+  op2 = js_string_flatten_free(ctx, op2);
+  if (JS_IsException(op1) || JS_IsException(op2)) {
+    JS_FreeValue(ctx, op1);
+    JS_FreeValue(ctx, op2);
+    goto exception;
+  }
   tag1 = JS_VALUE_GET_NORM_TAG(op1);
   tag2 = JS_VALUE_GET_NORM_TAG(op2);
 
@@ -1522,6 +1529,13 @@ no_inline __exception int js_eq_slow(JSContext *ctx, JSValue *sp, BOOL is_neq) {
   op1 = sp[-2];
   op2 = sp[-1];
 redo:
+  op1 = js_string_flatten_free(ctx, op1);
+  op2 = js_string_flatten_free(ctx, op2);
+  if (JS_IsException(op1) || JS_IsException(op2)) {
+    JS_FreeValue(ctx, op1);
+    JS_FreeValue(ctx, op2);
+    goto exception;
+  }
   tag1 = JS_VALUE_GET_NORM_TAG(op1);
   tag2 = JS_VALUE_GET_NORM_TAG(op2);
   if (tag_is_number(tag1) && tag_is_number(tag2)) {
@@ -1817,7 +1831,7 @@ no_inline __exception int js_add_slow(JSContext *ctx, JSValue *sp) {
     }
     tag1 = JS_VALUE_GET_TAG(op1);
     tag2 = JS_VALUE_GET_TAG(op2);
-    if (tag1 == JS_TAG_STRING || tag2 == JS_TAG_STRING) {
+    if (js_tag_is_string(tag1) || js_tag_is_string(tag2)) {
       sp[-2] = JS_ConcatString(ctx, op1, op2);
       if (JS_IsException(sp[-2]))
         goto exception;
@@ -1907,6 +1921,13 @@ no_inline int js_relational_slow(JSContext *ctx, JSValue *sp, OPCodeEnum op) {
     JS_FreeValue(ctx, op1);
     goto exception;
   }
+  op1 = js_string_flatten_free(ctx, op1);
+  op2 = js_string_flatten_free(ctx, op2);
+  if (JS_IsException(op1) || JS_IsException(op2)) {
+    JS_FreeValue(ctx, op1);
+    JS_FreeValue(ctx, op2);
+    goto exception;
+  }
   if (JS_VALUE_GET_TAG(op1) == JS_TAG_STRING &&
       JS_VALUE_GET_TAG(op2) == JS_TAG_STRING) {
     JSString *p1, *p2;
@@ -1970,6 +1991,13 @@ no_inline __exception int js_eq_slow(JSContext *ctx, JSValue *sp, BOOL is_neq) {
   op1 = sp[-2];
   op2 = sp[-1];
 redo:
+  op1 = js_string_flatten_free(ctx, op1);
+  op2 = js_string_flatten_free(ctx, op2);
+  if (JS_IsException(op1) || JS_IsException(op2)) {
+    JS_FreeValue(ctx, op1);
+    JS_FreeValue(ctx, op2);
+    goto exception;
+  }
   tag1 = JS_VALUE_GET_NORM_TAG(op1);
   tag2 = JS_VALUE_GET_NORM_TAG(op2);
   if (tag1 == tag2 || (tag1 == JS_TAG_INT && tag2 == JS_TAG_FLOAT64) ||
@@ -2066,6 +2094,17 @@ BOOL js_strict_eq2(JSContext *ctx, JSValue op1, JSValue op2,
   int tag1, tag2;
   double d1, d2;
 
+  if (unlikely(JS_VALUE_GET_TAG(op1) == JS_TAG_STRING_ROPE ||
+               JS_VALUE_GET_TAG(op2) == JS_TAG_STRING_ROPE)) {
+    op1 = js_string_flatten_free(ctx, op1);
+    op2 = js_string_flatten_free(ctx, op2);
+    if (JS_IsException(op1) || JS_IsException(op2)) {
+      /* XXX: the memory error cannot be reported */
+      JS_FreeValue(ctx, JS_GetException(ctx));
+      res = FALSE;
+      goto done;
+    }
+  }
   tag1 = JS_VALUE_GET_NORM_TAG(op1);
   tag2 = JS_VALUE_GET_NORM_TAG(op2);
   switch (tag1) {
@@ -2201,6 +2240,7 @@ BOOL js_strict_eq2(JSContext *ctx, JSValue op1, JSValue op2,
     res = FALSE;
     break;
   }
+done:
   JS_FreeValue(ctx, op1);
   JS_FreeValue(ctx, op2);
 done_no_free:
@@ -2313,6 +2353,7 @@ __exception int js_operator_typeof(JSContext *ctx, JSValueConst op1) {
     atom = JS_ATOM_boolean;
     break;
   case JS_TAG_STRING:
+  case JS_TAG_STRING_ROPE:
     atom = JS_ATOM_string;
     break;
   case JS_TAG_OBJECT: {
@@ -0,0 +1,389 @@
+#include "prof.h"
+#include "class.h"
+#include "func.h"
+#include "include/quickjs.h"
+#include "libs/cutils.h"
+#include "obj.h"
+#include "str.h"
+#include "utils/dbuf.h"
+#include "vm.h"
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <sys/time.h>
+#include <time.h>
+
+// the callsite of the call tree, functions are identified by their name and
+// location since their objects may be freed during the profiling
+typedef struct JSProfNode {
+  JSAtom name;
+  JSAtom file; /* JS_ATOM_NULL for the native functions */
+  int line;    /* line of the function definition, 0 if unknown */
+  int parent;
+  int first_child; /* -1 if the node has no child */
+  int next_sibling;
+  int hit_count;
+} JSProfNode;
+
+typedef struct JSProfSample {
+  int node;
+  int delta; /* microseconds since the previous sample */
+} JSProfSample;
+
+typedef struct JSCPUProfile {
+  JSProfNode *nodes; /* nodes[0] is the root */
+  int node_count;
+  int node_size;
+  JSProfSample *samples;
+  int sample_count;
+  int sample_size;
+  JSStackFrame **frames; /* scratch buffer to walk the stack */
+  int frame_size;
+  int64_t start_time;
+  int64_t last_time;
+  int tick; /* last tick of the timer seen by this runtime */
+} JSCPUProfile;
+
+// the timer and the signal handler are shared by the runtimes being profiled,
+// the timer only counts its ticks so that each runtime takes a sample when it
+// sees a tick it has not seen yet
+static volatile sig_atomic_t js_prof_ticks;
+static pthread_mutex_t js_prof_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int js_prof_runtime_count; /* runtimes using the timer */
+static int js_prof_interval_us;
+static struct sigaction js_prof_old_action;
+
+static void js_prof_on_timer(int sig) { js_prof_ticks++; }
+
+static int64_t js_prof_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int js_prof_resize(JSRuntime *rt, void **parray, int elem_size,
+                          int *psize, int req_size) {
+  int new_size;
+  void *new_array;
+
+  if (likely(req_size <= *psize))
+    return 0;
+
+  new_size = max_int(req_size, *psize * 3 / 2 + 16);
+  new_array = js_realloc_rt(rt, *parray, (size_t)new_size * elem_size);
+  if (!new_array)
+    return -1;
+  *parray = new_array;
+  *psize = new_size;
+  return 0;
+}
+
+// retrieve the name and the location of the function running in `sf`, the
+// returned atoms should be freed by the caller. Return -1 if `sf` is detached
+static int js_prof_frame_loc(JSRuntime *rt, JSStackFrame *sf, JSAtom *pname,
+                             JSAtom *pfile, int *pline) {
+  JSObject *p;
+  JSProperty *pr;
+  JSShapeProperty *prs;
+
+  if (JS_VALUE_GET_TAG(sf->cur_func) != JS_TAG_OBJECT)
+    return -1;
+
+  p = JS_VALUE_GET_OBJ(sf->cur_func);
+  if (js_class_has_bytecode(p->class_id)) {
+    JSFunctionBytecode *b = p->u.func.function_bytecode;
+    *pname = JS_DupAtomRT(rt, b->func_name);
+    *pfile = b->has_debug ? JS_DupAtomRT(rt, b->debug.filename) : JS_ATOM_NULL;
+    *pline = b->has_debug ? b->debug.line_num : 0;
+    return 0;
+  }
+
+  // the name of the native functions is read directly since the getters
+  // should not be called by the profiler
+  *pname = JS_ATOM_NULL;
+  *pfile = JS_ATOM_NULL;
+  *pline = 0;
+  prs = find_own_property(&pr, p, JS_ATOM_name);
+  if (prs && (prs->flags & JS_PROP_TMASK) == JS_PROP_NORMAL &&
+      JS_VALUE_GET_TAG(pr->u.value) == JS_TAG_STRING) {
+    JSValue str = JS_DupValueRT(rt, pr->u.value);
+    *pname = __JS_NewAtom(rt, JS_VALUE_GET_STRING(str), JS_ATOM_TYPE_STRING);
+  }
+  return 0;
+}
+
+// return the child of `parent` which is called by `sf`, a new node is created
+// if the callsite is not seen before
+static int js_prof_get_child(JSRuntime *rt, JSCPUProfile *prof, int parent,
+                             JSStackFrame *sf) {
+  JSProfNode *node;
+  JSAtom name, file;
+  int i, line;
+
+  if (js_prof_frame_loc(rt, sf, &name, &file, &line))
+    return parent;
+
+  for (i = prof->nodes[parent].first_child; i >= 0;
+       i = prof->nodes[i].next_sibling) {
+    node = &prof->nodes[i];
+    if (node->name == name && node->file == file && node->line == line) {
+      JS_FreeAtomRT(rt, name);
+      JS_FreeAtomRT(rt, file);
+      return i;
+    }
+  }
+
+  if (js_prof_resize(rt, (void **)&prof->nodes, sizeof(prof->nodes[0]),
+                     &prof->node_size, prof->node_count + 1)) {
+    JS_FreeAtomRT(rt, name);
+    JS_FreeAtomRT(rt, file);
+    return -1;
+  }
+
+  i = prof->node_count++;
+  node = &prof->nodes[i];
+  node->name = name;
+  node->file = file;
+  node->line = line;
+  node->parent = parent;
+  node->first_child = -1;
+  node->next_sibling = prof->nodes[parent].first_child;
+  node->hit_count = 0;
+  prof->nodes[parent].first_child = i;
+  return i;
+}
+
+static void js_prof_sample(JSRuntime *rt, JSCPUProfile *prof) {
+  JSStackFrame *sf;
+  JSProfSample *sample;
+  int i, depth = 0, node = 0;
+  int64_t now = js_prof_now();
+
+  for (sf = rt->current_stack_frame; sf != NULL; sf = sf->prev_frame) {
+    if (js_prof_resize(rt, (void **)&prof->frames, sizeof(prof->frames[0]),
+                       &prof->frame_size, depth + 1))
+      return;
+    prof->frames[depth++] = sf;
+  }
+
+  // the call tree grows from the outermost frame
+  for (i = depth - 1; i >= 0; i--) {
+    node = js_prof_get_child(rt, prof, node, prof->frames[i]);
+    if (node < 0)
+      return;
+  }
+
+  if (js_prof_resize(rt, (void **)&prof->samples, sizeof(prof->samples[0]),
+                     &prof->sample_size, prof->sample_count + 1))
+    return;
+
+  prof->nodes[node].hit_count++;
+  sample = &prof->samples[prof->sample_count++];
+  sample->node = node;
+  sample->delta = now - prof->last_time;
+  prof->last_time = now;
+}
+
+void js_prof_poll(JSRuntime *rt) {
+  JSCPUProfile *prof = rt->cpu_profile;
+  int tick = js_prof_ticks;
+
+  if (likely(tick == prof->tick))
+    return;
+
+  prof->tick = tick;
+  js_prof_sample(rt, prof);
+}
+
+static void js_prof_set_timer(int interval_us) {
+  struct itimerval timer;
+
+  timer.it_interval.tv_sec = interval_us / 1000000;
+  timer.it_interval.tv_usec = interval_us % 1000000;
+  timer.it_value = timer.it_interval;
+  setitimer(ITIMER_PROF, &timer, NULL);
+}
+
+// the timer runs at the smallest interval requested by the runtimes
+static int js_prof_start_timer(int interval_us) {
+  struct sigaction sa;
+  int ret = 0;
+
+  pthread_mutex_lock(&js_prof_mutex);
+  if (js_prof_runtime_count == 0) {
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = js_prof_on_timer;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGPROF, &sa, &js_prof_old_action)) {
+      ret = -1;
+      goto done;
+    }
+    js_prof_interval_us = interval_us;
+    js_prof_set_timer(interval_us);
+  } else if (interval_us < js_prof_interval_us) {
+    js_prof_interval_us = interval_us;
+    js_prof_set_timer(interval_us);
+  }
+  js_prof_runtime_count++;
+done:
+  pthread_mutex_unlock(&js_prof_mutex);
+  return ret;
+}
+
+static void js_prof_stop_timer(void) {
+  pthread_mutex_lock(&js_prof_mutex);
+  if (--js_prof_runtime_count == 0) {
+    js_prof_set_timer(0);
+    sigaction(SIGPROF, &js_prof_old_action, NULL);
+  }
+  pthread_mutex_unlock(&js_prof_mutex);
+}
+
+int JS_StartCPUProfile(JSRuntime *rt, int interval_us) {
+  JSCPUProfile *prof;
+
+  if (rt->cpu_profile || interval_us <= 0)
+    return -1;
+
+  prof = js_mallocz_rt(rt, sizeof(*prof));
+  if (!prof)
+    return -1;
+
+  if (js_prof_resize(rt, (void **)&prof->nodes, sizeof(prof->nodes[0]),
+                     &prof->node_size, 1)) {
+    js_free_rt(rt, prof);
+    return -1;
+  }
+  prof->node_count = 1;
+  prof->nodes[0].name = JS_ATOM_NULL;
+  prof->nodes[0].file = JS_ATOM_NULL;
+  prof->nodes[0].line = 0;
+  prof->nodes[0].hit_count = 0;
+  prof->nodes[0].parent = -1;
+  prof->nodes[0].first_child = -1;
+  prof->nodes[0].next_sibling = -1;
+
+  if (js_prof_start_timer(interval_us)) {
+    js_free_rt(rt, prof->nodes);
+    js_free_rt(rt, prof);
+    return -1;
+  }
+
+  prof->tick = js_prof_ticks;
+  prof->start_time = prof->last_time = js_prof_now();
+  rt->cpu_profile = prof;
+  return 0;
+}
+
+static void js_prof_put_str(DynBuf *dbuf, const char *str) {
+  dbuf_putc(dbuf, '"');
+  for (; *str; str++) {
+    if (*str == '"' || *str == '\\')
+      dbuf_printf(dbuf, "\\%c", *str);
+    else if ((uint8_t)*str < 0x20)
+      dbuf_printf(dbuf, "\\u%04x", (uint8_t)*str);
+    else
+      dbuf_putc(dbuf, *str);
+  }
+  dbuf_putc(dbuf, '"');
+}
+
+static void js_prof_put_node(JSRuntime *rt, DynBuf *dbuf, JSCPUProfile *prof,
+                             int i) {
+  JSProfNode *node = &prof->nodes[i];
+  char buf[ATOM_GET_STR_BUF_SIZE];
+  const char *name;
+  int child;
+
+  if (i == 0)
+    name = "(root)";
+  else if (node->name == JS_ATOM_NULL || node->name == JS_ATOM_empty_string)
+    name = "(anonymous)";
+  else
+    name = JS_AtomGetStrRT(rt, buf, sizeof(buf), node->name);
+
+  dbuf_printf(dbuf, "    {\"id\":%d,\"callFrame\":{\"functionName\":", i + 1);
+  js_prof_put_str(dbuf, name);
+  dbuf_printf(dbuf, ",\"scriptId\":\"%u\",\"url\":", node->file);
+  js_prof_put_str(dbuf, node->file == JS_ATOM_NULL
+                            ? ""
+                            : JS_AtomGetStrRT(rt, buf, sizeof(buf), node->file));
+  // the line numbers of `.cpuprofile` are zero-based
+  dbuf_printf(dbuf, ",\"lineNumber\":%d,\"columnNumber\":-1}", node->line - 1);
+  dbuf_printf(dbuf, ",\"hitCount\":%d,\"children\":[", node->hit_count);
+  for (child = node->first_child; child >= 0;
+       child = prof->nodes[child].next_sibling) {
+    dbuf_printf(dbuf, "%d%s", child + 1,
+                prof->nodes[child].next_sibling >= 0 ? "," : "");
+  }
+  dbuf_printf(dbuf, "]}%s\n", i != prof->node_count - 1 ? "," : "");
+}
+
+static int js_prof_write2file(JSRuntime *rt, JSCPUProfile *prof,
+                              const char *filename, int64_t end_time) {
+  DynBuf dbuf;
+  FILE *fp;
+  int i, ret = -1;
+
+  dbuf_init2(&dbuf, rt, (DynBufReallocFunc *)js_realloc_rt);
+
+  dbuf_putstr(&dbuf, "{\n  \"nodes\": [\n");
+  for (i = 0; i < prof->node_count; i++)
+    js_prof_put_node(rt, &dbuf, prof, i);
+  dbuf_putstr(&dbuf, "  ],\n");
+
+  dbuf_printf(&dbuf, "  \"startTime\": %" PRId64 ",\n", prof->start_time);
+  dbuf_printf(&dbuf, "  \"endTime\": %" PRId64 ",\n", end_time);
+
+  dbuf_putstr(&dbuf, "  \"samples\": [");
+  for (i = 0; i < prof->sample_count; i++)
+    dbuf_printf(&dbuf, "%s%d", i ? "," : "", prof->samples[i].node + 1);
+  dbuf_putstr(&dbuf, "],\n");
+
+  dbuf_putstr(&dbuf, "  \"timeDeltas\": [");
+  for (i = 0; i < prof->sample_count; i++)
+    dbuf_printf(&dbuf, "%s%d", i ? "," : "", prof->samples[i].delta);
+  dbuf_putstr(&dbuf, "]\n}\n");
+
+  if (dbuf_error(&dbuf))
+    goto done;
+
+  fp = fopen(filename, "w");
+  if (!fp)
+    goto done;
+  if (fwrite(dbuf.buf, 1, dbuf.size, fp) == dbuf.size)
+    ret = 0;
+  if (fclose(fp))
+    ret = -1;
+
+done:
+  dbuf_free(&dbuf);
+  return ret;
+}
+
+int JS_StopCPUProfile(JSRuntime *rt, const char *filename) {
+  JSCPUProfile *prof = rt->cpu_profile;
+  int64_t end_time;
+  int i, ret = 0;
+
+  if (!prof)
+    return -1;
+
+  js_prof_stop_timer();
+  rt->cpu_profile = NULL;
+  end_time = js_prof_now();
+
+  if (filename)
+    ret = js_prof_write2file(rt, prof, filename, end_time);
+
+  for (i = 0; i < prof->node_count; i++) {
+    JS_FreeAtomRT(rt, prof->nodes[i].name);
+    JS_FreeAtomRT(rt, prof->nodes[i].file);
+  }
+  js_free_rt(rt, prof->nodes);
+  js_free_rt(rt, prof->samples);
+  js_free_rt(rt, prof->frames);
+  js_free_rt(rt, prof);
+  return ret;
+}
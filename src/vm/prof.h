@@ -0,0 +1,19 @@
+#ifndef QUICKJS_PROF_H
+#define QUICKJS_PROF_H
+
+#include "def.h"
+
+// the CPU profiler (JS_StartCPUProfile()) samples the stack frames of the
+// running script every `interval_us` microseconds of CPU time, the timer only
+// counts its ticks and the stack is walked by the next interrupt poll which
+// sees a new tick, the samples are aggregated into a call tree keyed by the
+// function name and location
+
+// the interrupt counter is reset to this value while profiling so that a tick
+// is seen soon after it is raised
+#define JS_PROF_INTERRUPT_COUNTER_INIT 100
+
+// called by the interrupt poll when `rt->cpu_profile` is set
+void js_prof_poll(JSRuntime *rt);
+
+#endif
@@ -1,5 +1,6 @@
 #include "shape.h"
 
+#include "gc.h"
 #include "obj.h"
 #include "str.h"
 #include "vm.h"
@@ -90,7 +91,7 @@ no_inline JSShape *js_new_shape2(JSContext *ctx, JSObject *proto, int hash_size,
     resize_shape_hash(rt, rt->shape_hash_bits + 1);
   }
 
-  sh_alloc = js_malloc(ctx, get_shape_size(hash_size, prop_size));
+  sh_alloc = js_slab_alloc(ctx, get_shape_size(hash_size, prop_size));
   if (!sh_alloc)
     return NULL;
   sh = get_shape_from_alloc(sh_alloc, hash_size);
@@ -110,6 +111,7 @@ no_inline JSShape *js_new_shape2(JSContext *ctx, JSObject *proto, int hash_size,
   sh->hash = shape_initial_hash(proto);
   sh->is_hashed = TRUE;
   sh->has_small_array_index = FALSE;
+  sh->id = js_new_shape_id(rt);
   js_shape_hash_link(ctx->rt, sh);
   return sh;
 }
@@ -130,7 +132,7 @@ JSShape *js_clone_shape(JSContext *ctx, JSShape *sh1) {
 
   hash_size = sh1->prop_hash_mask + 1;
   size = get_shape_size(hash_size, sh1->prop_size);
-  sh_alloc = js_malloc(ctx, size);
+  sh_alloc = js_slab_alloc(ctx, size);
   if (!sh_alloc)
     return NULL;
   sh_alloc1 = get_alloc_from_shape(sh1);
@@ -139,6 +141,7 @@ JSShape *js_clone_shape(JSContext *ctx, JSShape *sh1) {
   sh->header.ref_count = 1;
   add_gc_object(ctx->rt, &sh->header, JS_GC_OBJ_TYPE_SHAPE);
   sh->is_hashed = FALSE;
+  sh->id = js_new_shape_id(ctx->rt);
   if (sh->proto) {
     JS_DupValue(ctx, JS_MKPTR(JS_TAG_OBJECT, sh->proto));
   }
@@ -169,12 +172,15 @@ void js_free_shape0(JSRuntime *rt, JSShape *sh) {
     pr++;
   }
   remove_gc_object(&sh->header);
-  js_free_rt(rt, get_alloc_from_shape(sh));
+  js_slab_free_rt(rt, get_alloc_from_shape(sh),
+                  get_shape_size(sh->prop_hash_mask + 1, sh->prop_size));
 }
 
 void js_free_shape(JSRuntime *rt, JSShape *sh) {
   if (unlikely(--sh->header.ref_count <= 0)) {
     js_free_shape0(rt, sh);
+  } else {
+    gc_add_possible_root(rt, &sh->header);
   }
 }
 
@@ -210,7 +216,7 @@ no_inline int resize_properties(JSContext *ctx, JSShape **psh, JSObject *p,
     JSShape *old_sh;
     /* resize the hash table and the properties */
     old_sh = sh;
-    sh_alloc = js_malloc(ctx, get_shape_size(new_hash_size, new_size));
+    sh_alloc = js_slab_alloc(ctx, get_shape_size(new_hash_size, new_size));
     if (!sh_alloc)
       return -1;
     sh = get_shape_from_alloc(sh_alloc, new_hash_size);
@@ -218,7 +224,7 @@ no_inline int resize_properties(JSContext *ctx, JSShape **psh, JSObject *p,
     /* copy all the fields and the properties */
     memcpy(sh, old_sh,
            sizeof(JSShape) + sizeof(sh->prop[0]) * old_sh->prop_count);
-    list_add_tail(&sh->header.link, &ctx->rt->gc_obj_list);
+    gc_relink_object(ctx->rt, &sh->header);
     new_hash_mask = new_hash_size - 1;
     sh->prop_hash_mask = new_hash_mask;
     memset(prop_hash_end(sh) - new_hash_size, 0,
@@ -230,19 +236,22 @@ no_inline int resize_properties(JSContext *ctx, JSShape **psh, JSObject *p,
         prop_hash_end(sh)[-h - 1] = i + 1;
       }
     }
-    js_free(ctx, get_alloc_from_shape(old_sh));
+    js_slab_free_rt(ctx->rt, get_alloc_from_shape(old_sh),
+                    get_shape_size(old_sh->prop_hash_mask + 1,
+                                   old_sh->prop_size));
   } else {
     /* only resize the properties */
     list_del(&sh->header.link);
-    sh_alloc = js_realloc(ctx, get_alloc_from_shape(sh),
-                          get_shape_size(new_hash_size, new_size));
+    sh_alloc = js_slab_realloc(ctx, get_alloc_from_shape(sh),
+                               get_shape_size(new_hash_size, sh->prop_size),
+                               get_shape_size(new_hash_size, new_size));
     if (unlikely(!sh_alloc)) {
       /* insert again in the GC list */
-      list_add_tail(&sh->header.link, &ctx->rt->gc_obj_list);
+      gc_relink_object(ctx->rt, &sh->header);
       return -1;
     }
     sh = get_shape_from_alloc(sh_alloc, new_hash_size);
-    list_add_tail(&sh->header.link, &ctx->rt->gc_obj_list);
+    gc_relink_object(ctx->rt, &sh->header);
   }
   *psh = sh;
   sh->prop_size = new_size;
@@ -272,13 +281,13 @@ int compact_properties(JSContext *ctx, JSObject *p) {
 
   /* resize the hash table and the properties */
   old_sh = sh;
-  sh_alloc = js_malloc(ctx, get_shape_size(new_hash_size, new_size));
+  sh_alloc = js_slab_alloc(ctx, get_shape_size(new_hash_size, new_size));
   if (!sh_alloc)
     return -1;
   sh = get_shape_from_alloc(sh_alloc, new_hash_size);
   list_del(&old_sh->header.link);
   memcpy(sh, old_sh, sizeof(JSShape));
-  list_add_tail(&sh->header.link, &ctx->rt->gc_obj_list);
+  gc_relink_object(ctx->rt, &sh->header);
 
   memset(prop_hash_end(sh) - new_hash_size, 0,
          sizeof(prop_hash_end(sh)[0]) * new_hash_size);
@@ -305,9 +314,11 @@ int compact_properties(JSContext *ctx, JSObject *p) {
   sh->prop_size = new_size;
   sh->deleted_prop_count = 0;
   sh->prop_count = j;
+  sh->id = js_new_shape_id(ctx->rt);
 
   p->shape = sh;
-  js_free(ctx, get_alloc_from_shape(old_sh));
+  js_slab_free_rt(ctx->rt, get_alloc_from_shape(old_sh),
+                  get_shape_size(old_sh->prop_hash_mask + 1, old_sh->prop_size));
 
   /* reduce the size of the object properties */
   new_prop = js_realloc(ctx, p->prop, sizeof(new_prop[0]) * new_size);
@@ -356,6 +367,7 @@ int add_shape_property(JSContext *ctx, JSShape **psh, JSObject *p, JSAtom atom,
   h = atom & hash_mask;
   pr->hash_next = prop_hash_end(sh)[-h - 1];
   prop_hash_end(sh)[-h - 1] = sh->prop_count;
+  sh->id = js_new_shape_id(rt);
   return 0;
 }
 
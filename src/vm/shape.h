@@ -24,6 +24,11 @@ struct JSShape {
      <= n <= 2^31-1. If false, the shape is guaranteed not to have
      small array index properties */
   uint8_t has_small_array_index;
+  /* changed whenever the properties are modified in place, including when
+     a property is appended, so the inline caches recording (shape, id) are
+     invalidated. A cache holding a prototype lookup relies on the appended
+     property too since it may shadow the prototype */
+  uint32_t id;
   uint32_t hash; /* current hash value */
   uint32_t prop_hash_mask;
   int prop_size;  /* allocated properties */
@@ -43,6 +48,10 @@ static inline JSShape *get_shape_from_alloc(void *sh_alloc, size_t hash_size) {
   return (JSShape *)(void *)((uint32_t *)sh_alloc + hash_size);
 }
 
+static inline uint32_t js_new_shape_id(JSRuntime *rt) {
+  return ++rt->shape_id;
+}
+
 static inline uint32_t *prop_hash_end(JSShape *sh) { return (uint32_t *)sh; }
 
 static inline void *get_alloc_from_shape(JSShape *sh) {
@@ -8,8 +8,7 @@
 /* Note: the string contents are uninitialized */
 JSString *js_alloc_string_rt(JSRuntime *rt, int max_len, int is_wide_char) {
   JSString *str;
-  str = js_malloc_rt(rt, sizeof(JSString) + (max_len << is_wide_char) + 1 -
-                             is_wide_char);
+  str = js_slab_alloc_rt(rt, js_string_alloc_size(max_len, is_wide_char));
   if (unlikely(!str))
     return NULL;
   str->header.ref_count = 1;
@@ -124,14 +123,41 @@ int string_buffer_init2(JSContext *ctx, StringBuffer *s, int size,
   return 0;
 }
 
-void string_buffer_free(StringBuffer *s) {
-  js_free(s->ctx, s->str);
-  s->str = NULL;
+/* the string of the buffer holds 's->size' characters */
+static size_t string_buffer_alloc_size(StringBuffer *s) {
+  return js_string_alloc_size(s->size, s->is_wide_char);
+}
+
+static void string_buffer_free_str(StringBuffer *s) {
+  if (s->str) {
+    js_slab_free_rt(s->ctx->rt, s->str, string_buffer_alloc_size(s));
+    s->str = NULL;
+  }
+}
+
+/* reallocate the string of the buffer for 'size' characters. Return the
+   number of characters which fit in the new allocation or -1 if error */
+static int string_buffer_realloc_str(StringBuffer *s, int size, int is_wide) {
+  JSRuntime *rt = s->ctx->rt;
+  size_t old_size, new_size, slack = 0;
+  JSString *str;
+
+  old_size = string_buffer_alloc_size(s);
+  new_size = js_string_alloc_size(size, is_wide);
+  if (js_slab_has_size(rt, old_size) || js_slab_has_size(rt, new_size))
+    str = js_slab_realloc(s->ctx, s->str, old_size, new_size);
+  else
+    str = js_realloc2(s->ctx, s->str, new_size, &slack);
+  if (!str)
+    return -1;
+  s->str = str;
+  return min_int(size + (slack >> is_wide), JS_STRING_LEN_MAX);
 }
 
+void string_buffer_free(StringBuffer *s) { string_buffer_free_str(s); }
+
 int string_buffer_set_error(StringBuffer *s) {
-  js_free(s->ctx, s->str);
-  s->str = NULL;
+  string_buffer_free_str(s);
   s->size = 0;
   s->len = 0;
   return s->error_status = -1;
@@ -139,29 +165,25 @@ int string_buffer_set_error(StringBuffer *s) {
 
 no_inline int string_buffer_widen(StringBuffer *s, int size) {
   JSString *str;
-  size_t slack;
   int i;
 
   if (s->error_status)
     return -1;
 
-  str = js_realloc2(s->ctx, s->str, sizeof(JSString) + (size << 1), &slack);
-  if (!str)
+  size = string_buffer_realloc_str(s, size, 1);
+  if (size < 0)
     return string_buffer_set_error(s);
-  size += slack >> 1;
+  str = s->str;
   for (i = s->len; i-- > 0;) {
     str->u.str16[i] = str->u.str8[i];
   }
   s->is_wide_char = 1;
   s->size = size;
-  s->str = str;
   return 0;
 }
 
 no_inline int string_buffer_realloc(StringBuffer *s, int new_len, int c) {
-  JSString *new_str;
   int new_size;
-  size_t new_size_bytes, slack;
 
   if (s->error_status)
     return -1;
@@ -174,14 +196,10 @@ no_inline int string_buffer_realloc(StringBuffer *s, int new_len, int c) {
   if (!s->is_wide_char && c >= 0x100) {
     return string_buffer_widen(s, new_size);
   }
-  new_size_bytes =
-      sizeof(JSString) + (new_size << s->is_wide_char) + 1 - s->is_wide_char;
-  new_str = js_realloc2(s->ctx, s->str, new_size_bytes, &slack);
-  if (!new_str)
+  new_size = string_buffer_realloc_str(s, new_size, s->is_wide_char);
+  if (new_size < 0)
     return string_buffer_set_error(s);
-  new_size = min_int(new_size + (slack >> s->is_wide_char), JS_STRING_LEN_MAX);
   s->size = new_size;
-  s->str = new_str;
   return 0;
 }
 
@@ -385,19 +403,26 @@ JSValue string_buffer_end(StringBuffer *s) {
   if (s->error_status)
     return JS_EXCEPTION;
   if (s->len == 0) {
-    js_free(s->ctx, str);
-    s->str = NULL;
+    string_buffer_free_str(s);
     return JS_AtomToString(s->ctx, JS_ATOM_empty_string);
   }
   if (s->len < s->size) {
-    /* smaller size so js_realloc should not fail, but OK if it does */
-    /* XXX: should add some slack to avoid unnecessary calls */
-    /* XXX: might need to use malloc+free to ensure smaller size */
-    str = js_realloc_rt(s->ctx->rt, str,
-                        sizeof(JSString) + (s->len << s->is_wide_char) + 1 -
-                            s->is_wide_char);
-    if (str == NULL)
-      str = s->str;
+    size_t size = js_string_alloc_size(s->len, s->is_wide_char);
+    if (js_slab_has_size(s->ctx->rt, size)) {
+      /* the slab block must match the final length */
+      str = js_slab_realloc(s->ctx, str, string_buffer_alloc_size(s), size);
+      if (!str) {
+        string_buffer_free_str(s);
+        return JS_EXCEPTION;
+      }
+    } else {
+      /* smaller size so js_realloc should not fail, but OK if it does */
+      /* XXX: should add some slack to avoid unnecessary calls */
+      /* XXX: might need to use malloc+free to ensure smaller size */
+      str = js_realloc_rt(s->ctx->rt, str, size);
+      if (str == NULL)
+        str = s->str;
+    }
     s->str = str;
   }
   if (!s->is_wide_char)
@@ -572,34 +597,188 @@ static JSValue JS_ConcatString1(JSContext *ctx, const JSString *p1,
   return JS_MKPTR(JS_TAG_STRING, p);
 }
 
-/* op1 and op2 are converted to strings. For convience, op1 or op2 =
-   JS_EXCEPTION are accepted and return JS_EXCEPTION.  */
-JSValue JS_ConcatString(JSContext *ctx, JSValue op1, JSValue op2) {
-  JSValue ret;
-  JSString *p1, *p2;
+/* Rope strings */
 
-  if (unlikely(JS_VALUE_GET_TAG(op1) != JS_TAG_STRING)) {
-    op1 = JS_ToStringFree(ctx, op1);
-    if (JS_IsException(op1)) {
-      JS_FreeValue(ctx, op2);
-      return JS_EXCEPTION;
+/* when both children of a new rope are deeper than this, the shallowest
+   one is flattened. It bounds the recursion depth when copying and
+   freeing the ropes, the other child being handled by a loop */
+#define JS_STRING_ROPE_DEPTH_MAX 32
+
+static inline uint32_t js_rope_depth(JSValueConst val) {
+  if (JS_VALUE_GET_TAG(val) == JS_TAG_STRING_ROPE)
+    return ((JSStringRope *)JS_VALUE_GET_PTR(val))->depth;
+  return 0;
+}
+
+/* copy the characters of the string or rope 'val' so that they end at
+   'end' in 'dst' */
+static void js_rope_copy(JSString *dst, uint32_t end, JSValueConst val) {
+  JSStringRope *r;
+  JSString *p;
+  JSValueConst left, right;
+
+  for (;;) {
+    if (JS_VALUE_GET_TAG(val) == JS_TAG_STRING) {
+      p = JS_VALUE_GET_STRING(val);
+      end -= p->len;
+      if (!dst->is_wide_char)
+        memcpy(dst->u.str8 + end, p->u.str8, p->len);
+      else
+        copy_str16(dst->u.str16 + end, p, 0, p->len);
+      return;
+    }
+    r = JS_VALUE_GET_PTR(val);
+    if (r->depth == 0) {
+      val = r->left;
+      continue;
+    }
+    left = r->left;
+    right = r->right;
+    if (js_rope_depth(left) < js_rope_depth(right)) {
+      js_rope_copy(dst, end - js_string_value_len(right), left);
+      val = right;
+    } else {
+      js_rope_copy(dst, end, right);
+      end -= js_string_value_len(right);
+      val = left;
     }
   }
-  if (unlikely(JS_VALUE_GET_TAG(op2) != JS_TAG_STRING)) {
-    op2 = JS_ToStringFree(ctx, op2);
-    if (JS_IsException(op2)) {
-      JS_FreeValue(ctx, op1);
+}
+
+JSValue js_rope_flatten(JSContext *ctx, JSValueConst val) {
+  JSStringRope *r = JS_VALUE_GET_PTR(val);
+  JSString *p;
+
+  if (r->depth != 0) {
+    p = js_alloc_string(ctx, r->len, r->is_wide_char);
+    if (!p)
       return JS_EXCEPTION;
+    js_rope_copy(p, r->len, val);
+    if (!p->is_wide_char)
+      p->u.str8[r->len] = '\0';
+    JS_FreeValue(ctx, r->left);
+    JS_FreeValue(ctx, r->right);
+    r->left = JS_MKPTR(JS_TAG_STRING, p);
+    r->right = JS_UNDEFINED;
+    r->depth = 0;
+  }
+  return JS_DupValue(ctx, r->left);
+}
+
+void js_free_rope(JSRuntime *rt, JSStringRope *r) {
+  JSValue left, right;
+
+  for (;;) {
+    left = r->left;
+    right = r->right;
+    js_slab_free_rt(rt, r, sizeof(*r));
+    /* the deepest child is freed by the loop */
+    if (js_rope_depth(left) < js_rope_depth(right)) {
+      JS_FreeValueRT(rt, left);
+      left = right;
+    } else {
+      JS_FreeValueRT(rt, right);
+    }
+    if (JS_VALUE_GET_TAG(left) != JS_TAG_STRING_ROPE) {
+      JS_FreeValueRT(rt, left);
+      break;
     }
+    r = JS_VALUE_GET_PTR(left);
+    if (--r->header.ref_count > 0)
+      break;
   }
-  p1 = JS_VALUE_GET_STRING(op1);
-  p2 = JS_VALUE_GET_STRING(op2);
+}
 
-  /* XXX: could also check if p1 is empty */
-  if (p2->len == 0) {
-    goto ret_op1;
+/* 'op1' and 'op2' are non empty strings or ropes. They are freed. */
+static JSValue js_new_rope(JSContext *ctx, JSValue op1, JSValue op2) {
+  JSStringRope *r;
+  JSValue *pop;
+  uint32_t len1, len2, depth1, depth2;
+  int is_wide_char;
+
+  len1 = js_string_value_len(op1);
+  len2 = js_string_value_len(op2);
+  if (len1 + len2 > JS_STRING_LEN_MAX) {
+    JS_ThrowInternalError(ctx, "string too long");
+    goto fail;
+  }
+  depth1 = js_rope_depth(op1);
+  depth2 = js_rope_depth(op2);
+  if (min_uint32(depth1, depth2) > JS_STRING_ROPE_DEPTH_MAX) {
+    pop = depth1 < depth2 ? &op1 : &op2;
+    *pop = JS_ToStringFree(ctx, *pop);
+    if (JS_IsException(*pop))
+      goto fail;
+    if (pop == &op1)
+      depth1 = 0;
+    else
+      depth2 = 0;
+  }
+  r = js_slab_alloc(ctx, sizeof(*r));
+  if (!r)
+    goto fail;
+  r->header.ref_count = 1;
+  r->len = len1 + len2;
+  is_wide_char = 0;
+  if (JS_VALUE_GET_TAG(op1) == JS_TAG_STRING_ROPE)
+    is_wide_char |= ((JSStringRope *)JS_VALUE_GET_PTR(op1))->is_wide_char;
+  else
+    is_wide_char |= JS_VALUE_GET_STRING(op1)->is_wide_char;
+  if (JS_VALUE_GET_TAG(op2) == JS_TAG_STRING_ROPE)
+    is_wide_char |= ((JSStringRope *)JS_VALUE_GET_PTR(op2))->is_wide_char;
+  else
+    is_wide_char |= JS_VALUE_GET_STRING(op2)->is_wide_char;
+  r->is_wide_char = is_wide_char;
+  r->depth = max_uint32(depth1, depth2) + 1;
+  r->left = op1;
+  r->right = op2;
+  return JS_MKPTR(JS_TAG_STRING_ROPE, r);
+fail:
+  JS_FreeValue(ctx, op1);
+  JS_FreeValue(ctx, op2);
+  return JS_EXCEPTION;
+}
+
+/* Append the string 'op2' to the string or rope 'op1' if it can be done
+   without allocating a new string or rope, which requires 'op1' not to be
+   shared. Return 1 if done, 0 if not possible and -1 if exception. 'op1'
+   and 'op2' are not freed. */
+int JS_ConcatStringInPlace(JSContext *ctx, JSValueConst op1,
+                           JSValueConst op2) {
+  JSString *p1, *p2;
+  JSStringRope *r;
+  JSValue right;
+
+  if (JS_VALUE_GET_TAG(op2) != JS_TAG_STRING)
+    return 0;
+  p2 = JS_VALUE_GET_STRING(op2);
+  if (JS_VALUE_GET_TAG(op1) == JS_TAG_STRING_ROPE) {
+    /* append a short string to the last child of the rope, so that the
+       loops adding short strings do not create one rope per string */
+    r = JS_VALUE_GET_PTR(op1);
+    if (r->header.ref_count != 1 || r->depth == 0 ||
+        JS_VALUE_GET_TAG(r->right) != JS_TAG_STRING ||
+        js_string_value_len(r->right) + p2->len >= JS_STRING_ROPE_SHORT_LEN)
+      return 0;
+    if (!JS_ConcatStringInPlace(ctx, r->right, op2)) {
+      right = JS_ConcatString(ctx, JS_DupValue(ctx, r->right),
+                              JS_DupValue(ctx, op2));
+      if (JS_IsException(right))
+        return -1;
+      JS_FreeValue(ctx, r->right);
+      r->right = right;
+    }
+    r->len += p2->len;
+    r->is_wide_char |= p2->is_wide_char;
+    return 1;
   }
-  if (p1->header.ref_count == 1 && p1->is_wide_char == p2->is_wide_char &&
+  if (JS_VALUE_GET_TAG(op1) != JS_TAG_STRING)
+    return 0;
+  p1 = JS_VALUE_GET_STRING(op1);
+  if (p1->header.ref_count == 1 && p1->atom_type == 0 &&
+      p1->is_wide_char == p2->is_wide_char &&
+      !js_slab_has_size(ctx->rt,
+                        js_string_alloc_size(p1->len, p1->is_wide_char)) &&
       js_malloc_usable_size(ctx, p1) >=
           sizeof(*p1) + ((p1->len + p2->len) << p2->is_wide_char) + 1 -
               p1->is_wide_char) {
@@ -612,11 +791,60 @@ JSValue JS_ConcatString(JSContext *ctx, JSValue op1, JSValue op2) {
       p1->len += p2->len;
       p1->u.str8[p1->len] = '\0';
     }
+    return 1;
+  }
+  return 0;
+}
+
+/* op1 and op2 are converted to strings. For convience, op1 or op2 =
+   JS_EXCEPTION are accepted and return JS_EXCEPTION. The result is a
+   rope if it is long enough. */
+JSValue JS_ConcatString(JSContext *ctx, JSValue op1, JSValue op2) {
+  JSValue ret;
+  uint32_t len1, len2;
+  int res;
+
+  if (unlikely(JS_VALUE_GET_TAG(op1) != JS_TAG_STRING &&
+               JS_VALUE_GET_TAG(op1) != JS_TAG_STRING_ROPE)) {
+    op1 = JS_ToStringFree(ctx, op1);
+    if (JS_IsException(op1)) {
+      JS_FreeValue(ctx, op2);
+      return JS_EXCEPTION;
+    }
+  }
+  if (unlikely(JS_VALUE_GET_TAG(op2) != JS_TAG_STRING &&
+               JS_VALUE_GET_TAG(op2) != JS_TAG_STRING_ROPE)) {
+    op2 = JS_ToStringFree(ctx, op2);
+    if (JS_IsException(op2)) {
+      JS_FreeValue(ctx, op1);
+      return JS_EXCEPTION;
+    }
+  }
+  len1 = js_string_value_len(op1);
+  len2 = js_string_value_len(op2);
+  if (len2 == 0)
+    goto ret_op1;
+  if (len1 == 0) {
+    JS_FreeValue(ctx, op1);
+    return op2;
+  }
+  res = JS_ConcatStringInPlace(ctx, op1, op2);
+  if (res < 0) {
+    JS_FreeValue(ctx, op1);
+    JS_FreeValue(ctx, op2);
+    return JS_EXCEPTION;
+  }
+  if (res > 0) {
   ret_op1:
     JS_FreeValue(ctx, op2);
     return op1;
   }
-  ret = JS_ConcatString1(ctx, p1, p2);
+  if (JS_VALUE_GET_TAG(op1) == JS_TAG_STRING_ROPE ||
+      JS_VALUE_GET_TAG(op2) == JS_TAG_STRING_ROPE ||
+      len1 + len2 >= JS_STRING_ROPE_SHORT_LEN)
+    return js_new_rope(ctx, op1, op2);
+  ret = JS_ConcatString1(ctx, JS_VALUE_GET_STRING(op1),
+                         JS_VALUE_GET_STRING(op2));
   JS_FreeValue(ctx, op1);
   JS_FreeValue(ctx, op2);
   return ret;
@@ -900,11 +1128,12 @@ JSAtom __JS_NewAtom(JSRuntime *rt, JSString *str, int atom_type) {
     start = rt->atom_size;
     if (start == 0) {
       /* JS_ATOM_NULL entry */
-      p = js_mallocz_rt(rt, sizeof(JSAtomStruct));
+      p = js_slab_alloc_rt(rt, js_string_alloc_size(0, 0));
       if (!p) {
         js_free_rt(rt, new_array);
         goto fail;
       }
+      memset(p, 0, sizeof(JSAtomStruct));
       p->header.ref_count = 1; /* not refcounted */
       p->atom_type = JS_ATOM_TYPE_SYMBOL;
 #ifdef DUMP_LEAKS
@@ -932,8 +1161,8 @@ JSAtom __JS_NewAtom(JSRuntime *rt, JSString *str, int atom_type) {
       p = str;
       p->atom_type = atom_type;
     } else {
-      p = js_malloc_rt(rt, sizeof(JSString) + (str->len << str->is_wide_char) +
-                               1 - str->is_wide_char);
+      p = js_slab_alloc_rt(rt,
+                           js_string_alloc_size(str->len, str->is_wide_char));
       if (unlikely(!p))
         goto fail;
       p->header.ref_count = 1;
@@ -947,7 +1176,8 @@ JSAtom __JS_NewAtom(JSRuntime *rt, JSString *str, int atom_type) {
       js_free_string(rt, str);
     }
   } else {
-    p = js_malloc_rt(rt, sizeof(JSAtomStruct)); /* empty wide string */
+    /* empty wide string */
+    p = js_slab_alloc_rt(rt, js_string_alloc_size(0, 1));
     if (!p)
       return JS_ATOM_NULL;
     p->header.ref_count = 1;
@@ -1046,7 +1276,7 @@ void JS_FreeAtomStruct(JSRuntime *rt, JSAtomStruct *p) {
 #ifdef DUMP_LEAKS
   list_del(&p->link);
 #endif
-  js_free_rt(rt, p);
+  js_free_string_struct(rt, p);
   rt->atom_count--;
   assert(rt->atom_count >= 0);
 }
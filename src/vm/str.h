@@ -3,6 +3,7 @@
 
 #include "def.h"
 
+#include "gc.h"
 #include "utils/char.h"
 
 /* -- JSString ----------------------------------- */
@@ -28,6 +29,17 @@ typedef struct JSString {
   } u;
 } JSString;
 
+/* allocated size of a string of 'len' characters. The length of a string
+   is not reduced after its allocation, so that the short strings can be
+   given back to the slabs */
+static inline size_t js_string_alloc_size(int len, int is_wide_char) {
+  return sizeof(JSString) + (len << is_wide_char) + 1 - is_wide_char;
+}
+
+static inline void js_free_string_struct(JSRuntime *rt, JSString *str) {
+  js_slab_free_rt(rt, str, js_string_alloc_size(str->len, str->is_wide_char));
+}
+
 /* Note: the string contents are uninitialized */
 JSString *js_alloc_string_rt(JSRuntime *rt, int max_len, int is_wide_char);
 JSString *js_alloc_string(JSContext *ctx, int max_len, int is_wide_char);
@@ -41,7 +53,7 @@ static inline void js_free_string(JSRuntime *rt, JSString *str) {
 #ifdef DUMP_LEAKS
       list_del(&str->link);
 #endif
-      js_free_rt(rt, str);
+      js_free_string_struct(rt, str);
     }
   }
 }
@@ -52,6 +64,8 @@ JSValue js_new_string_char(JSContext *ctx, uint16_t c);
 int string_get(const JSString *p, int idx);
 
 JSValue JS_ConcatString(JSContext *ctx, JSValue op1, JSValue op2);
+int JS_ConcatStringInPlace(JSContext *ctx, JSValueConst op1,
+                           JSValueConst op2);
 JSValue JS_ConcatString3(JSContext *ctx, const char *str1, JSValue str2,
                          const char *str3);
 
@@ -104,6 +118,49 @@ static inline BOOL JS_IsEmptyString(JSValueConst v) {
          JS_VALUE_GET_STRING(v)->len == 0;
 }
 
+/* -- Rope strings ----------------------------------- */
+
+/* A rope is the lazy concatenation of two strings (JS_TAG_STRING_ROPE
+   values). Its characters are copied to a JSString the first time they
+   are needed. The flat string is then kept in 'left' so that a rope is
+   flattened only once. */
+typedef struct JSStringRope {
+  JSRefCountHeader header; /* must come first, 32-bit */
+  uint32_t len : 31;
+  uint8_t is_wide_char : 1;
+  uint32_t depth; /* 0 if flattened */
+  JSValue left;   /* JS_TAG_STRING or JS_TAG_STRING_ROPE */
+  JSValue right;  /* JS_UNDEFINED if flattened */
+} JSStringRope;
+
+/* the concatenations shorter than this are copied */
+#define JS_STRING_ROPE_SHORT_LEN 256
+
+/* return the flat string of a rope */
+JSValue js_rope_flatten(JSContext *ctx, JSValueConst val);
+void js_free_rope(JSRuntime *rt, JSStringRope *r);
+
+static inline BOOL js_tag_is_string(int tag) {
+  return tag == JS_TAG_STRING || tag == JS_TAG_STRING_ROPE;
+}
+
+/* length of a string or of a rope */
+static inline uint32_t js_string_value_len(JSValueConst val) {
+  if (JS_VALUE_GET_TAG(val) == JS_TAG_STRING_ROPE)
+    return ((JSStringRope *)JS_VALUE_GET_PTR(val))->len;
+  return JS_VALUE_GET_STRING(val)->len;
+}
+
+/* return 'val' with the ropes replaced by flat strings. 'val' is freed */
+static inline JSValue js_string_flatten_free(JSContext *ctx, JSValue val) {
+  JSValue str;
+  if (JS_VALUE_GET_TAG(val) != JS_TAG_STRING_ROPE)
+    return val;
+  str = js_rope_flatten(ctx, val);
+  JS_FreeValue(ctx, val);
+  return str;
+}
+
 /* -- StringBuffer ----------------------------------- */
 
 typedef struct StringBuffer {
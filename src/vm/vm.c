@@ -8,6 +8,7 @@
 #include "mod.h"
 #include "obj.h"
 #include "parse/parse.h"
+#include "prof.h"
 
 #ifdef DUMP_LEAKS
 #include "dump.h"
@@ -327,7 +328,8 @@ static void set_dummy_numeric_ops(JSNumericOperations *ops) {
 
 #endif /* CONFIG_BIGNUM */
 
-JSRuntime *JS_NewRuntime2(const JSMallocFunctions *mf, void *opaque) {
+JSRuntime *JS_NewRuntime3(const JSMallocFunctions *mf, void *opaque,
+                          int flags) {
   JSRuntime *rt;
   JSMallocState ms;
 
@@ -335,10 +337,24 @@ JSRuntime *JS_NewRuntime2(const JSMallocFunctions *mf, void *opaque) {
   ms.opaque = opaque;
   ms.malloc_limit = -1;
 
+#ifndef NDEBUG
+  {
+    /* check the bit tested by JS_FreeValue() */
+    JSGCObjectHeader h;
+    memset(&h, 0, sizeof(h));
+    h.root_buffered = 1;
+    assert(((uint8_t *)&h)[sizeof(int)] == JS_GC_FLAG_ROOT_BUFFERED);
+  }
+#endif
+
   rt = mf->js_malloc(&ms, sizeof(JSRuntime));
   if (!rt)
     return NULL;
   memset(rt, 0, sizeof(*rt));
+#if defined(JS_NAN_BOXING) && defined(JS_PTR64)
+  /* the heap pointers must fit in the low bits of a JSValue */
+  assert(((uintptr_t)rt >> JS_VALUE_TAG_SHIFT) == 0);
+#endif
   rt->mf = *mf;
   if (!rt->mf.js_malloc_usable_size) {
     /* use dummy function if none provided */
@@ -346,6 +362,7 @@ JSRuntime *JS_NewRuntime2(const JSMallocFunctions *mf, void *opaque) {
   }
   rt->malloc_state = ms;
   rt->malloc_gc_threshold = 256 * 1024;
+  rt->slab_enabled = (flags & JS_RUNTIME_SLAB_ALLOC) != 0;
 
 #ifdef CONFIG_BIGNUM
   bf_context_init(&rt->bf_ctx, js_bf_realloc, rt);
@@ -364,6 +381,13 @@ JSRuntime *JS_NewRuntime2(const JSMallocFunctions *mf, void *opaque) {
 #endif
   init_list_head(&rt->job_list);
 
+#ifdef DUMP_OPCODE_STATS
+  rt->opcode_pair_stats =
+      js_mallocz_rt(rt, sizeof(rt->opcode_pair_stats[0]) * 256 * 256);
+  if (!rt->opcode_pair_stats)
+    goto fail;
+#endif
+
   if (JS_InitAtoms(rt))
     goto fail;
 
@@ -394,8 +418,12 @@ fail:
   return NULL;
 }
 
+JSRuntime *JS_NewRuntime2(const JSMallocFunctions *mf, void *opaque) {
+  return JS_NewRuntime3(mf, opaque, 0);
+}
+
 JSRuntime *JS_NewRuntime(void) {
-  return JS_NewRuntime2(&def_malloc_funcs, NULL);
+  return JS_NewRuntime3(&def_malloc_funcs, NULL, JS_RUNTIME_SLAB_ALLOC);
 }
 
 void JS_SetRuntimeInfo(JSRuntime *rt, const char *s) {
@@ -409,6 +437,9 @@ void JS_FreeRuntime(JSRuntime *rt) {
 
   JS_FreeValueRT(rt, rt->current_exception);
 
+  if (rt->cpu_profile)
+    JS_StopCPUProfile(rt, NULL);
+
   list_for_each_safe(el, el1, &rt->job_list) {
     JSJobEntry *e = list_entry(el, JSJobEntry, link);
     for (i = 0; i < e->argc; i++)
@@ -468,6 +499,9 @@ void JS_FreeRuntime(JSRuntime *rt) {
     }
   }
   js_free_rt(rt, rt->class_array);
+#ifdef DUMP_OPCODE_STATS
+  js_free_rt(rt, rt->opcode_pair_stats);
+#endif
 
 #ifdef CONFIG_BIGNUM
   bf_context_end(&rt->bf_ctx);
@@ -538,12 +572,14 @@ void JS_FreeRuntime(JSRuntime *rt) {
 #ifdef DUMP_LEAKS
       list_del(&p->link);
 #endif
-      js_free_rt(rt, p);
+      js_free_string_struct(rt, p);
     }
   }
   js_free_rt(rt, rt->atom_array);
   js_free_rt(rt, rt->atom_hash);
   js_free_rt(rt, rt->shape_hash);
+  assert(rt->weak_ref_count == 0);
+  js_free_rt(rt, rt->weak_ref_hash);
 #ifdef DUMP_LEAKS
   if (!list_empty(&rt->string_list)) {
     if (rt->rt_info) {
@@ -567,11 +603,22 @@ void JS_FreeRuntime(JSRuntime *rt) {
         printf("\n");
       }
       list_del(&str->link);
-      js_free_rt(rt, str);
+      js_free_string_struct(rt, str);
     }
     if (rt->rt_info)
       printf("\n");
   }
+  if (rt->slab_count != 0) {
+    if (rt->rt_info)
+      printf("%s:1: ", rt->rt_info);
+    printf("Memory leak: %" PRId64 " bytes lost in %" PRId64
+           " slab block%s\n",
+           rt->slab_size, rt->slab_count, &"s"[rt->slab_count == 1]);
+  }
+#endif
+  js_slab_free_pages(rt);
+
+#ifdef DUMP_LEAKS
   {
     JSMallocState *s = &rt->malloc_state;
     if (s->malloc_count > 1) {
@@ -840,6 +887,58 @@ int JS_SetGlobalVar(JSContext *ctx, JSAtom prop, JSValue val, int flag) {
   return JS_SetPropertyInternal(ctx, ctx->global_obj, prop, val, flags);
 }
 
+/* find the own data property `prop` of the global objects, in the same
+   order as JS_GetGlobalVar(), and record it in `gic` */
+static JSProperty *js_global_ic_update(JSContext *ctx,
+                                       JSGlobalInlineCache *gic, JSAtom prop,
+                                       int mask) {
+  JSObject *p, *var_p;
+  JSProperty *pr;
+  JSShapeProperty *prs;
+
+  var_p = JS_VALUE_GET_OBJ(ctx->global_var_obj);
+  p = var_p;
+  prs = find_own_property(&pr, p, prop);
+  if (!prs) {
+    p = JS_VALUE_GET_OBJ(ctx->global_obj);
+    prs = find_own_property(&pr, p, prop);
+  }
+  if (!prs || (prs->flags & (JS_PROP_TMASK | mask)) != mask)
+    return NULL;
+  gic->shape = p->shape;
+  gic->shape_id = p->shape->id;
+  gic->prop_idx = prs - get_shape_prop(p->shape);
+  if (p == var_p) {
+    gic->var_shape = NULL;
+  } else {
+    gic->var_shape = var_p->shape;
+    gic->var_shape_id = var_p->shape->id;
+  }
+  return pr;
+}
+
+JSValue js_get_var_ic_miss(JSContext *ctx, JSGlobalInlineCache *gic,
+                           JSAtom prop) {
+  JSProperty *pr;
+
+  pr = js_global_ic_update(ctx, gic, prop, 0);
+  if (pr && likely(!JS_IsUninitialized(pr->u.value)))
+    return JS_DupValue(ctx, pr->u.value);
+  return JS_GetGlobalVar(ctx, prop, TRUE);
+}
+
+int js_put_var_ic_miss(JSContext *ctx, JSGlobalInlineCache *gic, JSAtom prop,
+                       JSValue val) {
+  JSProperty *pr;
+
+  pr = js_global_ic_update(ctx, gic, prop, JS_PROP_WRITABLE);
+  if (pr && likely(!JS_IsUninitialized(pr->u.value))) {
+    set_value(ctx, &pr->u.value, val);
+    return 0;
+  }
+  return JS_SetGlobalVar(ctx, prop, val, 0);
+}
+
 /* -- JSStackFrame ----------------------------------- */
 
 /* only valid inside C functions */
@@ -852,6 +951,10 @@ JSValueConst JS_GetActiveFunction(JSContext *ctx) {
 no_inline __exception int __js_poll_interrupts(JSContext *ctx) {
   JSRuntime *rt = ctx->rt;
   ctx->interrupt_counter = JS_INTERRUPT_COUNTER_INIT;
+  if (rt->cpu_profile) {
+    ctx->interrupt_counter = JS_PROF_INTERRUPT_COUNTER_INIT;
+    js_prof_poll(rt);
+  }
   if (rt->interrupt_handler) {
     if (rt->interrupt_handler(rt, rt->interrupt_opaque)) {
       /* XXX: should set a specific flag to avoid catching */
@@ -69,6 +69,14 @@ int JS_CheckGlobalVar(JSContext *ctx, JSAtom prop);
 */
 int JS_SetGlobalVar(JSContext *ctx, JSAtom prop, JSValue val, int flag);
 
+/* the slow paths of `OP_get_var_ic` and `OP_put_var_ic`, `gic` records the
+   data property holding the variable */
+struct JSGlobalInlineCache;
+JSValue js_get_var_ic_miss(JSContext *ctx, struct JSGlobalInlineCache *gic,
+                           JSAtom prop);
+int js_put_var_ic_miss(JSContext *ctx, struct JSGlobalInlineCache *gic,
+                       JSAtom prop, JSValue val);
+
 /* -- JSStackFrame ----------------------------------- */
 
 static inline BOOL is_strict_mode(JSContext *ctx) {
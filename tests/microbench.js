@@ -568,6 +568,25 @@ function set_collection_add(n) {
   return n * len;
 }
 
+function map_object_keys(n) {
+  var m,
+    keys = [],
+    i,
+    j,
+    len = 1000;
+  for (i = 0; i < len; i++) keys[i] = {};
+  for (j = 0; j < n; j++) {
+    m = new Map();
+    for (i = 0; i < len; i++) {
+      m.set(keys[i], i);
+    }
+    for (i = 0; i < len; i++) {
+      if (m.get(keys[i]) !== i) throw Error("bug in Map");
+    }
+  }
+  return n * len;
+}
+
 function array_for(n) {
   var r, i, j, sum;
   r = [];
@@ -893,6 +912,7 @@ function main(argc, argv, g) {
     int_arith,
     float_arith,
     set_collection_add,
+    map_object_keys,
     array_for,
     array_for_in,
     array_for_of,
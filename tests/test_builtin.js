@@ -336,11 +336,69 @@ function test_string() {
   assert("aaaa".split("aaaaa", 0), []);
   assert("aaaa".split("aaaaa", 1), ["aaaa"]);
 
+  /* long texts and patterns, 8 and 16 bit */
+  a = "xy".repeat(300);
+  assert((a + "\u0101" + a).indexOf("\u0101"), 600);
+  assert((a + "\u0101" + a).indexOf("y\u0101x", 600), -1);
+  assert((a + "abcdefghijklmnopqrstuvwxyz" + a).indexOf("cdefghijklmnopqrstuvw"), 602);
+  assert((a + "abcdefghijklmnopqrstuvwxyz\u0101").indexOf("cdefghijklmnopqrstuvw"), 602);
+  assert((a + "abcdefghijklmnopqrstuvwxyz").includes("xyxyxyxyxyxyxyxyxyxyxyxa"), false);
+  assert((a + "\u0101").lastIndexOf("xy\u0101"), 598);
+  assert(("\u0101" + a).slice(1).indexOf("yxyxyxyxyxyxyxyxyxyxyxyxyxyxyxyxy", 100), 101);
+  assert(("\u0101" + a + "-" + a).split("-").length, 2);
+
   assert(eval('"\0"'), "\0");
 
   assert("abc".padStart(Infinity, ""), "abc");
 }
 
+function test_string_concat() {
+  var a, b, s, t, i, m;
+  a = "a".repeat(300);
+  b = "\u0101".repeat(300);
+  s = a + b;
+  assert(s.length, 600);
+  assert(typeof s, "string");
+  assert(s === a + b, true);
+  assert(s.charCodeAt(299), 0x61);
+  assert(s[300], "\u0101");
+  assert(s < a + b + "a", true);
+  m = new Map();
+  m.set(s, 1);
+  assert(m.get(a + b), 1);
+  assert(JSON.parse(JSON.stringify(s)) === s, true);
+
+  s = "";
+  t = [];
+  for(i = 0; i < 1000; i++) {
+    s += "x" + i;
+    t.push("x" + i);
+  }
+  assert(s === t.join(""), true);
+  s = "";
+  for(i = 0; i < 1000; i++)
+    s = ("x" + i) + s;
+  assert(s === t.reverse().join(""), true);
+}
+
+function test_error_line() {
+  var src, f, i, m, n = 500;
+  /* large enough for the line table to be indexed */
+  src = "(function(k) {\n";
+  for(i = 0; i < n; i++)
+    src += "  if (k === " + i + ") { var e = new Error(); throw e; }\n";
+  src += "})";
+  f = eval(src);
+  for(i = 0; i < n; i += 7) {
+    try {
+      f(i);
+    } catch (e) {
+      m = /:(\d+)\)/.exec(e.stack);
+      assert(m !== null && +m[1], i + 2);
+    }
+  }
+}
+
 function test_math() {
   var a;
   a = 1.4;
@@ -359,6 +417,14 @@ function test_number() {
   assert(parseInt("  123r"), 123);
   assert(parseInt("0x123"), 0x123);
   assert(parseInt("0o123"), 0);
+  assert(parseInt("12.5"), 12);
+  assert(parseInt("1e3"), 1);
+  assert(parseInt("-7.9e2"), -7);
+  assert(parseInt("  42.0abc"), 42);
+  assert(parseFloat("12.5"), 12.5);
+  assert(parseFloat("1e3x"), 1000);
+  assert(parseFloat("-7.9e2"), -790);
+  assert(parseFloat("1e"), 1);
   assert(+"  123   ", 123);
   assert(+"0b111", 7);
   assert(+"0o123", 83);
@@ -496,6 +562,37 @@ function test_json() {
   assert(a.z, null);
   assert(JSON.stringify(a), s);
 
+  a = JSON.parse(' \t\r\n[ -0 , 1e2, -2147483648, 0.5E-1, "\\u00e9\\ud83d\\ude00\\/\\n", "caf\u00e9", {"":{}} ] ');
+  assert(1 / a[0], -Infinity);
+  assert(a[1], 100);
+  assert(a[2], -2147483648);
+  assert(a[3], 0.05);
+  assert(a[4], "\u00e9\ud83d\ude00/\n");
+  assert(a[5], "caf\u00e9");
+  assert(JSON.stringify(a[6]), '{"":{}}');
+  a = JSON.parse('{"b":1,"a":2,"b":3,"__proto__":4,"0":5}');
+  assert(JSON.stringify(a), '{"0":5,"b":3,"a":2,"__proto__":4}');
+  assert(Object.getPrototypeOf(a), Object.prototype);
+  assert(JSON.parse('"' + "x".repeat(100) + '\\"' + '"'), "x".repeat(100) + '"');
+  /* the objects with the same keys share their shape */
+  a = JSON.parse('[{"x":1,"y":2},{"x":3,"y":4},{"y":5,"x":6},{"x":7,"y":8,"x":9},{}]');
+  a[1].z = 10;
+  delete a[0].x;
+  assert(JSON.stringify(a), '[{"y":2},{"x":3,"y":4,"z":10},{"y":5,"x":6},{"x":9,"y":8},{}]');
+  Object.defineProperty(Object.prototype, "q", {
+    set: function () { throw Error("setter"); },
+    configurable: true,
+  });
+  a = JSON.parse('[{"q":1},{"q":2}]');
+  delete Object.prototype.q;
+  assert(a[0].q + a[1].q, 3);
+  /* the JSON grammar is stricter than the JavaScript one */
+  ["1.", ".5", "01", "-01", "+1", "1e", "[1,]", '{"a":1,}', "{'a':1}",
+   '"\\x41"', '"\\v"', '"\\u{41}"', '"a\nb"', '"abc', "nul", "nullx",
+   "[1 2]", "\v1", "1 2"].forEach(function (s) {
+    assert_throws(SyntaxError, function () { JSON.parse(s); });
+  });
+
   /* indentation test */
   assert(
     JSON.stringify([[{ x: 1, y: {}, z: [] }, 2, 3]], undefined, 1),
@@ -634,6 +731,48 @@ function test_map() {
   assert(a.size, 0);
 }
 
+/* the records stay reachable while the hash table is resized, for the
+   kinds of keys which are hashed differently */
+function test_map_hash() {
+  var a, i, n, keys;
+  n = 20000;
+  keys = [];
+  for (i = 0; i < n; i++) {
+    switch (i % 5) {
+      case 0:
+        keys.push({});
+        break;
+      case 1:
+        keys.push(Symbol());
+        break;
+      case 2:
+        keys.push(i);
+        break;
+      case 3:
+        keys.push(i + 0.5);
+        break;
+      default:
+        keys.push("k" + i);
+        break;
+    }
+  }
+  a = new Map();
+  for (i = 0; i < n; i++) a.set(keys[i], i);
+  a.set(-0, "zero");
+  a.set(NaN, "nan");
+  assert(a.size, n + 2);
+  for (i = 0; i < n; i++) assert(a.get(keys[i]), i);
+  assert(a.get(0), "zero");
+  assert(a.get(0 / -Infinity), "zero");
+  assert(a.get(Math.sqrt(-1)), "nan");
+  assert(a.has({}), false);
+  assert(a.has("k" + (n + 4)), false);
+
+  for (i = 0; i < n; i += 2) assert(a.delete(keys[i]));
+  assert(a.size, n / 2 + 2);
+  for (i = 0; i < n; i++) assert(a.has(keys[i]), (i & 1) != 0);
+}
+
 function test_weak_map() {
   var a, i, n, tab, o, v, n2;
   a = new WeakMap();
@@ -657,6 +796,58 @@ function test_weak_map() {
   /* the WeakMap should be empty here */
 }
 
+function test_weak_map_gc() {
+  var maps, set, keys, i, j, n, k, a, b;
+
+  /* enough records to grow the runtime table of the weak references
+     several times */
+  n = 5000;
+  maps = [new WeakMap(), new WeakMap()];
+  set = new WeakSet();
+  keys = [];
+  for (i = 0; i < n; i++) {
+    k = { id: i };
+    keys.push(k);
+    for (j = 0; j < maps.length; j++) maps[j].set(k, i + j);
+    set.add(k);
+  }
+  k = null;
+
+  /* delete some records while the keys of their neighbours die */
+  for (i = 0; i < n; i += 2) {
+    if (i % 4 == 0) assert(maps[0].delete(keys[i]));
+    keys[i] = null;
+  }
+  /* a map dies before its keys */
+  maps[1] = null;
+  for (i = 1; i < n; i += 2) {
+    assert(maps[0].get(keys[i]), i);
+    assert(set.has(keys[i]));
+    assert(set.delete(keys[i]));
+    assert(!set.has(keys[i]));
+  }
+
+  /* the keys of a garbage cycle die in the cycle collection */
+  for (i = 0; i < 1000; i++) {
+    a = {};
+    b = { a: a };
+    a.b = b;
+    maps[0].set(a, i);
+    set.add(b);
+  }
+  a = b = null;
+  for (i = 0; i < 200000; i++) k = { i: i };
+
+  for (i = 0; i < n; i += 2) {
+    keys[i] = { id: i };
+    set.add(keys[i]);
+  }
+  for (i = 0; i < n; i++) {
+    assert(set.has(keys[i]), (i & 1) == 0);
+    assert(maps[0].has(keys[i]), (i & 1) != 0);
+  }
+}
+
 function test_generator() {
   function* f() {
     var ret;
@@ -702,6 +893,8 @@ test_function();
 test_enum();
 test_array();
 test_string();
+test_string_concat();
+test_error_line();
 test_math();
 test_number();
 test_eval();
@@ -711,5 +904,7 @@ test_date();
 test_regexp();
 test_symbol();
 test_map();
+test_map_hash();
 test_weak_map();
+test_weak_map_gc();
 test_generator();
@@ -0,0 +1,574 @@
+/*
+ * QuickJS: tests of the debugger and profiler C API
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "include/quickjs-libc.h"
+#include "include/quickjs.h"
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      exit(1);                                                                 \
+    }                                                                          \
+  } while (0)
+
+static void eval_file(JSContext *ctx, const char *str, const char *filename) {
+  JSValue val;
+  const char *msg;
+
+  val = JS_Eval(ctx, str, strlen(str), filename, JS_EVAL_TYPE_GLOBAL);
+  if (JS_IsException(val)) {
+    val = JS_GetException(ctx);
+    msg = JS_ToCString(ctx, val);
+    fprintf(stderr, "%s: %s\n", filename, msg ? msg : "exception");
+    JS_FreeCString(ctx, msg);
+    JS_FreeValue(ctx, val);
+    exit(1);
+  }
+  JS_FreeValue(ctx, val);
+}
+
+/* the breakpoints of the tests are set in "test.js" */
+static void eval(JSContext *ctx, const char *str) {
+  eval_file(ctx, str, "test.js");
+}
+
+/* the last message of the logpoints, and the first ones as "line:col:msg"
+   lines until takeLogs() is called */
+static char log_buf[256];
+static int log_count;
+static char log_all[4096];
+static size_t log_all_len;
+
+static void log_handler(JSContext *ctx, const char *file, int line, int col,
+                        const char *msg, size_t len, void *opaque) {
+  int n;
+
+  log_count++;
+  if (len >= sizeof(log_buf))
+    len = sizeof(log_buf) - 1;
+  memcpy(log_buf, msg, len);
+  log_buf[len] = '\0';
+  n = snprintf(log_all + log_all_len, sizeof(log_all) - log_all_len,
+               "%d:%d:%s\n", line, col, log_buf);
+  if (log_all_len + n < sizeof(log_all))
+    log_all_len += n;
+}
+
+/* setBreakpoint(line, col, condition, log_message) */
+static JSValue js_set_breakpoint(JSContext *ctx, JSValueConst this_val,
+                                 int argc, JSValueConst *argv) {
+  const char *cond = NULL, *log = NULL;
+  int line, col, ret = -1;
+
+  if (JS_ToInt32(ctx, &line, argv[0]) || JS_ToInt32(ctx, &col, argv[1]))
+    return JS_EXCEPTION;
+  if (!JS_IsUndefined(argv[2]) && !(cond = JS_ToCString(ctx, argv[2])))
+    goto done;
+  if (!JS_IsUndefined(argv[3]) && !(log = JS_ToCString(ctx, argv[3])))
+    goto done;
+  ret = js_debug_set_breakpoint2(ctx, "test.js", line, col, cond, log);
+done:
+  JS_FreeCString(ctx, cond);
+  JS_FreeCString(ctx, log);
+  return JS_NewBool(ctx, ret == 0);
+}
+
+/* delBreakpoint(line, col) */
+static JSValue js_del_breakpoint(JSContext *ctx, JSValueConst this_val,
+                                 int argc, JSValueConst *argv) {
+  int line, col;
+
+  if (JS_ToInt32(ctx, &line, argv[0]) || JS_ToInt32(ctx, &col, argv[1]))
+    return JS_EXCEPTION;
+  js_debug_del_breakpoint(ctx, "test.js", line, col);
+  return JS_UNDEFINED;
+}
+
+static JSValue js_take_logs(JSContext *ctx, JSValueConst this_val, int argc,
+                            JSValueConst *argv) {
+  JSValue ret = JS_NewStringLen(ctx, log_all, log_all_len);
+  log_all_len = 0;
+  return ret;
+}
+
+static const JSCFunctionListEntry js_test_funcs[] = {
+    JS_CFUNC_DEF("setBreakpoint", 4, js_set_breakpoint),
+    JS_CFUNC_DEF("delBreakpoint", 2, js_del_breakpoint),
+    JS_CFUNC_DEF("takeLogs", 0, js_take_logs),
+    JS_CFUNC_DEF("pc2line", 1, js_debug_pc2line),
+};
+
+static const char prelude_src[] = "function assert(b, msg) {\n"
+                                  "  if (!b) throw Error(msg || 'assertion');\n"
+                                  "}\n";
+
+static JSContext *new_debug_context(JSRuntime *rt) {
+  JSContext *ctx;
+  JSValue global;
+
+  ctx = JS_NewContext(rt);
+  CHECK(ctx != NULL);
+  CHECK(js_debug_init(ctx) == 0);
+  js_debug_set_log_handler(ctx, log_handler, NULL);
+  js_debug_on(ctx);
+  global = JS_GetGlobalObject(ctx);
+  JS_SetPropertyFunctionList(ctx, global, js_test_funcs,
+                             sizeof(js_test_funcs) / sizeof(js_test_funcs[0]));
+  JS_FreeValue(ctx, global);
+  eval_file(ctx, prelude_src, "prelude.js");
+  log_buf[0] = '\0';
+  log_count = 0;
+  log_all_len = 0;
+  return ctx;
+}
+
+static void free_debug_context(JSContext *ctx) {
+  js_debug_off(ctx);
+  js_free_debug(ctx);
+  JS_FreeContext(ctx);
+}
+
+static const char loop_src[] =
+    "var n = 0;\n"
+    "for (var i = 0; i < 100000; i++) {\n"
+    "  if (i == 0) setBreakpoint(4, 0, undefined, '{i}');\n"
+    "  n++;\n"
+    "}\n";
+
+/* a breakpoint set while a frame is running is hit by that frame */
+static void test_bp_running_frame(void) {
+  JSRuntime *rt;
+  JSContext *ctx;
+
+  rt = JS_NewRuntime();
+  CHECK(rt != NULL);
+  ctx = new_debug_context(rt);
+
+  eval(ctx, loop_src);
+  CHECK(log_count > 0);
+  CHECK(log_count < 100000);
+  CHECK(!strcmp(log_buf, "99999"));
+
+  free_debug_context(ctx);
+  JS_FreeRuntime(rt);
+}
+
+static const char bp_table_src[] =
+    "function f(x) {\n"
+    "  var a = x + 1;\n"
+    "  return a * 2;\n"
+    "}\n"
+    "/* each location listed by pc2line() is accepted by the native table */\n"
+    "var locs = pc2line(f).bps, l, logs, i;\n"
+    "assert(locs.length > 0);\n"
+    "for (l of locs) {\n"
+    "  for (var col of [l.col, 0]) {\n"
+    "    assert(setBreakpoint(l.line, col, undefined, 'hit'));\n"
+    "    f(1);\n"
+    "    delBreakpoint(l.line, col);\n"
+    "    logs = takeLogs().split('\\n');\n"
+    "    assert(logs.length > 1, l.line + ':' + col);\n"
+    "    for (i = 0; i < logs.length - 1; i++)\n"
+    "      assert(logs[i] == l.line + ':' + col + ':hit', logs[i]);\n"
+    "  }\n"
+    "}\n"
+    "/* a column without code is not hit */\n"
+    "assert(setBreakpoint(2, 1000, undefined, 'hit'));\n"
+    "f(1);\n"
+    "delBreakpoint(2, 1000);\n"
+    "assert(takeLogs() == '');\n";
+
+/* the native pc to breakpoint table agrees with js_debug_pc2line() */
+static void test_bp_table(void) {
+  JSRuntime *rt;
+  JSContext *ctx;
+
+  rt = JS_NewRuntime();
+  CHECK(rt != NULL);
+  ctx = new_debug_context(rt);
+  eval(ctx, bp_table_src);
+  free_debug_context(ctx);
+  JS_FreeRuntime(rt);
+}
+
+static const char bp_trap_src[] =
+    "function g(x) {\n"
+    "  var y = x + 1;\n"
+    "  return y;\n"
+    "}\n"
+    "g(0);\n"
+    "assert(takeLogs() == '');\n"
+    "assert(setBreakpoint(2, 0, undefined, '{x}'));\n"
+    "assert(setBreakpoint(3, 0, undefined, 'y{y}'));\n"
+    "g(1);\n"
+    "g(2);\n"
+    "assert(takeLogs() == '2:0:1\\n3:0:y2\\n2:0:2\\n3:0:y3\\n');\n"
+    "/* the original opcode is restored in the trap copy still used by the\n"
+    "   other breakpoint */\n"
+    "delBreakpoint(2, 0);\n"
+    "assert(g(3) == 4);\n"
+    "assert(takeLogs() == '3:0:y4\\n');\n"
+    "delBreakpoint(3, 0);\n"
+    "assert(g(4) == 5);\n"
+    "assert(takeLogs() == '');\n"
+    "assert(setBreakpoint(2, 0, undefined, '{x}'));\n"
+    "assert(g(5) == 6);\n"
+    "assert(takeLogs() == '2:0:5\\n');\n"
+    "delBreakpoint(2, 0);\n";
+
+/* the trap opcodes are patched in and out as the breakpoints change */
+static void test_bp_trap(void) {
+  JSRuntime *rt;
+  JSContext *ctx;
+
+  rt = JS_NewRuntime();
+  CHECK(rt != NULL);
+  ctx = new_debug_context(rt);
+  eval(ctx, bp_trap_src);
+  free_debug_context(ctx);
+  JS_FreeRuntime(rt);
+}
+
+static const char pause_src[] = "function h(a) {\n"
+                                "  var b = a * 2;\n"
+                                "  return b;\n"
+                                "}\n"
+                                "var r = h(21);\n";
+
+static volatile int pause_done;
+static char pause_frame[256];
+
+/* the debugger side: dump the paused frame, then resume the vm until the
+   script is done. js_debug_continue() is repeated since it does nothing if
+   the vm is not waiting yet. */
+static void *pause_thread(void *opaque) {
+  JSContext *ctx = opaque;
+  JSValue frame, json;
+  const char *str;
+
+  while (!pause_done) {
+    if (!pause_frame[0]) {
+      frame = js_debug_dump_stackframe(ctx, 0);
+      if (!JS_IsNull(frame)) {
+        json = JS_JSONStringify(ctx, frame, JS_UNDEFINED, JS_UNDEFINED);
+        str = JS_ToCString(ctx, json);
+        snprintf(pause_frame, sizeof(pause_frame), "%s", str ? str : "?");
+        JS_FreeCString(ctx, str);
+        JS_FreeValue(ctx, json);
+        JS_FreeValue(ctx, frame);
+      }
+    }
+    js_debug_continue(ctx);
+    usleep(1000);
+  }
+  return NULL;
+}
+
+/* a breakpoint set through the C API pauses the vm until
+   js_debug_continue() */
+static void test_bp_pause(void) {
+  JSRuntime *rt;
+  JSContext *ctx;
+  pthread_t tid;
+
+  rt = JS_NewRuntime();
+  CHECK(rt != NULL);
+  ctx = new_debug_context(rt);
+  CHECK(js_debug_set_breakpoint(ctx, "test.js", 3, 0) == 0);
+  pause_done = 0;
+  pause_frame[0] = '\0';
+  CHECK(pthread_create(&tid, NULL, pause_thread, ctx) == 0);
+  eval(ctx, pause_src);
+  pause_done = 1;
+  pthread_join(tid, NULL);
+
+  CHECK(strstr(pause_frame, "\"args\":[{\"name\":\"a\",\"value\":21}]"));
+  CHECK(strstr(pause_frame, "\"vars\":[{\"name\":\"b\",\"value\":42}]"));
+  CHECK(strstr(pause_frame, "\"name\":\"h\""));
+  eval(ctx, "assert(r == 42);");
+
+  free_debug_context(ctx);
+  JS_FreeRuntime(rt);
+}
+
+static const char bp_hash_src[] =
+    "var i, exp;\n"
+    "for (i = 2; i <= 41; i++)\n"
+    "  assert(setBreakpoint(i, 0, undefined, 'a'));\n"
+    "big();\n"
+    "for (exp = '', i = 2; i <= 41; i++)\n"
+    "  exp += i + ':0:a\\n';\n"
+    "assert(takeLogs() == exp);\n"
+    "/* the breakpoints set again are replaced */\n"
+    "for (i = 2; i <= 41; i += 3)\n"
+    "  assert(setBreakpoint(i, 0, undefined, 'b'));\n"
+    "/* the entries shifted back by the deletions are still found */\n"
+    "for (i = 2; i <= 41; i += 2)\n"
+    "  delBreakpoint(i, 0);\n"
+    "/* the lines are non-negative, the file entry is left alone */\n"
+    "assert(!setBreakpoint(-1, 0, undefined, 'a'));\n"
+    "delBreakpoint(-1, 0);\n"
+    "big();\n"
+    "for (exp = '', i = 3; i <= 41; i += 2)\n"
+    "  exp += i + ':0:' + ((i - 2) % 3 ? 'a' : 'b') + '\\n';\n"
+    "assert(takeLogs() == exp);\n"
+    "for (i = 3; i <= 41; i += 2)\n"
+    "  delBreakpoint(i, 0);\n"
+    "big();\n"
+    "assert(takeLogs() == '');\n";
+
+/* the breakpoint hash set grows, replaces and deletes its entries */
+static void test_bp_hash(void) {
+  JSRuntime *rt;
+  JSContext *ctx;
+  char src[1024];
+  int i, pos;
+
+  rt = JS_NewRuntime();
+  CHECK(rt != NULL);
+  ctx = new_debug_context(rt);
+  /* a function whose lines 2 to 41 can have a breakpoint each */
+  pos = snprintf(src, sizeof(src), "var n = 0; function big() {\n");
+  for (i = 0; i < 40; i++)
+    pos += snprintf(src + pos, sizeof(src) - pos, "  n++;\n");
+  snprintf(src + pos, sizeof(src) - pos, "}\n");
+  eval(ctx, src);
+  eval_file(ctx, bp_hash_src, "main.js");
+  free_debug_context(ctx);
+  JS_FreeRuntime(rt);
+}
+
+static const char bp_cond_func_src[] =
+    "var k = (function () {\n"
+    "  var base = 100;\n"
+    "  return function (i) {\n"
+    "    var s = 'v' + i;\n"
+    "    return s + base;\n"
+    "  };\n"
+    "})();\n";
+
+static const char bp_cond_src[] =
+    "var i, logs, exp;\n"
+    "/* the argument, the local and the closure variable are visible */\n"
+    "assert(setBreakpoint(5, 0, 'i % 10 == 0', '{i}:{s}:{base}'));\n"
+    "for (i = 0; i < 30; i++)\n"
+    "  k(i);\n"
+    "assert(takeLogs() ==\n"
+    "       '5:0:0:v0:100\\n5:0:10:v10:100\\n5:0:20:v20:100\\n');\n"
+    "delBreakpoint(5, 0);\n"
+    "/* the text outside of the braces is kept as is */\n"
+    "assert(setBreakpoint(5, 0, undefined, '`$` {i * 2}'));\n"
+    "k(3);\n"
+    "assert(takeLogs() == '5:0:`$` 6\\n');\n"
+    "delBreakpoint(5, 0);\n"
+    "/* a false condition does not pause */\n"
+    "assert(setBreakpoint(5, 0, 'i < 0', undefined));\n"
+    "assert(k(1) == 'v1100');\n"
+    "delBreakpoint(5, 0);\n"
+    "/* the errors are logged and do not pause either */\n"
+    "assert(setBreakpoint(5, 0, 'i +', undefined));\n"
+    "k(1);\n"
+    "k(2);\n"
+    "logs = takeLogs();\n"
+    "assert(/^5:0:SyntaxError[^\\n]*\\n$/.test(logs), logs);\n"
+    "delBreakpoint(5, 0);\n"
+    "assert(setBreakpoint(5, 0, 'nope.x', undefined));\n"
+    "k(1);\n"
+    "k(2);\n"
+    "logs = takeLogs();\n"
+    "exp = \"5:0:ReferenceError: 'nope' is not defined\\n\";\n"
+    "assert(logs == exp + exp, logs);\n"
+    "delBreakpoint(5, 0);\n"
+    "assert(takeLogs() == '');\n";
+
+/* the conditions and the log messages are compiled once per function and
+   evaluated with the variables of the frame */
+static void test_bp_cond(void) {
+  JSRuntime *rt;
+  JSContext *ctx;
+
+  rt = JS_NewRuntime();
+  CHECK(rt != NULL);
+  ctx = new_debug_context(rt);
+  eval(ctx, bp_cond_func_src);
+  eval_file(ctx, bp_cond_src, "main.js");
+  free_debug_context(ctx);
+  JS_FreeRuntime(rt);
+}
+
+static const char prof_run_src[] =
+    "function busy() {\n"
+    "  var t = Date.now(), n = 0;\n"
+    "  while (Date.now() - t < 200)\n"
+    "    n++;\n"
+    "  return n;\n"
+    "}\n"
+    "function caller() {\n"
+    "  return busy();\n"
+    "}\n"
+    "caller();\n";
+
+static const char prof_check_src[] =
+    "var p = JSON.parse(profile), ids = new Set(), hits = 0, busy, caller;\n"
+    "var n, cf, c, s;\n"
+    "assert(p.nodes[0].callFrame.functionName == '(root)');\n"
+    "for (n of p.nodes) {\n"
+    "  assert(typeof n.id == 'number' && !ids.has(n.id));\n"
+    "  ids.add(n.id);\n"
+    "  cf = n.callFrame;\n"
+    "  assert(typeof cf.functionName == 'string');\n"
+    "  assert(typeof cf.scriptId == 'string' && typeof cf.url == 'string');\n"
+    "  assert(typeof cf.lineNumber == 'number');\n"
+    "  assert(typeof cf.columnNumber == 'number');\n"
+    "  assert(Array.isArray(n.children));\n"
+    "  hits += n.hitCount;\n"
+    "  if (cf.functionName == 'busy')\n"
+    "    busy = n;\n"
+    "  if (cf.functionName == 'caller')\n"
+    "    caller = n;\n"
+    "}\n"
+    "for (n of p.nodes) {\n"
+    "  for (c of n.children)\n"
+    "    assert(ids.has(c));\n"
+    "}\n"
+    "/* the line numbers are 0 based, the file name is escaped */\n"
+    "assert(busy && busy.callFrame.url == 'q' + String.fromCharCode(34, 92));\n"
+    "assert(busy.callFrame.lineNumber == 0 && busy.hitCount > 0);\n"
+    "assert(caller && caller.callFrame.lineNumber == 6);\n"
+    "assert(caller.children.includes(busy.id));\n"
+    "assert(p.samples.length > 0 && p.samples.length == hits);\n"
+    "assert(p.samples.length == p.timeDeltas.length);\n"
+    "for (s of p.samples)\n"
+    "  assert(ids.has(s));\n"
+    "assert(p.startTime <= p.endTime);\n";
+
+/* the samples are written in the Chrome DevTools .cpuprofile format */
+static void test_cpu_profile(void) {
+  JSRuntime *rt;
+  JSContext *ctx;
+  JSValue global;
+  char path[] = "/tmp/test_debug_XXXXXX";
+  char *buf;
+  long len;
+  FILE *fp;
+  int fd;
+
+  fd = mkstemp(path);
+  CHECK(fd >= 0);
+  close(fd);
+
+  rt = JS_NewRuntime();
+  CHECK(rt != NULL);
+  ctx = new_debug_context(rt);
+  CHECK(JS_StartCPUProfile(rt, 1000) == 0);
+  eval_file(ctx, prof_run_src, "q\"\\");
+  CHECK(JS_StopCPUProfile(rt, path) == 0);
+
+  fp = fopen(path, "rb");
+  CHECK(fp != NULL);
+  fseek(fp, 0, SEEK_END);
+  len = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  buf = malloc(len);
+  CHECK(buf != NULL);
+  CHECK(fread(buf, 1, len, fp) == len);
+  fclose(fp);
+  unlink(path);
+
+  global = JS_GetGlobalObject(ctx);
+  JS_SetPropertyStr(ctx, global, "profile", JS_NewStringLen(ctx, buf, len));
+  JS_FreeValue(ctx, global);
+  free(buf);
+  eval_file(ctx, prof_check_src, "main.js");
+
+  free_debug_context(ctx);
+  JS_FreeRuntime(rt);
+}
+
+static const char opcode_stats_check_src[] =
+    "var lines = stats.split('\\n'), m, total, sum = 0, i;\n"
+    "if (stats.startsWith('OPCODE STATS')) {\n"
+    "  m = /^OPCODE STATS: (\\d+) instructions$/.exec(lines[0]);\n"
+    "  assert(m, lines[0]);\n"
+    "  total = +m[1];\n"
+    "  assert(total >= 100000);\n"
+    "  for (i = 2; lines[i] != ''; i++) {\n"
+    "    m = /^  (\\S+) +(\\d+) +[\\d.]+% +([\\d.]+)%$/.exec(lines[i]);\n"
+    "    assert(m, lines[i]);\n"
+    "    sum += +m[2];\n"
+    "  }\n"
+    "  assert(sum == total && m[3] == '100.00');\n"
+    "  assert(lines[i + 1].startsWith('OPCODE PAIR STATS: top'));\n"
+    "} else {\n"
+    "  /* not built with QJS_DUMP_OPCODE_STATS */\n"
+    "  assert(stats.includes('QJS_DUMP_OPCODE_STATS=ON'), stats);\n"
+    "}\n";
+
+/* JS_DumpOpcodeStats() lists the opcodes by execution count, their counts
+   add up to the total */
+static void test_opcode_stats(void) {
+  JSRuntime *rt;
+  JSContext *ctx;
+  JSValue global;
+  char buf[16384];
+  size_t len;
+  FILE *fp;
+
+  rt = JS_NewRuntime();
+  CHECK(rt != NULL);
+  ctx = new_debug_context(rt);
+  eval(ctx, "for (var i = 0, s = 0; i < 100000; i++) s += i;");
+
+  fp = tmpfile();
+  CHECK(fp != NULL);
+  JS_DumpOpcodeStats(rt, fp);
+  rewind(fp);
+  len = fread(buf, 1, sizeof(buf), fp);
+  CHECK(len < sizeof(buf));
+  fclose(fp);
+
+  global = JS_GetGlobalObject(ctx);
+  JS_SetPropertyStr(ctx, global, "stats", JS_NewStringLen(ctx, buf, len));
+  JS_FreeValue(ctx, global);
+  eval_file(ctx, opcode_stats_check_src, "main.js");
+
+  free_debug_context(ctx);
+  JS_FreeRuntime(rt);
+}
+
+int main(int argc, char **argv) {
+  test_bp_running_frame();
+  test_bp_table();
+  test_bp_trap();
+  test_bp_pause();
+  test_bp_hash();
+  test_bp_cond();
+  test_cpu_profile();
+  test_opcode_stats();
+  return 0;
+}
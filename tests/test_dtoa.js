@@ -0,0 +1,193 @@
+"use strict";
+
+function assert(actual, expected, message) {
+  if (actual === expected) return;
+  throw Error(
+    "assertion failed: got |" + actual + "|" + ", expected |" + expected + "|" + (message ? " (" + message + ")" : "")
+  );
+}
+
+/* Number to string conversions. The expected results come from an exact
+   conversion. The last entries of each table are not decided by the fast
+   algorithm and use the exact fallback. */
+
+function test_to_string() {
+  var tab, i;
+  tab = [
+    [5e-324, "5e-324"],
+    [-5e-324, "-5e-324"],
+    [1.7976931348623157e+308, "1.7976931348623157e+308"],
+    [2.2250738585072014e-308, "2.2250738585072014e-308"],
+    [2.225073858507201e-308, "2.225073858507201e-308"],
+    [0.1, "0.1"],
+    [0.30000000000000004, "0.30000000000000004"],
+    [0.3333333333333333, "0.3333333333333333"],
+    [0.6666666666666666, "0.6666666666666666"],
+    [1e+21, "1e+21"],
+    [1e-07, "1e-7"],
+    [1e-06, "0.000001"],
+    [1.23e-18, "1.23e-18"],
+    [1.5e-07, "1.5e-7"],
+    [9007199254740992.0, "9007199254740992"],
+    [4.35, "4.35"],
+    [1.0000000000000002, "1.0000000000000002"],
+    [0.9999999999999999, "0.9999999999999999"],
+    [5e-310, "5e-310"],
+    [9.223372036854776e+18, "9223372036854776000"],
+    [9.313225746154785e-10, "9.313225746154785e-10"],
+    [1e+23, "1e+23"],
+    [9.5e+22, "9.5e+22"],
+    [8.41e+21, "8.41e+21"],
+    [1.5e-323, "1.5e-323"],
+    [299792458.5, "299792458.5"],
+    [-3.3333e-06, "-0.0000033333"],
+    [2.8305215074071378e-221, "2.8305215074071378e-221"],
+    [5.4353592560800026e+22, "5.4353592560800026e+22"],
+    [2.4921549971088678e-289, "2.4921549971088678e-289"],
+    [48.198470861948636, "48.198470861948636"],
+    [3.3405620705725163e+39, "3.3405620705725163e+39"],
+    [768117121563316.8, "768117121563316.8"],
+  ];
+  for(i = 0; i < tab.length; i++) {
+    assert(String(tab[i][0]), tab[i][1]);
+    assert(+tab[i][1], tab[i][0], tab[i][1]);
+  }
+  assert(JSON.stringify([0.1, -1e-7, 1e21]), "[0.1,-1e-7,1e+21]");
+}
+
+function test_to_precision() {
+  var tab, i;
+  tab = [
+    [2.5, 1, "3"],
+    [0.5, 1, "0.5"],
+    [1.25, 2, "1.3"],
+    [1.005, 3, "1.00"],
+    [123.456, 4, "123.5"],
+    [1e+21, 3, "1.00e+21"],
+    [0.000123, 2, "0.00012"],
+    [1.45, 2, "1.4"],
+    [9.995, 3, "9.99"],
+    [99.99, 3, "100"],
+    [5e-324, 3, "4.94e-324"],
+    [1.7976931348623157e+308, 17, "1.7976931348623157e+308"],
+    [0.3333333333333333, 17, "0.33333333333333331"],
+    [0.1, 17, "0.10000000000000001"],
+    [0.1, 21, "0.100000000000000005551"],
+    [123456789, 5, "1.2346e+8"],
+    [1e-05, 1, "0.00001"],
+    [1e-07, 2, "1.0e-7"],
+    [2.339706295667877e-227, 17, "2.3397062956678769e-227"],
+    [9.936521892918739e+53, 17, "9.9365218929187386e+53"],
+    [3.0759454679032105e+65, 16, "3.075945467903210e+65"],
+    [14931358850.335938, 17, "14931358850.335938"],
+    [2.5847884177478675e-113, 16, "2.584788417747867e-113"],
+  ];
+  for(i = 0; i < tab.length; i++)
+    assert(tab[i][0].toPrecision(tab[i][1]), tab[i][2], String(tab[i][0]));
+  assert((0).toPrecision(3), "0.00");
+  assert((-0).toPrecision(3), "0.00");
+  assert((2.5).toExponential(0), "3e+0");
+  assert((1.45).toExponential(1), "1.4e+0");
+  assert((123.456).toExponential(), "1.23456e+2");
+  assert((0.000123).toExponential(10), "1.2300000000e-4");
+  assert((1.005).toFixed(2), "1.00");
+  assert((2.5).toFixed(0), "3");
+}
+
+/* string to number conversions. The expected results are the bits of the
+   correctly rounded doubles. The ties and the numbers with more than 19
+   significant digits close to a tie use the exact fallback. */
+function test_parse() {
+  var tab, i, dv;
+  dv = new DataView(new ArrayBuffer(8));
+  function bits(x) {
+    dv.setFloat64(0, x);
+    return dv.getBigUint64(0).toString(16).padStart(16, "0");
+  }
+  tab = [
+    ["123456789012345680000", "441ac53a7e04bcda"],
+    ["900720275405016100000", "44486a009f215200"],
+    ["18446744073709551615", "43f0000000000000"],
+    ["9007199254740993", "4340000000000000"],
+    ["9007199254740992.5", "4340000000000000"],
+    ["9007199254740993.0000000000000000001", "4340000000000001"],
+    ["0.1", "3fb999999999999a"],
+    ["3.141592653589793", "400921fb54442d18"],
+    ["1e22", "4480f0cf064dd592"],
+    ["1e23", "44b52d02c7e14af6"],
+    ["8.41e21", "447c7e83209e90b2"],
+    ["2.2250738585072011e-308", "000fffffffffffff"],
+    ["2.2250738585072012e-308", "0010000000000000"],
+    ["4.9406564584124654e-324", "0000000000000001"],
+    ["2.4703282292062327e-324", "0000000000000000"],
+    ["2.4703282292062328e-324", "0000000000000001"],
+    ["1.7976931348623157e308", "7fefffffffffffff"],
+    ["1.7976931348623158e308", "7fefffffffffffff"],
+    ["1.7976931348623159e308", "7ff0000000000000"],
+    ["1e-400", "0000000000000000"],
+    ["1e400", "7ff0000000000000"],
+    ["0.000000000000000000000000000000000000001e39", "3ff0000000000000"],
+    ["1.00000000000000011102230246251565404236316680908203125e0", "3ff0000000000000"],
+    ["1.00000000000000012490009027033011079765856266021728515625e-1", "3fb999999999999a"],
+    ["9.007199254740993e15", "4340000000000000"],
+    ["7.2057594037927933e16", "4370000000000000"],
+    ["4.8726570057e288", "7be0000000000000"],
+    ["1448997445238699", "4314976c0803feac"],
+    ["1111111111111111111111111111111111111111", "480a1f41ba74c421"],
+    ["3.7e-205", "157db28a48983bc4"],
+  ];
+  for(i = 0; i < tab.length; i++) {
+    assert(bits(+tab[i][0]), tab[i][1], tab[i][0]);
+    assert(bits(-tab[i][0]), bits(-(+tab[i][0])), tab[i][0]);
+    assert(bits(parseFloat(tab[i][0] + "x")), tab[i][1], tab[i][0]);
+    assert(bits(JSON.parse(tab[i][0])), tab[i][1], tab[i][0]);
+  }
+  assert(+("0." + "0".repeat(400) + "1e400"), 0.1);
+  assert(+("1" + "0".repeat(400) + "e-400"), 1);
+  assert(+"1e99999999999", Infinity);
+  assert(1 / +"-1e-99999999999", -Infinity);
+  assert(1 / JSON.parse("-0"), -Infinity);
+  assert(JSON.stringify(JSON.parse("[1.5e3,-0.25,1E-2,123456789012345680000]")),
+         "[1500,-0.25,0.01,123456789012345680000]");
+  assert(1_000.000_1, 1000.0001);
+  assert(123456789012345680000, 1.2345678901234568e20);
+  assert(+"  12.5e1  ", 125);
+  assert(+"1.", 1);
+  assert(+".5", 0.5);
+  assert(isNaN(+"1e"), true);
+  assert(parseFloat("1e+"), 1);
+  assert(isNaN(parseFloat(".e1")), true);
+}
+
+/* round trip and shortness of pseudo random numbers */
+function test_round_trip() {
+  var dv, i, seed, x, s, d, n, m, e;
+  dv = new DataView(new ArrayBuffer(8));
+  seed = 1;
+  for(i = 0; i < 20000; i++) {
+    seed = (seed * 1103515245 + 12345) >>> 0;
+    dv.setUint32(0, seed & 0x7fefffff);
+    seed = (seed * 1103515245 + 12345) >>> 0;
+    dv.setUint32(4, seed);
+    x = dv.getFloat64(0);
+    s = x.toExponential();
+    assert(+s, x, s);
+    assert(+String(x), x, s);
+    /* no shorter string reads back as x */
+    m = /^(\d)(?:\.(\d+))?e([-+]\d+)$/.exec(s);
+    d = m[1] + (m[2] || "");
+    n = d.length;
+    if (n > 1) {
+      e = +m[3];
+      d = d.slice(0, n - 1);
+      assert(+(d[0] + "." + d.slice(1) + "e" + e) === x, false, s);
+      d = String(+d + 1);
+      assert(+(d[0] + "." + d.slice(1) + "e" + (e + d.length - n + 1)) === x, false, s);
+    }
+  }
+}
+
+test_to_string();
+test_to_precision();
+test_parse();
+test_round_trip();
@@ -0,0 +1,508 @@
+/*
+ * QuickJS: memory management tests of the C API
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "include/quickjs-libc.h"
+#include "include/quickjs.h"
+#include "src/utils/kid.h"
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      exit(1);                                                                 \
+    }                                                                          \
+  } while (0)
+
+/* the size of the block is stored before it */
+#define HEADER_SIZE 16
+
+static void *test_malloc(JSMallocState *s, size_t size) {
+  uint8_t *ptr;
+
+  if (s->malloc_size + size > s->malloc_limit)
+    return NULL;
+  ptr = malloc(HEADER_SIZE + size);
+  if (!ptr)
+    return NULL;
+  *(size_t *)ptr = size;
+  s->malloc_count++;
+  s->malloc_size += size;
+  return ptr + HEADER_SIZE;
+}
+
+static void test_free(JSMallocState *s, void *ptr) {
+  uint8_t *p;
+
+  if (!ptr)
+    return;
+  p = (uint8_t *)ptr - HEADER_SIZE;
+  s->malloc_count--;
+  s->malloc_size -= *(size_t *)p;
+  free(p);
+}
+
+static void *test_realloc(JSMallocState *s, void *ptr, size_t size) {
+  uint8_t *p;
+  size_t old_size;
+
+  if (!ptr)
+    return size ? test_malloc(s, size) : NULL;
+  if (size == 0) {
+    test_free(s, ptr);
+    return NULL;
+  }
+  p = (uint8_t *)ptr - HEADER_SIZE;
+  old_size = *(size_t *)p;
+  if (s->malloc_size - old_size + size > s->malloc_limit)
+    return NULL;
+  p = realloc(p, HEADER_SIZE + size);
+  if (!p)
+    return NULL;
+  *(size_t *)p = size;
+  s->malloc_size += size - old_size;
+  return p + HEADER_SIZE;
+}
+
+static size_t test_malloc_usable_size(const void *ptr) {
+  return ptr ? *(const size_t *)((const uint8_t *)ptr - HEADER_SIZE) : 0;
+}
+
+static const JSMallocFunctions test_mf = {
+    test_malloc,
+    test_free,
+    test_realloc,
+    test_malloc_usable_size,
+};
+
+static void eval(JSContext *ctx, const char *str) {
+  JSValue val;
+
+  val = JS_Eval(ctx, str, strlen(str), "<test>", JS_EVAL_TYPE_GLOBAL);
+  CHECK(!JS_IsException(val));
+  JS_FreeValue(ctx, val);
+}
+
+static const char alloc_objects[] = "var a = [];"
+                                    "for (var i = 0; i < 100000; i++)"
+                                    "  a.push({ x: i, s: 'v' + i });";
+
+/* without JS_RUNTIME_SLAB_ALLOC, all the allocations go to 'mf' */
+static void test_slab_disabled(void) {
+  JSRuntime *rt;
+  JSContext *ctx;
+  JSMemoryUsage s;
+
+  rt = JS_NewRuntime3(&test_mf, NULL, 0);
+  CHECK(rt != NULL);
+  ctx = JS_NewContext(rt);
+  CHECK(ctx != NULL);
+  eval(ctx, alloc_objects);
+  JS_ComputeMemoryUsage(rt, &s);
+  CHECK(s.slab_count == 0);
+  CHECK(s.slab_size == 0);
+  CHECK(s.slab_page_count == 0);
+  CHECK(s.slab_page_size == 0);
+  JS_FreeContext(ctx);
+  JS_FreeRuntime(rt);
+}
+
+/* the slab pages of a freed allocation peak are given back */
+static void test_slab_release(void) {
+  JSRuntime *rt;
+  JSContext *ctx;
+  JSMemoryUsage s0, s1, s2;
+
+  rt = JS_NewRuntime3(&test_mf, NULL, JS_RUNTIME_SLAB_ALLOC);
+  CHECK(rt != NULL);
+  ctx = JS_NewContext(rt);
+  CHECK(ctx != NULL);
+  JS_RunGC(rt);
+  JS_ComputeMemoryUsage(rt, &s0);
+
+  eval(ctx, alloc_objects);
+  JS_ComputeMemoryUsage(rt, &s1);
+  CHECK(s1.slab_count >= s0.slab_count + 200000);
+  CHECK(s1.slab_size <= s1.slab_page_size);
+  CHECK(s1.slab_page_size == s1.slab_page_count * 4096);
+
+  eval(ctx, "a = undefined;");
+  JS_RunGC(rt);
+  JS_ComputeMemoryUsage(rt, &s2);
+  CHECK(s2.slab_count < s0.slab_count + 1000);
+  CHECK(s2.slab_page_count < s0.slab_page_count + 100);
+  /* the memory seen by the allocator drops back as well */
+  CHECK(s2.malloc_size - s0.malloc_size <
+        (s1.malloc_size - s0.malloc_size) / 10);
+
+  JS_FreeContext(ctx);
+  JS_FreeRuntime(rt);
+}
+
+static const char alloc_cycles[] = "(function () {"
+                                   "  for (var i = 0; i < 2000; i++) {"
+                                   "    var a = {}, b = { a: a };"
+                                   "    a.b = b;"
+                                   "  }"
+                                   "})();";
+
+/* build garbage cycles with the automatic GC disabled, then run the first
+   slice of the collection it starts. Return the number of objects before
+   the slice. */
+static int64_t start_gc_slices(JSRuntime *rt, JSContext *ctx) {
+  JSMemoryUsage s;
+
+  JS_SetGCThreshold(rt, -1);
+  eval(ctx, alloc_cycles);
+  JS_ComputeMemoryUsage(rt, &s);
+  /* the next object allocation runs the first slice */
+  JS_SetGCThreshold(rt, 0);
+  eval(ctx, "({});");
+  return s.obj_count;
+}
+
+/* with a pause budget, a collection is split in slices. The cycles left
+   by the first slice are reclaimed by the next ones. */
+static void test_gc_slices(void) {
+  JSRuntime *rt;
+  JSContext *ctx;
+  JSMemoryUsage s;
+  int64_t obj_count;
+  int n;
+
+  rt = JS_NewRuntime();
+  CHECK(rt != NULL);
+  ctx = JS_NewContext(rt);
+  CHECK(ctx != NULL);
+  JS_RunGC(rt);
+  JS_SetGCPauseBudget(rt, 1);
+
+  obj_count = start_gc_slices(rt, ctx);
+  JS_ComputeMemoryUsage(rt, &s);
+  CHECK(s.obj_count > obj_count - 2000);
+  for (n = 1; JS_RunGCSlice(rt); n++)
+    CHECK(n < 10000);
+  CHECK(n > 1);
+  JS_ComputeMemoryUsage(rt, &s);
+  CHECK(s.obj_count <= obj_count - 4000);
+
+  /* a full GC finishes the collection */
+  obj_count = start_gc_slices(rt, ctx);
+  JS_ComputeMemoryUsage(rt, &s);
+  CHECK(s.obj_count > obj_count - 2000);
+  JS_RunGC(rt);
+  CHECK(!JS_RunGCSlice(rt));
+  JS_ComputeMemoryUsage(rt, &s);
+  CHECK(s.obj_count <= obj_count - 4000);
+
+  JS_FreeContext(ctx);
+  JS_FreeRuntime(rt);
+}
+
+static const char alloc_rings[] = "function ring(n) {"
+                                  "  var a = { n: 0 }, b = a;"
+                                  "  for (var i = 1; i < n; i++)"
+                                  "    b = b.next = { n: i };"
+                                  "  b.next = a;"
+                                  "  return a;"
+                                  "}"
+                                  "(function () {"
+                                  "  for (var i = 0; i < 20; i++) {"
+                                  "    var r = ring(5000);"
+                                  "    if (i == 10) live = r;"
+                                  "  }"
+                                  "})();";
+
+static const char check_ring[] = "(function () {"
+                                 "  var b = live, n = 0;"
+                                 "  do { if (b.n != n++) throw Error(); }"
+                                 "  while ((b = b.next) != live);"
+                                 "  if (n != 5000) throw Error();"
+                                 "})();";
+
+/* the traversal of a large subgraph is cut by the pause budget. The
+   reference counts of the objects left for the next slice are given back
+   and a live ring survives. */
+static void test_gc_slices_cut(void) {
+  JSRuntime *rt;
+  JSContext *ctx;
+  JSMemoryUsage s;
+  int64_t obj_count;
+  int n;
+
+  rt = JS_NewRuntime();
+  CHECK(rt != NULL);
+  ctx = JS_NewContext(rt);
+  CHECK(ctx != NULL);
+  JS_RunGC(rt);
+  JS_SetGCPauseBudget(rt, 1);
+
+  JS_SetGCThreshold(rt, -1);
+  eval(ctx, "var live;");
+  eval(ctx, alloc_rings);
+  JS_ComputeMemoryUsage(rt, &s);
+  obj_count = s.obj_count;
+  JS_SetGCThreshold(rt, 0);
+  eval(ctx, "({});");
+  for (n = 1; JS_RunGCSlice(rt); n++)
+    CHECK(n < 100000);
+  CHECK(n > 20);
+  JS_ComputeMemoryUsage(rt, &s);
+  CHECK(s.obj_count <= obj_count - 19 * 5000);
+  CHECK(s.obj_count > obj_count - 20 * 5000);
+  eval(ctx, check_ring);
+
+  eval(ctx, "live = undefined;");
+  JS_RunGC(rt);
+  JS_ComputeMemoryUsage(rt, &s);
+  CHECK(s.obj_count <= obj_count - 20 * 5000);
+
+  JS_FreeContext(ctx);
+  JS_FreeRuntime(rt);
+}
+
+static const char throw_src[] = "function f() {\n"
+                                "  throw Error('x');\n"
+                                "}\n"
+                                "f;";
+
+/* read the bytecode of 'throw_src' and check the line of the exception
+   thrown by f. Return the number of line tables allocated by the read. */
+static int64_t read_throw_func(JSContext *ctx, const uint8_t *buf,
+                               size_t len, int flags) {
+  JSMemoryUsage s0, s1;
+  JSValue obj, func, ret, exc, stack;
+  const char *str;
+
+  JS_ComputeMemoryUsage(JS_GetRuntime(ctx), &s0);
+  obj = JS_ReadObject(ctx, buf, len, JS_READ_OBJ_BYTECODE | flags);
+  CHECK(!JS_IsException(obj));
+  JS_ComputeMemoryUsage(JS_GetRuntime(ctx), &s1);
+  func = JS_EvalFunction(ctx, obj);
+  CHECK(JS_IsFunction(ctx, func));
+  ret = JS_Call(ctx, func, JS_UNDEFINED, 0, NULL);
+  CHECK(JS_IsException(ret));
+  exc = JS_GetException(ctx);
+  stack = JS_GetPropertyStr(ctx, exc, "stack");
+  str = JS_ToCString(ctx, stack);
+  CHECK(str && strstr(str, "at f (<test>:2"));
+  JS_FreeCString(ctx, str);
+  JS_FreeValue(ctx, stack);
+  JS_FreeValue(ctx, exc);
+  JS_FreeValue(ctx, func);
+  return s1.js_func_pc2line_count - s0.js_func_pc2line_count;
+}
+
+/* with JS_READ_OBJ_ROM_DATA, the line tables are used in place in the
+   input buffer, also when its atoms are relocated */
+static void test_read_rom_pc2line(void) {
+  JSRuntime *rt;
+  JSContext *ctx;
+  JSValue obj;
+  uint8_t *buf, *rom;
+  size_t len;
+
+  rt = JS_NewRuntime();
+  CHECK(rt != NULL);
+  ctx = JS_NewContext(rt);
+  CHECK(ctx != NULL);
+  obj = JS_Eval(ctx, throw_src, strlen(throw_src), "<test>",
+                JS_EVAL_TYPE_GLOBAL | JS_EVAL_FLAG_COMPILE_ONLY);
+  CHECK(!JS_IsException(obj));
+  buf = JS_WriteObject(ctx, &len, obj, JS_WRITE_OBJ_BYTECODE);
+  CHECK(buf != NULL);
+  JS_FreeValue(ctx, obj);
+  /* the buffer read in place must outlive the functions */
+  rom = malloc(len);
+  CHECK(rom != NULL);
+  memcpy(rom, buf, len);
+  js_free(ctx, buf);
+
+  CHECK(read_throw_func(ctx, rom, len, 0) == 2);
+  CHECK(read_throw_func(ctx, rom, len, JS_READ_OBJ_ROM_DATA) == 0);
+
+  JS_FreeContext(ctx);
+  JS_FreeRuntime(rt);
+  free(rom);
+}
+
+static const char gcdump_src[] = "var key = 'q\"\\\\\\n\\t\\x01';"
+                                 "var o = { [key]: 1 };"
+                                 "var a = [];"
+                                 "for (var i = 0; i < 20000; i++)"
+                                 "  a.push({ o });";
+
+static const char check_gcdump[] =
+    "(function () {"
+    "  var meta = snap.snapshot.meta, n = 0, i;"
+    "  if (meta.node_fields.length != 5 || meta.edge_fields.length != 3)"
+    "    throw Error('fields');"
+    "  if (snap.nodes.length != snap.snapshot.node_count * 5 ||"
+    "      snap.edges.length != snap.snapshot.edge_count * 3)"
+    "    throw Error('counts');"
+    "  if (snap.snapshot.node_count < 20000) throw Error('nodes');"
+    "  for (i = 4; i < snap.nodes.length; i += 5) n += snap.nodes[i];"
+    "  if (n != snap.snapshot.edge_count) throw Error('edge_count');"
+    "  for (i = 2; i < snap.edges.length; i += 3) {"
+    "    if (snap.edges[i] % 5 || snap.edges[i] >= snap.nodes.length)"
+    "      throw Error('to_node');"
+    "  }"
+    "  if (snap.strings.indexOf(key) < 0) throw Error('strings');"
+    "})();";
+
+/* the snapshot written to a file descriptor is valid JSON with consistent
+   counts, the strings are escaped */
+static void test_gcdump_fd(void) {
+  JSRuntime *rt;
+  JSContext *ctx;
+  JSValue fd_val, ret, snap, global;
+  FILE *f;
+  char *buf;
+  off_t len;
+  int fd;
+
+  rt = JS_NewRuntime();
+  CHECK(rt != NULL);
+  ctx = JS_NewContext(rt);
+  CHECK(ctx != NULL);
+  eval(ctx, gcdump_src);
+
+  f = tmpfile();
+  CHECK(f != NULL);
+  fd = fileno(f);
+  fd_val = JS_NewInt32(ctx, fd);
+  ret = js_gcdump_objects(ctx, JS_UNDEFINED, 1, &fd_val);
+  CHECK(JS_IsNull(ret));
+  len = lseek(fd, 0, SEEK_END);
+  /* more than one buffer of the writer */
+  CHECK(len > KID_WRITER_BUF_SIZE);
+  buf = malloc(len + 1);
+  CHECK(buf != NULL);
+  CHECK(pread(fd, buf, len, 0) == len);
+  buf[len] = '\0';
+  fclose(f);
+
+  snap = JS_ParseJSON(ctx, buf, len, "<gcdump>");
+  CHECK(!JS_IsException(snap));
+  free(buf);
+  global = JS_GetGlobalObject(ctx);
+  JS_SetPropertyStr(ctx, global, "snap", snap);
+  JS_FreeValue(ctx, global);
+  eval(ctx, check_gcdump);
+
+  /* the write errors are thrown */
+  fd = dup(0);
+  CHECK(fd >= 0);
+  close(fd);
+  fd_val = JS_NewInt32(ctx, fd);
+  ret = js_gcdump_objects(ctx, JS_UNDEFINED, 1, &fd_val);
+  CHECK(JS_IsException(ret));
+  JS_FreeValue(ctx, JS_GetException(ctx));
+  fd_val = JS_NewInt32(ctx, -1);
+  ret = js_gcdump_objects(ctx, JS_UNDEFINED, 1, &fd_val);
+  CHECK(JS_IsException(ret));
+  JS_FreeValue(ctx, JS_GetException(ctx));
+
+  JS_FreeContext(ctx);
+  JS_FreeRuntime(rt);
+}
+
+static void *kid_test_malloc(void *opaque, size_t size) {
+  (*(int *)opaque)++;
+  return malloc(size);
+}
+
+static void kid_test_free(void *opaque, void *ptr) {
+  if (ptr)
+    (*(int *)opaque)--;
+  free(ptr);
+}
+
+static void *kid_test_realloc(void *opaque, void *ptr, size_t size) {
+  return realloc(ptr, size);
+}
+
+static KidHashmapEntry *kid_test_get(KidHashmap *map, uint32_t v) {
+  KidHashkey key = {.size = sizeof(v), .opaque = &v, .hash = -1};
+  return kid_hashmap_get(map, &key);
+}
+
+/* the buckets are doubled several times without losing entries and the
+   deleted entries are freed */
+static void test_kid_hashmap(void) {
+  int count = 0;
+  KidAllocator alloc = {&count, kid_test_malloc, kid_test_free,
+                        kid_test_realloc};
+  KidHashmap map;
+  KidHashmapEntry *e;
+  uint32_t i, n = 10000;
+
+  kid_set_allocator(&alloc);
+  CHECK(kid_hashmap_init(&map, kid_hashmap_key_copy, kid_hashmap_key_free,
+                         NULL) == 0);
+  for (i = 0; i < n; i++) {
+    KidHashkey key = {.size = sizeof(i), .opaque = &i, .hash = -1};
+    CHECK(kid_hashmap_set(&map, &key, (void *)(uintptr_t)(i + 1), false) ==
+          0);
+  }
+  CHECK(map.count == n);
+  CHECK(map.buckets_len >= n);
+  CHECK((map.buckets_len & (map.buckets_len - 1)) == 0);
+  for (i = 0; i < n; i++) {
+    e = kid_test_get(&map, i);
+    CHECK(e && e->value == (void *)(uintptr_t)(i + 1));
+  }
+  CHECK(kid_test_get(&map, n) == NULL);
+
+  for (i = 0; i < n; i += 2) {
+    uint32_t v = i;
+    KidHashkey key = {.size = sizeof(v), .opaque = &v, .hash = -1};
+    kid_hashmap_del(&map, &key);
+  }
+  CHECK(map.count == n / 2);
+  for (i = 0; i < n; i++) {
+    e = kid_test_get(&map, i);
+    if (i & 1)
+      CHECK(e && e->value == (void *)(uintptr_t)(i + 1));
+    else
+      CHECK(e == NULL);
+  }
+
+  kid_hashmap_free(&map);
+  CHECK(count == 0);
+  kid_set_allocator(NULL);
+}
+
+int main(int argc, char **argv) {
+  test_slab_disabled();
+  test_slab_release();
+  test_gc_slices();
+  test_gc_slices_cut();
+  test_read_rom_pc2line();
+  test_gcdump_fd();
+  test_kid_hashmap();
+  return 0;
+}
@@ -550,6 +550,207 @@ function test_function_expr_name() {
   assert_throws(TypeError, f);
 }
 
+function test_inline_cache() {
+  var a, i;
+
+  function get(o) {
+    return o.x;
+  }
+  function put(o, v) {
+    o.x = v;
+  }
+  function put_strict(o, v) {
+    "use strict";
+    o.x = v;
+  }
+
+  a = { x: 1, y: 2 };
+  for (i = 0; i < 4; i++) get(a);
+  delete a.x;
+  assert(get(a), undefined);
+  a.x = 5;
+  assert(get(a), 5);
+  Object.defineProperty(a, "x", { get() { return 42; } });
+  assert(get(a), 42);
+
+  a = { x: 1 };
+  for (i = 0; i < 4; i++) put(a, i);
+  assert(a.x, 3);
+  Object.defineProperty(a, "x", { writable: false });
+  put(a, 100);
+  assert(a.x, 3);
+  assert_throws(TypeError, () => put_strict(a, 100));
+
+  a = { x: 1 };
+  for (i = 0; i < 4; i++) put(a, i);
+  Object.defineProperty(a, "x", {
+    set(v) { this.y = v; },
+    get() { return 7; }
+  });
+  put(a, 3);
+  assert(a.y, 3);
+  assert(get(a), 7);
+
+  a = [];
+  for (i = 0; i < 16; i++) a.push({ x: i });
+  for (i = 0; i < 16; i++) assert(get(a[i]), i);
+}
+
+function test_method_cache() {
+  var a, b, i, objs;
+
+  class A { m() { return 1; } }
+  class B extends A { }
+  function call(o) {
+    return o.m();
+  }
+
+  a = new A();
+  for (i = 0; i < 4; i++) call(a);
+  a.m = function () { return 2; };
+  assert(call(a), 2);
+  A.prototype.m = function () { return 3; };
+  assert(call(new A()), 3);
+  Object.defineProperty(A.prototype, "m", { get() { return () => 4; } });
+  assert(call(new A()), 4);
+
+  b = new B();
+  for (i = 0; i < 4; i++) call(b);
+  Object.defineProperty(B.prototype, "m", { value: () => 5 });
+  assert(call(b), 5);
+  Object.setPrototypeOf(b, A.prototype);
+  assert(call(b), 4);
+
+  objs = [];
+  for (i = 0; i < 6; i++) {
+    a = { ["p" + i]: i, v: i, m() { return this.v; } };
+    objs.push(a);
+  }
+  for (i = 0; i < 18; i++) assert(call(objs[i % 6]), i % 6);
+}
+
+function test_superinstructions() {
+  var calls = 0;
+  var o = { valueOf() { calls++; return 1; } };
+
+  function add(a, b) {
+    return a + b;
+  }
+  function lt5(x) {
+    var v = x;
+    if (v < 5)
+      return true;
+    return false;
+  }
+  function field(x) {
+    var v = x;
+    return v.f;
+  }
+
+  assert(add(1, 2), 3);
+  assert(add(0x7fffffff, 1), 0x80000000);
+  assert(add(0.5, 1), 1.5);
+  assert(add("a", 1), "a1");
+  assert(add(1n, 2n), 3n);
+  assert(add(o, 1), 2);
+  assert_throws(TypeError, () => add(1n, 1));
+
+  assert(lt5(4), true);
+  assert(lt5(5), false);
+  assert(lt5(4.5), true);
+  assert(lt5(NaN), false);
+  assert(lt5("3"), true);
+  assert(lt5(3n), true);
+  assert(lt5(o), true);
+  assert(calls, 2);
+
+  assert(field({ f: 1 }), 1);
+  assert(field({ g: 1, f: 2 }), 2);
+  assert(field({ get f() { return 3; } }), 3);
+  assert(field("s"), undefined);
+  assert_throws(TypeError, () => field(undefined));
+}
+
+function test_global_var_cache() {
+  var i;
+  var get = (1, eval)("(function () { return test_gv; })");
+  var put = (1, eval)("(function (v) { test_gv = v; })");
+
+  globalThis.test_gv = 1;
+  for (i = 0; i < 4; i++) put(get() + 1);
+  assert(globalThis.test_gv, 5);
+
+  Object.defineProperty(globalThis, "test_gv", { writable: false });
+  put(10);
+  assert(get(), 5);
+
+  Object.defineProperty(globalThis, "test_gv", {
+    get() { return 6; },
+    configurable: true
+  });
+  assert(get(), 6);
+
+  delete globalThis.test_gv;
+  assert_throws(ReferenceError, get);
+  put(7);
+  assert(get(), 7);
+  delete globalThis.test_gv;
+}
+
+function test_cycle_collection() {
+  var live = [], i, a, b, o;
+
+  function make(i) {
+    var o = { i: i };
+    o.get = function () { return o; };
+    return o;
+  }
+
+  /* enough allocations to run the automatic GC several times. The
+     cycles whose last external reference is dropped are collected from
+     their possible roots while the live ones must be kept */
+  for (i = 0; i < 100000; i++) {
+    a = { i: i };
+    b = { a: a };
+    a.b = b;
+    o = make(i);
+    if ((i % 1000) == 0)
+      live.push(b, o);
+  }
+  for (i = 0; i < live.length; i += 2) {
+    b = live[i];
+    o = live[i + 1];
+    assert(b.a.b, b);
+    assert(b.a.i, i * 500);
+    assert(o.get(), o);
+    assert(o.i, i * 500);
+  }
+}
+
+function test_function_source() {
+  var src, f, g;
+
+  /* the nested functions point into the source of the outermost one,
+     which must stay alive when only the inner function is kept */
+  src = "(function outer(a) {\n" +
+        "  var h = (x) => x + a;\n" +
+        "  class C { m(y) { return y; } get v() { return 1; } }\n" +
+        "  return [h, C, C.prototype.m, function inner() { return h(1); }];\n" +
+        "})";
+  f = (1, eval)(src);
+  assert(f.toString(), src.slice(1, -1));
+  g = f(2);
+  f = undefined;
+  assert(g[0].toString(), "(x) => x + a");
+  assert(g[1].toString(),
+         "class C { m(y) { return y; } get v() { return 1; } }");
+  assert(g[2].toString(), "m(y) { return y; }");
+  assert(g[3].toString(), "function inner() { return h(1); }");
+  assert(g[3](), 3);
+  assert(Object.getOwnPropertyDescriptor(g[1].prototype, "v").get.toString(),
+         "get v() { return 1; }");
+}
+
 test_op1();
 test_cvt();
 test_eq();
@@ -569,3 +770,9 @@ test_spread();
 test_function_length();
 test_argument_scope();
 test_function_expr_name();
+test_inline_cache();
+test_method_cache();
+test_superinstructions();
+test_global_var_cache();
+test_cycle_collection();
+test_function_source();